@@ -1,348 +1,901 @@
-#pragma once
-
-#include "base/list.hpp"
-#include "base/reference_optional.hpp"
-
-#include <algorithm>
-#include <cassert>
-#include <cstddef>
-#include <cstdint>
-#include <functional>
-#include <limits>
-#include <optional>
-#include <type_traits>
-#include <utility>
-#include <vector>
-
-namespace base
-{
-
-    /// @brief 简易哈希表
-    /// 哈希冲突用简单的拉链法解决
-    /// TODO: 实现后续 redis 版本的渐进式扩容机制
-    /// TODO: 实现dict-table, dict-entry
-    template <
-        typename KeyType = int,
-        typename ValueType = int,
-        typename HashFunction = std::hash<KeyType>,
-        typename EqualFunction = std::equal_to<>>
-    class Dictionary
-    {
-        static constexpr int64_t HT_INITIAL_EXP = 2;
-        static constexpr int64_t HT_INITIAL_SIZE = 1 << HT_INITIAL_EXP;
-
-        using Entry = std::pair<const KeyType, ValueType>;
-        using HashTable = std::vector<ForwardList<Entry>>;
-
-        static_assert(
-            std::is_same_v<decltype(HashFunction()(KeyType{})), size_t>,
-            "KeyType 无法被 HashFunction 计算哈希值");
-
-    public:
-        /// redis function: dictCreate
-        Dictionary() = default;
-
-        /// 复制构造
-        Dictionary(const Dictionary &other)
-        {
-            CopyFrom(other);
-        }
-
-        /// 移动构造
-        Dictionary(Dictionary &&other)
-        {
-            Swap(other);
-            other.table_.clear();
-            other.table_.shrink_to_fit();
-            other.size_ = 0;
-            other.sizeMask_ = 0;
-            other.used_ = 0;
-        }
-
-        /// 复制赋值
-        Dictionary &operator=(const Dictionary &other)
-        {
-            CopyFrom(other);
-            return *this;
-        }
-
-        /// 移动赋值
-        Dictionary &operator=(Dictionary &&other)
-        {
-            Swap(other);
-            other.table_.clear();
-            other.table_.shrink_to_fit();
-            other.size_ = 0;
-            other.sizeMask_ = 0;
-            other.used_ = 0;
-            return *this;
-        }
-
-        /// redis function: dictExpand
-        /// 扩容到指定容量，并重新哈希全部键值对
-        bool Expand(size_t size)
-        {
-            assert(size >= used_ && "不允许比已存储的元素少");
-
-            auto expand_size = AlignExpandSize(size);
-            assert(static_cast<size_t>(expand_size) >= size);
-
-            auto new_table = HashTable{};
-            auto new_size = expand_size;
-            auto new_sizemask = expand_size - 1;
-            new_table.resize(expand_size);
-            assert(
-                new_table.size() == static_cast<size_t>(expand_size) &&
-                "Out of memory");
-            auto new_used = 0;
-
-            for (auto &bucket : table_)
-            {
-                if (bucket.empty())
-                {
-                    continue;
-                }
-
-                for (auto &entry : bucket)
-                {
-                    auto key_index = hash_(entry.first) & new_sizemask;
-                    new_table[key_index].emplace_front(std::move(entry));
-                    new_used++;
-                }
-            }
-
-            assert(static_cast<size_t>(new_used) == used_);
-            std::swap(table_, new_table);
-            size_ = new_size;
-            sizeMask_ = new_sizemask;
-
-            return true;
-        }
-
-        /// redis function: dictResize
-        /// 将容量自适应到已存储的元素的数量，并重新哈希全部键值对
-        bool Fit();
-
-        /// redis function: dictAdd
-        /// 添加新的键值对
-        template <typename KT, typename VT>
-        bool Add(KT &&key, VT &&value)
-        {
-            int64_t index = FindBucketIndex(key);
-            if (index == -1)
-            {
-                return false;
-            }
-
-            table_[index].push_front(
-                std::make_pair(
-                    std::forward<KT>(key),
-                    std::forward<VT>(value)));
-
-            used_++;
-
-            return true;
-        }
-
-        /// redis function: dictReplace
-        /// 替换字典中键为 key 的值成 value，如果 key 不在字典里就新增
-        /// 返回 true 代表新增键值对，返回 false 代表替换
-        template <typename KT, typename VT>
-        bool Replace(KT &&key, VT &&value)
-        {
-            if (Add(std::forward<KT>(key), std::forward<VT>(value)))
-            {
-                return true;
-            }
-
-            auto find_result = Find(key);
-            assert(find_result.has_value());
-
-            find_result->get().second = std::forward<VT>(value);
-
-            return false;
-        }
-
-        /// redis function: dictDelete
-        /// 删除键值对
-        bool Delete(const KeyType &key)
-        {
-            if (Empty())
-            {
-                return false;
-            }
-            auto index = hash_(key) & sizeMask_;
-            auto &bucket = table_[index];
-            size_t size = bucket.remove_if([&](Entry entry) { return equal_(entry.first, key); });
-            if (size > 0)
-            {
-                used_--;
-                return true;
-            }
-            return false;
-        }
-
-        /// redis function: dictFind
-        /// 查找键值对
-        ReferenceOptional<Entry> Find(const KeyType &key)
-        {
-            if (Empty())
-            {
-                return std::nullopt;
-            }
-
-            auto index = hash_(key) & sizeMask_;
-            auto &bucket = table_[index];
-
-            // 查找是否已经有相同的 key
-            for (auto &entry : bucket)
-            {
-                if (equal_(entry.first, key))
-                {
-                    return entry;
-                }
-            }
-
-            return std::nullopt;
-        }
-
-        /// 获取已经存储的元素数量
-        auto ElementSize()
-        {
-            return used_;
-        }
-
-        /// 获取表空位的元素数量
-        auto BucketSize()
-        {
-            return table_.size();
-        }
-
-        /// 是否为空
-        bool Empty()
-        {
-            return size_ == 0;
-        }
-
-        /// 释放全部内存
-        void Release();
-
-        /* -- TODO: 迭代器 API --*/
-
-    private:
-        /// 拷贝操作的实现
-        void CopyFrom(const Dictionary &other)
-        {
-            table_ = other.table_;
-            size_ = other.size_;
-            sizeMask_ = other.sizeMask_;
-            used_ = other.used_;
-        }
-
-        /// 交换
-        void Swap(Dictionary &other)
-        {
-            std::swap(table_, other.table_);
-            std::swap(size_, other.size_);
-            std::swap(sizeMask_, other.sizeMask_);
-            std::swap(used_, other.used_);
-        }
-
-        /// redis function: _dictNextPower
-        /// 计算扩容的目标大小，返回的数值是数列 2^n 中大于等于 size 的最小值
-        int64_t AlignExpandSize(uint64_t size)
-        {
-            // size 超过 int64_t 能表示的最大值，直接返回 int64_t 的最大值
-            if (size >= static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
-            {
-                return std::numeric_limits<int64_t>::max();
-            }
-            size -= 1;
-
-            // 二分查找
-            auto idx = 63;
-            if (size >= 4294967296)
-            {
-                idx -= 32;
-                size >>= 32;
-            }
-            if (size >= 65536)
-            {
-                idx -= 16;
-                size >>= 16;
-            }
-            if (size >= 256)
-            {
-                idx -= 8;
-                size >>= 8;
-            }
-            if (size >= 16)
-            {
-                idx -= 4;
-                size >>= 4;
-            }
-            if (size >= 4)
-            {
-                idx -= 2;
-                size >>= 2;
-            }
-            if (size >= 2)
-            {
-                idx -= 1;
-            }
-            return uint64_t{1} << (64 - idx);
-        }
-
-        /// redis function: _dictExpandIfNeeded
-        /// 检查是否需要并进行扩容
-        bool ExpandIfNeeded()
-        {
-            if (size_ == 0)
-            {
-                return Expand(HT_INITIAL_SIZE);
-            }
-
-            if (used_ == size_)
-            {
-                return Expand(size_ * 2);
-            }
-
-            return true;
-        }
-
-        /// redis function: _dictKeyIndex
-        /// 查找能放下参数提供的 key 的表空位，如果 key 在表里已经存在，返回 -1
-        int64_t FindBucketIndex(const KeyType &key)
-        {
-            // 检查需不需要扩容
-            // 扩容失败直接返回 -1。不过目前扩容失败会触发断言错误，这个分支不可能会执行。
-            if (!ExpandIfNeeded())
-            {
-                return -1;
-            }
-
-            auto index = hash_(key) & sizeMask_;
-            auto &bucket = table_[index];
-
-            // 查找是否已经有相同的 key
-            for (const auto &entry : bucket)
-            {
-                if (equal_(entry.first, key))
-                {
-                    return -1;
-                }
-            }
-
-            return index;
-        }
-
-    private:
-        HashFunction hash_;
-        EqualFunction equal_;
-        HashTable table_{};
-        size_t size_ = 0;
-        size_t sizeMask_ = 0;
-        size_t used_ = 0;
-    };
-
-} // namespace base
+#pragma once
+
+#include "base/flat_dictionary.hpp"
+#include "base/list.hpp"
+#include "base/marco.hpp"
+#include "base/reference_optional.hpp"
+#include "base/time_helper.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace base
+{
+
+    /// 哈希表实现方式的标签，作为 Dictionary 的最后一个模板参数
+    /// 拉链法，支持渐进式 rehash
+    struct ChainedHashing
+    {
+    };
+
+    /// 开放寻址法，见 FlatDictionary
+    struct OpenAddressing
+    {
+    };
+
+    /// @brief 简易哈希表
+    /// 哈希冲突用简单的拉链法解决
+    /// 使用两张哈希表实现 redis 的渐进式 rehash：扩容时只分配新表，已有的键值对在之后的
+    /// Find/Add/Delete 操作中每次搬迁一个表空位，或者由 RehashMilliseconds() 在事件循环
+    /// 空闲时限时搬迁，避免一次性 rehash 全部元素阻塞事件循环
+    template <
+        typename KeyType = int,
+        typename ValueType = int,
+        typename HashFunction = std::hash<KeyType>,
+        typename EqualFunction = std::equal_to<>,
+        typename Engine = ChainedHashing>
+    class Dictionary
+    {
+        static_assert(
+            std::is_same_v<Engine, ChainedHashing>,
+            "Engine 只能是 ChainedHashing 或 OpenAddressing");
+
+        static constexpr int64_t HT_INITIAL_EXP = 2;
+        static constexpr int64_t HT_INITIAL_SIZE = 1 << HT_INITIAL_EXP;
+        /// redis macro: HASHTABLE_MIN_FILL
+        /// 已存储元素数量占表空位数量的百分比低于该值时需要缩容
+        static constexpr size_t HT_MIN_FILL_PERCENT = 10;
+        /// RehashMilliseconds() 每轮搬迁的表空位数量
+        static constexpr int64_t HT_REHASH_BATCH = 100;
+
+        using Entry = std::pair<const KeyType, ValueType>;
+
+        /// redis struct: dictEntry
+        /// 链表节点，缓存 key 的哈希值：rehash 时直接用缓存的哈希值计算新的表空位，
+        /// 不需要重新计算 key 的哈希值；查找时先比较哈希值，不同时跳过 key 的比较
+        struct Node
+        {
+            template <typename KT, typename VT>
+            Node(size_t h, KT &&key, VT &&value)
+                : hash(h), entry(std::forward<KT>(key), std::forward<VT>(value))
+            {
+            }
+
+            size_t hash;
+            Entry entry;
+        };
+
+        using Bucket = ForwardList<Node>;
+
+        /// redis struct: dictht
+        struct HashTable
+        {
+            std::vector<Bucket> table{};
+            size_t size = 0;
+            size_t sizeMask = 0;
+            size_t used = 0;
+
+            /// 重置为未分配的状态
+            void Reset()
+            {
+                table.clear();
+                table.shrink_to_fit();
+                size = 0;
+                sizeMask = 0;
+                used = 0;
+            }
+        };
+
+        static_assert(
+            std::is_same_v<decltype(HashFunction()(KeyType{})), size_t>,
+            "KeyType 无法被 HashFunction 计算哈希值");
+
+        /// 哈希函数和比较函数是否都支持异构查找
+        static constexpr bool IS_TRANSPARENT =
+            requires { typename HashFunction::is_transparent; } &&
+            requires { typename EqualFunction::is_transparent; };
+
+    public:
+        /// redis function: dictCreate
+        Dictionary() = default;
+
+        /// 复制构造
+        Dictionary(const Dictionary &other)
+        {
+            CopyFrom(other);
+        }
+
+        /// 移动构造
+        Dictionary(Dictionary &&other) noexcept
+        {
+            Swap(other);
+            other.ht_[0].Reset();
+            other.ht_[1].Reset();
+            other.rehashIndex_ = -1;
+        }
+
+        /// 复制赋值
+        Dictionary &operator=(const Dictionary &other)
+        {
+            CopyFrom(other);
+            return *this;
+        }
+
+        /// 移动赋值
+        Dictionary &operator=(Dictionary &&other) noexcept
+        {
+            Swap(other);
+            other.ht_[0].Reset();
+            other.ht_[1].Reset();
+            other.rehashIndex_ = -1;
+            return *this;
+        }
+
+        /// redis function: dictExpand
+        /// 扩容到指定容量。如果表里已经有元素，只分配新表并开始渐进式 rehash；
+        /// 正在 rehash 时不允许再次扩容，返回 false
+        bool Expand(size_t size)
+        {
+            assert(size >= ElementSize() && "不允许比已存储的元素少");
+            if (IsRehashing())
+            {
+                return false;
+            }
+
+            auto expand_size = AlignExpandSize(size);
+            assert(static_cast<size_t>(expand_size) >= size);
+            if (static_cast<size_t>(expand_size) == ht_[0].size)
+            {
+                return false;
+            }
+
+            auto new_table = HashTable{};
+            new_table.size = expand_size;
+            new_table.sizeMask = expand_size - 1;
+            new_table.table.resize(expand_size);
+            assert(
+                new_table.table.size() == static_cast<size_t>(expand_size) &&
+                "Out of memory");
+
+            // 旧表没有元素，不需要 rehash，直接替换。
+            // 安全迭代器可能还在引用旧表，暂停期间仍然走 rehash 流程；
+            // 旧表还没有分配时迭代器不会引用任何桶，总是直接替换
+            if (ht_[0].size == 0 || (ht_[0].used == 0 && !IsRehashingPaused()))
+            {
+                ht_[0] = std::move(new_table);
+                return true;
+            }
+
+            ht_[1] = std::move(new_table);
+            rehashIndex_ = 0;
+            return true;
+        }
+
+        /// redis function: dictResize
+        /// 将容量自适应到已存储的元素的数量。缩容同样走渐进式 rehash，
+        /// 正在 rehash 或者容量已经合适时返回 false
+        bool Fit()
+        {
+            if (IsRehashing())
+            {
+                return false;
+            }
+            auto minimal = std::max<size_t>(ht_[0].used, HT_INITIAL_SIZE);
+            return Expand(minimal);
+        }
+
+        /// redis function: htNeedsResize
+        /// 元素数量远小于表空位数量时，需要缩容
+        bool NeedsShrink()
+        {
+            auto size = ht_[0].size;
+            return size > static_cast<size_t>(HT_INITIAL_SIZE) &&
+                   ht_[0].used * 100 / size < HT_MIN_FILL_PERCENT;
+        }
+
+        /// 如果负载过低就开始缩容，返回 true 代表开始了缩容
+        bool ShrinkIfNeeded()
+        {
+            if (IsRehashing() || IsRehashingPaused() || !NeedsShrink())
+            {
+                return false;
+            }
+            return Fit();
+        }
+
+        /// redis function: dictRehash
+        /// 执行 n 步渐进式 rehash，每一步搬迁旧表的一个表空位。
+        /// 为了避免连续遇到大量空的表空位导致耗时过长，最多访问 n * 10 个空的表空位。
+        /// 返回 true 代表还有元素需要搬迁，返回 false 代表 rehash 已经完成
+        bool Rehash(int64_t n)
+        {
+            if (!IsRehashing())
+            {
+                return false;
+            }
+
+            auto empty_visits = n * 10;
+            auto &from = ht_[0];
+            auto &to = ht_[1];
+            while (n-- > 0 && from.used != 0)
+            {
+                assert(static_cast<size_t>(rehashIndex_) < from.size);
+                while (from.table[rehashIndex_].empty())
+                {
+                    rehashIndex_++;
+                    if (--empty_visits == 0)
+                    {
+                        return true;
+                    }
+                }
+
+                // 逐个节点转移到新表，只修改链表指针，不重新分配节点内存
+                auto &bucket = from.table[rehashIndex_];
+                while (!bucket.empty())
+                {
+                    auto index = bucket.front().hash & to.sizeMask;
+                    auto &target = to.table[index];
+                    target.splice_after(
+                        target.before_begin(), bucket, bucket.before_begin());
+                    from.used--;
+                    to.used++;
+                }
+                rehashIndex_++;
+            }
+
+            // 旧表已经搬空，新表替换旧表
+            if (from.used == 0)
+            {
+                ht_[0] = std::move(ht_[1]);
+                ht_[1].Reset();
+                rehashIndex_ = -1;
+                return false;
+            }
+
+            return true;
+        }
+
+        /// redis function: dictRehashMilliseconds
+        /// 在指定的毫秒时长内尽可能多地执行渐进式 rehash，返回执行的步数
+        int64_t RehashMilliseconds(int64_t ms)
+        {
+            if (IsRehashingPaused())
+            {
+                return 0;
+            }
+
+            auto start = NowMilliseconds();
+            int64_t rehashes = 0;
+            while (Rehash(HT_REHASH_BATCH))
+            {
+                rehashes += HT_REHASH_BATCH;
+                if (NowMilliseconds() - start > ms)
+                {
+                    break;
+                }
+            }
+            return rehashes;
+        }
+
+        /// 是否正在进行渐进式 rehash
+        bool IsRehashing() const
+        {
+            return rehashIndex_ != -1;
+        }
+
+        /// redis function: dictAdd
+        /// 添加新的键值对
+        template <typename KT, typename VT>
+        bool Add(KT &&key, VT &&value)
+        {
+            RehashStep();
+
+            auto hash = Hash(key);
+            int64_t index = FindBucketIndex(key, hash);
+            if (index == -1)
+            {
+                return false;
+            }
+
+            // 正在 rehash 时新元素直接放进新表
+            auto &ht = IsRehashing() ? ht_[1] : ht_[0];
+            // 原地构造，允许 key 是能显式构造 KeyType 的类型，例如 std::string_view
+            ht.table[index].emplace_front(
+                hash,
+                std::forward<KT>(key),
+                std::forward<VT>(value));
+
+            ht.used++;
+
+            return true;
+        }
+
+        /// redis function: dictReplace
+        /// 替换字典中键为 key 的值成 value，如果 key 不在字典里就新增
+        /// 返回 true 代表新增键值对，返回 false 代表替换
+        template <typename KT, typename VT>
+        bool Replace(KT &&key, VT &&value)
+        {
+            if (Add(std::forward<KT>(key), std::forward<VT>(value)))
+            {
+                return true;
+            }
+
+            auto find_result = Find(key);
+            assert(find_result.has_value());
+
+            find_result->get().second = std::forward<VT>(value);
+
+            return false;
+        }
+
+        /// redis function: dictDelete
+        /// 删除键值对
+        template <typename KT>
+        bool Delete(const KT &key)
+        {
+            if (ht_[0].size == 0)
+            {
+                return false;
+            }
+            RehashStep();
+
+            auto hash = Hash(key);
+            for (auto &ht : ht_)
+            {
+                if (ht.size == 0)
+                {
+                    break;
+                }
+                auto &bucket = ht.table[hash & ht.sizeMask];
+                size_t size = bucket.remove_if([&](const Node &node)
+                                               { return node.hash == hash && equal_(node.entry.first, key); });
+                if (size > 0)
+                {
+                    ht.used--;
+                    return true;
+                }
+                if (!IsRehashing())
+                {
+                    break;
+                }
+            }
+            return false;
+        }
+
+        /// redis function: dictFind
+        /// 查找键值对
+        /// 当 HashFunction 和 EqualFunction 都支持异构查找（定义了 is_transparent）时，
+        /// key 可以是任意能被它们直接处理的类型，例如以 std::string 为 KeyType 时
+        /// 使用 std::string_view 查找，不会构造临时的 KeyType
+        template <typename KT>
+        ReferenceOptional<Entry> Find(const KT &key)
+        {
+            return Find(key, Hash(key));
+        }
+
+        /// 使用调用者算好的哈希值查找，hash 必须等于 Hash(key)。
+        /// 用同一个 key 查找多个使用相同哈希函数的字典时，只需要计算一次哈希值
+        template <typename KT>
+        ReferenceOptional<Entry> Find(const KT &key, size_t hash)
+        {
+            if (ht_[0].size == 0)
+            {
+                return std::nullopt;
+            }
+            RehashStep();
+
+            for (auto &ht : ht_)
+            {
+                if (ht.size == 0)
+                {
+                    break;
+                }
+
+                // 查找是否已经有相同的 key，哈希值不同的节点不需要比较 key
+                for (auto &node : ht.table[hash & ht.sizeMask])
+                {
+                    if (node.hash == hash && equal_(node.entry.first, key))
+                    {
+                        return node.entry;
+                    }
+                }
+                if (!IsRehashing())
+                {
+                    break;
+                }
+            }
+
+            return std::nullopt;
+        }
+
+        /// 计算 key 的哈希值。哈希函数不支持异构查找时，先把 key 转换成 KeyType，
+        /// 保证与存储时计算的哈希值一致
+        template <typename KT>
+        size_t Hash(const KT &key) const
+        {
+            if constexpr (IS_TRANSPARENT || std::is_same_v<KT, KeyType>)
+            {
+                return hash_(key);
+            }
+            else
+            {
+                return hash_(KeyType(key));
+            }
+        }
+
+        /// 获取已经存储的元素数量
+        auto ElementSize()
+        {
+            return ht_[0].used + ht_[1].used;
+        }
+
+        /// 获取表空位的数量，rehash 期间包含新旧两张表
+        auto BucketSize()
+        {
+            return ht_[0].size + ht_[1].size;
+        }
+
+        /// 是否为空
+        bool Empty()
+        {
+            return ElementSize() == 0;
+        }
+
+        /// redis function: dictRelease
+        /// 删除全部元素并释放全部内存
+        void Release()
+        {
+            assert(!IsRehashingPaused() && "遍历期间不允许释放字典");
+            ht_[0].Reset();
+            ht_[1].Reset();
+            rehashIndex_ = -1;
+        }
+
+        /// redis struct: dictIterator
+        /// 遍历全部键值对的迭代器，rehash 期间依次遍历新旧两张表。
+        /// Safe 为 true 时是安全迭代器，通过 SafeRange() 获取，遍历期间暂停渐进式 rehash，
+        /// 允许在遍历过程中调用 Find/Add/Delete，包括删除当前元素，新增的元素不一定会被遍历到；
+        /// Safe 为 false 时是不安全迭代器，通过 begin()/end() 获取，遍历期间只允许读取，
+        /// 任何会修改字典的操作（包括 Find 顺带执行的 rehash）都会触发断言错误
+        template <bool Safe>
+        class IteratorBase
+        {
+            using BucketIterator = typename Bucket::iterator;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Entry;
+            using difference_type = std::ptrdiff_t;
+            using pointer = Entry *;
+            using reference = Entry &;
+
+            IteratorBase() = default;
+
+            /// 构造指向第一个元素的迭代器，at_end 为 true 时构造尾后迭代器
+            IteratorBase(Dictionary *dict, bool at_end)
+                : dict_(dict)
+            {
+                if (at_end)
+                {
+                    table_ = 2;
+                    return;
+                }
+                if constexpr (!Safe)
+                {
+                    fingerprint_ = dict_->Fingerprint();
+                }
+                SeekNonEmptyBucket();
+            }
+
+            Entry &operator*() const
+            {
+                return current_->entry;
+            }
+
+            Entry *operator->() const
+            {
+                return &current_->entry;
+            }
+
+            /// redis function: dictNext
+            IteratorBase &operator++()
+            {
+                if constexpr (!Safe)
+                {
+                    assert(fingerprint_ == dict_->Fingerprint() &&
+                           "不安全迭代器遍历期间字典被修改");
+                }
+                // 下一个节点在遍历当前节点之前已经记录，删除当前节点不影响继续遍历
+                if (next_ != CurrentBucket().end())
+                {
+                    current_ = next_;
+                    next_ = std::next(current_);
+                    return *this;
+                }
+                bucket_++;
+                SeekNonEmptyBucket();
+                return *this;
+            }
+
+            bool operator==(const IteratorBase &other) const
+            {
+                return table_ == other.table_ &&
+                       bucket_ == other.bucket_ &&
+                       (table_ == 2 || current_ == other.current_);
+            }
+
+            bool operator!=(const IteratorBase &other) const
+            {
+                return !(*this == other);
+            }
+
+        private:
+            Bucket &CurrentBucket() const
+            {
+                return dict_->ht_[table_].table[bucket_];
+            }
+
+            /// 从当前表空位开始找到第一个非空的表空位，两张表都遍历完后变成尾后迭代器
+            void SeekNonEmptyBucket()
+            {
+                while (table_ < 2)
+                {
+                    auto &ht = dict_->ht_[table_];
+                    for (; bucket_ < ht.size; bucket_++)
+                    {
+                        auto &bucket = ht.table[bucket_];
+                        if (!bucket.empty())
+                        {
+                            current_ = bucket.begin();
+                            next_ = std::next(current_);
+                            return;
+                        }
+                    }
+                    bucket_ = 0;
+                    table_ = (table_ == 0 && dict_->IsRehashing()) ? 1 : 2;
+                }
+            }
+
+        private:
+            Dictionary *dict_ = nullptr;
+            /// 正在遍历的表，2 代表遍历结束
+            int32_t table_ = 0;
+            size_t bucket_ = 0;
+            BucketIterator current_{};
+            BucketIterator next_{};
+            /// 不安全迭代器创建时字典的指纹
+            uint64_t fingerprint_ = 0;
+        };
+
+        using Iterator = IteratorBase<false>;
+        using SafeIterator = IteratorBase<true>;
+
+        /// 安全遍历的范围对象，存在期间暂停渐进式 rehash
+        /// 用法: for (auto &entry : dict.SafeRange()) { ... }
+        class SafeIterationRange
+        {
+        public:
+            DISABLE_COPY_AND_MOVE(SafeIterationRange)
+
+            explicit SafeIterationRange(Dictionary *dict)
+                : dict_(dict)
+            {
+                dict_->pauseRehash_++;
+            }
+
+            ~SafeIterationRange()
+            {
+                dict_->pauseRehash_--;
+            }
+
+            SafeIterator begin()
+            {
+                return SafeIterator(dict_, false);
+            }
+
+            SafeIterator end()
+            {
+                return SafeIterator(dict_, true);
+            }
+
+        private:
+            Dictionary *dict_;
+        };
+
+        /// 不安全迭代器，只允许遍历
+        Iterator begin()
+        {
+            return Iterator(this, false);
+        }
+
+        Iterator end()
+        {
+            return Iterator(this, true);
+        }
+
+        /// 获取安全遍历的范围对象
+        SafeIterationRange SafeRange()
+        {
+            return SafeIterationRange(this);
+        }
+
+        /// redis function: dictScan
+        /// 无状态的增量遍历。第一次调用传入 cursor = 0，之后每次传入上一次的返回值，
+        /// 返回 0 代表遍历结束。每次调用只遍历一个表空位（rehash 期间是小表的一个表空位
+        /// 和大表里对应的全部表空位），对每个键值对调用一次 callback(Entry &)。
+        ///
+        /// cursor 使用 redis 的反向二进制递增：从高位开始加一。两次调用之间字典扩容或
+        /// 缩容时，已经遍历过的表空位在新表里对应的表空位的高位更小，不会被再次遍历，
+        /// 因此调用开始时就存在、并且一直没有被删除的元素保证至少遍历到一次，只有缩容时
+        /// 同一个元素可能被遍历多次。
+        /// callback 里允许删除当前元素，不允许新增元素。
+        template <typename Callback>
+        size_t Scan(size_t cursor, Callback &&callback)
+        {
+            if (Empty())
+            {
+                return 0;
+            }
+
+            // callback 里可能会删除元素，期间不能搬迁元素
+            pauseRehash_++;
+            auto v = cursor;
+            if (!IsRehashing())
+            {
+                auto &t0 = ht_[0];
+                auto m0 = t0.sizeMask;
+                ScanBucket(t0.table[v & m0], callback);
+
+                // 把不属于掩码的高位全部置 1，反转后加一，再反转回来，相当于从高位开始加一
+                v |= ~m0;
+                v = ReverseBits(v);
+                v++;
+                v = ReverseBits(v);
+            }
+            else
+            {
+                auto *t0 = &ht_[0];
+                auto *t1 = &ht_[1];
+                // 保证 t0 是小表
+                if (t0->size > t1->size)
+                {
+                    std::swap(t0, t1);
+                }
+                auto m0 = t0->sizeMask;
+                auto m1 = t1->sizeMask;
+                ScanBucket(t0->table[v & m0], callback);
+
+                // 遍历大表里所有和小表当前表空位对应的表空位
+                do
+                {
+                    ScanBucket(t1->table[v & m1], callback);
+                    v |= ~m1;
+                    v = ReverseBits(v);
+                    v++;
+                    v = ReverseBits(v);
+                } while (v & (m0 ^ m1));
+            }
+            pauseRehash_--;
+
+            return v;
+        }
+
+    private:
+        /// 拷贝操作的实现
+        void CopyFrom(const Dictionary &other)
+        {
+            ht_[0] = other.ht_[0];
+            ht_[1] = other.ht_[1];
+            rehashIndex_ = other.rehashIndex_;
+        }
+
+        /// 交换
+        void Swap(Dictionary &other)
+        {
+            std::swap(ht_, other.ht_);
+            std::swap(rehashIndex_, other.rehashIndex_);
+        }
+
+        /// redis function: _dictRehashStep
+        /// 在查找和修改操作中顺带执行一步 rehash
+        void RehashStep()
+        {
+            if (IsRehashing() && !IsRehashingPaused())
+            {
+                Rehash(1);
+            }
+        }
+
+        /// 是否有安全迭代器或者 Scan 正在暂停渐进式 rehash
+        bool IsRehashingPaused() const
+        {
+            return pauseRehash_ > 0;
+        }
+
+        /// redis function: dictFingerprint
+        /// 由两张表的地址、大小和元素数量计算出的指纹，用于检测不安全迭代器的误用
+        uint64_t Fingerprint() const
+        {
+            uint64_t integers[6] = {
+                reinterpret_cast<uint64_t>(ht_[0].table.data()),
+                ht_[0].size,
+                ht_[0].used,
+                reinterpret_cast<uint64_t>(ht_[1].table.data()),
+                ht_[1].size,
+                ht_[1].used,
+            };
+
+            // Tomas Wang 的 64 位整数哈希，按 hash(hash(hash(int1) + int2) + int3) 的方式组合
+            uint64_t hash = 0;
+            for (auto integer : integers)
+            {
+                hash += integer;
+                hash = (~hash) + (hash << 21);
+                hash = hash ^ (hash >> 24);
+                hash = (hash + (hash << 3)) + (hash << 8);
+                hash = hash ^ (hash >> 14);
+                hash = (hash + (hash << 2)) + (hash << 4);
+                hash = hash ^ (hash >> 28);
+                hash = hash + (hash << 31);
+            }
+            return hash;
+        }
+
+        /// 遍历一个表空位，提前记录下一个节点，允许 callback 删除当前节点
+        template <typename Callback>
+        static void ScanBucket(Bucket &bucket, Callback &callback)
+        {
+            auto it = bucket.begin();
+            while (it != bucket.end())
+            {
+                auto current = it++;
+                callback(current->entry);
+            }
+        }
+
+        /// redis function: rev
+        /// 反转 64 位整数的二进制位
+        static uint64_t ReverseBits(uint64_t v)
+        {
+            v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+            v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+            v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+            return __builtin_bswap64(v);
+        }
+
+        /// redis function: _dictNextPower
+        /// 计算扩容的目标大小，返回的数值是数列 2^n 中大于等于 size 的最小值
+        int64_t AlignExpandSize(uint64_t size)
+        {
+            // size 超过 int64_t 能表示的最大值，直接返回 int64_t 的最大值
+            if (size >= static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+            {
+                return std::numeric_limits<int64_t>::max();
+            }
+            size -= 1;
+
+            // 二分查找
+            auto idx = 63;
+            if (size >= 4294967296)
+            {
+                idx -= 32;
+                size >>= 32;
+            }
+            if (size >= 65536)
+            {
+                idx -= 16;
+                size >>= 16;
+            }
+            if (size >= 256)
+            {
+                idx -= 8;
+                size >>= 8;
+            }
+            if (size >= 16)
+            {
+                idx -= 4;
+                size >>= 4;
+            }
+            if (size >= 4)
+            {
+                idx -= 2;
+                size >>= 2;
+            }
+            if (size >= 2)
+            {
+                idx -= 1;
+            }
+            return uint64_t{1} << (64 - idx);
+        }
+
+        /// redis function: _dictExpandIfNeeded
+        /// 检查是否需要并进行扩容
+        bool ExpandIfNeeded()
+        {
+            // 正在 rehash，新表已经足够大
+            if (IsRehashing())
+            {
+                return true;
+            }
+
+            if (ht_[0].size == 0)
+            {
+                return Expand(HT_INITIAL_SIZE);
+            }
+
+            if (ht_[0].used >= ht_[0].size)
+            {
+                return Expand(ht_[0].used * 2);
+            }
+
+            return true;
+        }
+
+        /// redis function: _dictKeyIndex
+        /// 查找能放下参数提供的 key 的表空位，如果 key 在表里已经存在，返回 -1。
+        /// 正在 rehash 时返回的是新表的表空位。hash 由调用者计算，新增节点时直接缓存
+        template <typename KT>
+        int64_t FindBucketIndex(const KT &key, size_t hash)
+        {
+            // 检查需不需要扩容
+            // 扩容失败直接返回 -1。不过目前扩容失败会触发断言错误，这个分支不可能会执行。
+            if (!ExpandIfNeeded())
+            {
+                return -1;
+            }
+
+            int64_t index = -1;
+            for (auto &ht : ht_)
+            {
+                index = hash & ht.sizeMask;
+
+                // 查找是否已经有相同的 key
+                for (const auto &node : ht.table[index])
+                {
+                    if (node.hash == hash && equal_(node.entry.first, key))
+                    {
+                        return -1;
+                    }
+                }
+                if (!IsRehashing())
+                {
+                    break;
+                }
+            }
+
+            return index;
+        }
+
+    private:
+        HashFunction hash_;
+        EqualFunction equal_;
+        /// 两张哈希表，rehash 时元素从 ht_[0] 逐步搬迁到 ht_[1]
+        HashTable ht_[2]{};
+        /// 下一个需要搬迁的 ht_[0] 表空位下标，-1 代表没有在 rehash
+        int64_t rehashIndex_ = -1;
+        /// 大于 0 时暂停渐进式 rehash，安全迭代器和 Scan 期间不能搬迁元素
+        int64_t pauseRehash_ = 0;
+    };
+
+    /// 使用开放寻址法实现的 Dictionary，接口与拉链法的版本相同
+    template <
+        typename KeyType,
+        typename ValueType,
+        typename HashFunction,
+        typename EqualFunction>
+    class Dictionary<KeyType, ValueType, HashFunction, EqualFunction, OpenAddressing>
+        : public FlatDictionary<KeyType, ValueType, HashFunction, EqualFunction>
+    {
+    };
+
+} // namespace base
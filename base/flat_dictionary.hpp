@@ -0,0 +1,749 @@
+#pragma once
+
+#include "base/reference_optional.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace base
+{
+    namespace flat_detail
+    {
+        /// 控制字节：最高位为 1 代表空位或墓碑，最高位为 0 时低 7 位存放哈希值的 H2 部分
+        using ControlByte = int8_t;
+
+        static constexpr ControlByte CTRL_EMPTY = -128;   // 0b10000000
+        static constexpr ControlByte CTRL_DELETED = -2;   // 0b11111110
+        static constexpr ControlByte CTRL_SENTINEL = -1;  // 0b11111111
+
+        /// 一组控制字节的数量，查找时一次比较一整组
+        static constexpr size_t GROUP_WIDTH = 16;
+
+        /// 一组控制字节的匹配操作，返回的位掩码中第 i 位为 1 代表组内第 i 个控制字节匹配
+        class Group
+        {
+        public:
+#if defined(__SSE2__)
+            explicit Group(const ControlByte *position)
+                : ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i *>(position)))
+            {
+            }
+
+            /// 匹配 H2 值相同的空位
+            uint32_t Match(ControlByte h2) const
+            {
+                return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_));
+            }
+
+            /// 匹配空位
+            uint32_t MatchEmpty() const
+            {
+                return Match(CTRL_EMPTY);
+            }
+
+            /// 匹配空位和墓碑，两者都小于 CTRL_SENTINEL
+            uint32_t MatchEmptyOrDeleted() const
+            {
+                return _mm_movemask_epi8(
+                    _mm_cmpgt_epi8(_mm_set1_epi8(CTRL_SENTINEL), ctrl_));
+            }
+
+        private:
+            __m128i ctrl_;
+#else
+            explicit Group(const ControlByte *position)
+            {
+                std::memcpy(ctrl_, position, GROUP_WIDTH);
+            }
+
+            uint32_t Match(ControlByte h2) const
+            {
+                uint32_t mask = 0;
+                for (size_t i = 0; i < GROUP_WIDTH; i++)
+                {
+                    mask |= static_cast<uint32_t>(ctrl_[i] == h2) << i;
+                }
+                return mask;
+            }
+
+            uint32_t MatchEmpty() const
+            {
+                return Match(CTRL_EMPTY);
+            }
+
+            uint32_t MatchEmptyOrDeleted() const
+            {
+                uint32_t mask = 0;
+                for (size_t i = 0; i < GROUP_WIDTH; i++)
+                {
+                    mask |= static_cast<uint32_t>(ctrl_[i] < CTRL_SENTINEL) << i;
+                }
+                return mask;
+            }
+
+        private:
+            ControlByte ctrl_[GROUP_WIDTH];
+#endif
+        };
+
+        /// 取出位掩码中最低位的 1 的下标，并清除该位
+        inline uint32_t PopLowestBit(uint32_t &mask)
+        {
+            auto index = static_cast<uint32_t>(__builtin_ctz(mask));
+            mask &= mask - 1;
+            return index;
+        }
+
+        /// 打散哈希值。std::hash 对整数是恒等映射，不打散的话低 7 位和高位高度相关
+        inline size_t MixHash(size_t hash)
+        {
+            constexpr uint64_t k = 0x9E3779B97F4A7C15ULL;
+            auto product = static_cast<unsigned __int128>(hash) * k;
+            return static_cast<size_t>(product ^ (product >> 64));
+        }
+    } // namespace flat_detail
+
+    /// @brief 开放寻址哈希表
+    /// 参考 abseil 的 SwissTable：元素直接存放在连续的数组里，每个位置对应一个控制字节，
+    /// 查找时用 SSE2 一次比较 16 个控制字节的 H2 值，只有 H2 相同的位置才需要比较 key，
+    /// 不需要为每个元素单独分配链表节点，也没有指针追逐。
+    /// 代价是扩容时一次性重新插入全部元素，不支持渐进式 rehash。
+    template <
+        typename KeyType = int,
+        typename ValueType = int,
+        typename HashFunction = std::hash<KeyType>,
+        typename EqualFunction = std::equal_to<>>
+    class FlatDictionary
+    {
+        using ControlByte = flat_detail::ControlByte;
+        using Group = flat_detail::Group;
+        using Entry = std::pair<const KeyType, ValueType>;
+
+        static constexpr size_t GROUP_WIDTH = flat_detail::GROUP_WIDTH;
+        /// 最小容量为一组控制字节的数量，保证控制字节尾部的镜像区不会和头部重叠
+        static constexpr size_t HT_INITIAL_SIZE = GROUP_WIDTH;
+        /// 已存储元素数量占容量的百分比低于该值时需要缩容
+        static constexpr size_t HT_MIN_FILL_PERCENT = 10;
+
+        /// 哈希函数和比较函数是否都支持异构查找
+        static constexpr bool IS_TRANSPARENT =
+            requires { typename HashFunction::is_transparent; } &&
+            requires { typename EqualFunction::is_transparent; };
+
+        /// 元素的存储空间，只有对应的控制字节为 full 时才构造了元素。
+        /// 同时缓存元素的哈希值，扩容时不需要重新计算 key 的哈希值
+        struct Slot
+        {
+            size_t hash;
+            alignas(Entry) unsigned char storage[sizeof(Entry)];
+
+            Entry *Get()
+            {
+                return std::launder(reinterpret_cast<Entry *>(storage));
+            }
+        };
+
+        /// 三角数探测序列，每次跳过的组数递增 1，容量为 2 的幂时能访问到全部的组
+        class ProbeSequence
+        {
+        public:
+            ProbeSequence(size_t hash, size_t mask)
+                : mask_(mask), offset_(hash & mask)
+            {
+            }
+
+            size_t Offset() const
+            {
+                return offset_;
+            }
+
+            size_t Offset(size_t i) const
+            {
+                return (offset_ + i) & mask_;
+            }
+
+            void Next()
+            {
+                index_ += GROUP_WIDTH;
+                offset_ = (offset_ + index_) & mask_;
+            }
+
+        private:
+            size_t mask_;
+            size_t offset_;
+            size_t index_ = 0;
+        };
+
+    public:
+        FlatDictionary() = default;
+
+        ~FlatDictionary()
+        {
+            DestroyAll();
+        }
+
+        /// 复制构造
+        FlatDictionary(const FlatDictionary &other)
+        {
+            CopyFrom(other);
+        }
+
+        /// 移动构造
+        FlatDictionary(FlatDictionary &&other) noexcept
+        {
+            Swap(other);
+        }
+
+        /// 复制赋值
+        FlatDictionary &operator=(const FlatDictionary &other)
+        {
+            if (this != &other)
+            {
+                DestroyAll();
+                CopyFrom(other);
+            }
+            return *this;
+        }
+
+        /// 移动赋值
+        FlatDictionary &operator=(FlatDictionary &&other) noexcept
+        {
+            if (this != &other)
+            {
+                DestroyAll();
+                Swap(other);
+            }
+            return *this;
+        }
+
+        /// 扩容到能放下 size 个元素的容量，并重新插入全部元素
+        bool Expand(size_t size)
+        {
+            assert(size >= used_ && "不允许比已存储的元素少");
+            auto new_capacity = CapacityFor(size);
+            if (new_capacity == capacity_)
+            {
+                return false;
+            }
+            Resize(new_capacity);
+            return true;
+        }
+
+        /// 将容量自适应到已存储的元素的数量，容量已经合适时返回 false
+        bool Fit()
+        {
+            if (capacity_ == 0)
+            {
+                return false;
+            }
+            return Expand(used_);
+        }
+
+        /// 元素数量远小于容量时，需要缩容
+        bool NeedsShrink()
+        {
+            return capacity_ > HT_INITIAL_SIZE &&
+                   used_ * 100 / capacity_ < HT_MIN_FILL_PERCENT;
+        }
+
+        /// 如果负载过低就缩容，返回 true 代表进行了缩容
+        bool ShrinkIfNeeded()
+        {
+            return NeedsShrink() && Fit();
+        }
+
+        /// 删除全部元素并释放全部内存
+        void Release()
+        {
+            DestroyAll();
+        }
+
+        /// 开放寻址表不做渐进式 rehash，接口与 Dictionary 保持一致
+        bool Rehash(int64_t)
+        {
+            return false;
+        }
+
+        int64_t RehashMilliseconds(int64_t)
+        {
+            return 0;
+        }
+
+        bool IsRehashing() const
+        {
+            return false;
+        }
+
+        /// 添加新的键值对，key 已经存在时返回 false
+        template <typename KT, typename VT>
+        bool Add(KT &&key, VT &&value)
+        {
+            auto hash = Hash(key);
+            if (FindIndex(key, hash) != NOT_FOUND)
+            {
+                return false;
+            }
+
+            auto index = PrepareInsert(hash);
+            ::new (slots_[index].storage) Entry(
+                std::forward<KT>(key), std::forward<VT>(value));
+            return true;
+        }
+
+        /// 替换字典中键为 key 的值成 value，如果 key 不在字典里就新增
+        /// 返回 true 代表新增键值对，返回 false 代表替换
+        template <typename KT, typename VT>
+        bool Replace(KT &&key, VT &&value)
+        {
+            auto hash = Hash(key);
+            auto index = FindIndex(key, hash);
+            if (index != NOT_FOUND)
+            {
+                slots_[index].Get()->second = std::forward<VT>(value);
+                return false;
+            }
+
+            index = PrepareInsert(hash);
+            ::new (slots_[index].storage) Entry(
+                std::forward<KT>(key), std::forward<VT>(value));
+            return true;
+        }
+
+        /// 删除键值对，被删除的位置标记为墓碑
+        template <typename KT>
+        bool Delete(const KT &key)
+        {
+            auto index = FindIndex(key, Hash(key));
+            if (index == NOT_FOUND)
+            {
+                return false;
+            }
+
+            slots_[index].Get()->~Entry();
+            SetControl(index, flat_detail::CTRL_DELETED);
+            used_--;
+            deleted_++;
+            return true;
+        }
+
+        /// 查找键值对，与 Dictionary::Find 一样支持异构查找
+        template <typename KT>
+        ReferenceOptional<Entry> Find(const KT &key)
+        {
+            return Find(key, Hash(key));
+        }
+
+        /// 使用调用者算好的哈希值查找，hash 必须等于 Hash(key)
+        template <typename KT>
+        ReferenceOptional<Entry> Find(const KT &key, size_t hash)
+        {
+            auto index = FindIndex(key, hash);
+            if (index == NOT_FOUND)
+            {
+                return std::nullopt;
+            }
+            return *slots_[index].Get();
+        }
+
+        /// 计算哈希值，H1 决定探测起点，低 7 位的 H2 存进控制字节
+        template <typename KT>
+        size_t Hash(const KT &key) const
+        {
+            if constexpr (IS_TRANSPARENT || std::is_same_v<KT, KeyType>)
+            {
+                return flat_detail::MixHash(hash_(key));
+            }
+            else
+            {
+                return flat_detail::MixHash(hash_(KeyType(key)));
+            }
+        }
+
+        /// 获取已经存储的元素数量
+        auto ElementSize()
+        {
+            return used_;
+        }
+
+        /// 获取表空位的数量
+        auto BucketSize()
+        {
+            return capacity_;
+        }
+
+        /// 是否为空
+        bool Empty()
+        {
+            return used_ == 0;
+        }
+
+        /// 遍历全部键值对的迭代器，只访问控制字节为 full 的位置。
+        /// 删除元素只会留下墓碑，不会移动其他元素，允许在遍历过程中删除当前元素；
+        /// 新增元素可能触发扩容，遍历期间不允许新增
+        class Iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Entry;
+            using difference_type = std::ptrdiff_t;
+            using pointer = Entry *;
+            using reference = Entry &;
+
+            Iterator() = default;
+
+            Iterator(FlatDictionary *dict, size_t index)
+                : dict_(dict), index_(index)
+            {
+                SeekFull();
+            }
+
+            Entry &operator*() const
+            {
+                return *dict_->slots_[index_].Get();
+            }
+
+            Entry *operator->() const
+            {
+                return dict_->slots_[index_].Get();
+            }
+
+            Iterator &operator++()
+            {
+                index_++;
+                SeekFull();
+                return *this;
+            }
+
+            bool operator==(const Iterator &other) const
+            {
+                return index_ == other.index_;
+            }
+
+            bool operator!=(const Iterator &other) const
+            {
+                return index_ != other.index_;
+            }
+
+        private:
+            void SeekFull()
+            {
+                while (index_ < dict_->capacity_ && dict_->control_[index_] < 0)
+                {
+                    index_++;
+                }
+            }
+
+            FlatDictionary *dict_ = nullptr;
+            size_t index_ = 0;
+        };
+
+        /// 与 Dictionary::SafeRange() 保持接口一致，开放寻址表的迭代器本身就允许删除当前元素
+        class SafeIterationRange
+        {
+        public:
+            explicit SafeIterationRange(FlatDictionary *dict)
+                : dict_(dict)
+            {
+            }
+
+            Iterator begin()
+            {
+                return dict_->begin();
+            }
+
+            Iterator end()
+            {
+                return dict_->end();
+            }
+
+        private:
+            FlatDictionary *dict_;
+        };
+
+        Iterator begin()
+        {
+            return Iterator(this, 0);
+        }
+
+        Iterator end()
+        {
+            return Iterator(this, capacity_);
+        }
+
+        SafeIterationRange SafeRange()
+        {
+            return SafeIterationRange(this);
+        }
+
+        /// 无状态的增量遍历，接口与 Dictionary::Scan 相同，每次调用遍历一组位置。
+        /// cursor 同样按反向二进制递增，但是开放寻址表的元素在扩容后不一定落在原位置对应的
+        /// 位置上，两次调用之间发生扩容或缩容时不保证遍历到全部元素
+        template <typename Callback>
+        size_t Scan(size_t cursor, Callback &&callback)
+        {
+            if (used_ == 0)
+            {
+                return 0;
+            }
+
+            auto mask = capacity_ - 1;
+            auto v = cursor;
+            for (size_t i = 0; i < GROUP_WIDTH; i++)
+            {
+                auto index = v & mask;
+                if (control_[index] >= 0)
+                {
+                    callback(*slots_[index].Get());
+                }
+                v |= ~mask;
+                v = ReverseBits(v);
+                v++;
+                v = ReverseBits(v);
+                if (v == 0)
+                {
+                    break;
+                }
+            }
+            return v;
+        }
+
+    private:
+        static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+
+        /// 反转 64 位整数的二进制位
+        static uint64_t ReverseBits(uint64_t v)
+        {
+            v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+            v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+            v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+            return __builtin_bswap64(v);
+        }
+
+        static size_t H1(size_t hash)
+        {
+            return hash >> 7;
+        }
+
+        static ControlByte H2(size_t hash)
+        {
+            return static_cast<ControlByte>(hash & 0x7F);
+        }
+
+        /// 最大负载因子 7/8
+        static size_t MaxLoad(size_t capacity)
+        {
+            return capacity - capacity / 8;
+        }
+
+        /// 计算能放下 size 个元素的最小容量，容量是 2 的幂并且不小于 HT_INITIAL_SIZE
+        static size_t CapacityFor(size_t size)
+        {
+            auto capacity = HT_INITIAL_SIZE;
+            while (MaxLoad(capacity) < size)
+            {
+                capacity <<= 1;
+            }
+            return capacity;
+        }
+
+        /// 查找 key 所在的位置，找不到返回 NOT_FOUND
+        template <typename KT>
+        size_t FindIndex(const KT &key, size_t hash)
+        {
+            if (capacity_ == 0)
+            {
+                return NOT_FOUND;
+            }
+
+            auto sequence = ProbeSequence(H1(hash), capacity_ - 1);
+            auto h2 = H2(hash);
+            while (true)
+            {
+                auto group = Group(control_.get() + sequence.Offset());
+                auto match = group.Match(h2);
+                while (match != 0)
+                {
+                    auto index = sequence.Offset(flat_detail::PopLowestBit(match));
+                    // H2 只有 7 位，再比较完整的哈希值过滤掉大部分误匹配
+                    if (slots_[index].hash == hash && equal_(slots_[index].Get()->first, key))
+                    {
+                        return index;
+                    }
+                }
+                // 遇到空位说明探测链到此结束，墓碑不会终止探测
+                if (group.MatchEmpty() != 0)
+                {
+                    return NOT_FOUND;
+                }
+                sequence.Next();
+            }
+        }
+
+        /// 沿探测序列找到第一个空位或墓碑
+        size_t FindFirstNonFull(size_t hash)
+        {
+            auto sequence = ProbeSequence(H1(hash), capacity_ - 1);
+            while (true)
+            {
+                auto mask = Group(control_.get() + sequence.Offset()).MatchEmptyOrDeleted();
+                if (mask != 0)
+                {
+                    return sequence.Offset(flat_detail::PopLowestBit(mask));
+                }
+                sequence.Next();
+            }
+        }
+
+        /// 为新元素准备位置，必要时扩容或者清理墓碑，返回可以构造元素的位置
+        size_t PrepareInsert(size_t hash)
+        {
+            if (capacity_ == 0)
+            {
+                Resize(HT_INITIAL_SIZE);
+            }
+
+            auto index = FindFirstNonFull(hash);
+            // 复用墓碑不会增加探测链长度，只有占用空位时才需要检查负载
+            if (control_[index] == flat_detail::CTRL_EMPTY &&
+                used_ + deleted_ + 1 > MaxLoad(capacity_))
+            {
+                // 墓碑占比较大时原容量重建即可，否则翻倍扩容
+                auto new_capacity = (used_ + 1) * 2 <= MaxLoad(capacity_)
+                                        ? capacity_
+                                        : capacity_ * 2;
+                Resize(new_capacity);
+                index = FindFirstNonFull(hash);
+            }
+
+            if (control_[index] == flat_detail::CTRL_DELETED)
+            {
+                deleted_--;
+            }
+            SetControl(index, H2(hash));
+            slots_[index].hash = hash;
+            used_++;
+            return index;
+        }
+
+        /// 设置控制字节，头部一组控制字节同时写进尾部的镜像区，
+        /// 让从任意位置开始的整组读取都不需要处理回绕
+        void SetControl(size_t index, ControlByte value)
+        {
+            control_[index] = value;
+            if (index < GROUP_WIDTH)
+            {
+                control_[capacity_ + index] = value;
+            }
+        }
+
+        /// 分配指定容量的新表并重新插入全部元素
+        void Resize(size_t new_capacity)
+        {
+            assert(new_capacity >= HT_INITIAL_SIZE &&
+                   (new_capacity & (new_capacity - 1)) == 0);
+
+            auto old_control = std::move(control_);
+            auto old_slots = std::move(slots_);
+            auto old_capacity = capacity_;
+
+            control_ = std::make_unique<ControlByte[]>(new_capacity + GROUP_WIDTH);
+            std::fill_n(control_.get(), new_capacity + GROUP_WIDTH, flat_detail::CTRL_EMPTY);
+            // 元素存储空间不需要清零，用 new 而不是 make_unique
+            slots_ = std::unique_ptr<Slot[]>(new Slot[new_capacity]);
+            assert(control_ != nullptr && slots_ != nullptr && "Out of memory");
+            capacity_ = new_capacity;
+            deleted_ = 0;
+
+            for (size_t i = 0; i < old_capacity; i++)
+            {
+                if (old_control[i] < 0)
+                {
+                    continue;
+                }
+                auto *entry = old_slots[i].Get();
+                auto hash = old_slots[i].hash;
+                auto index = FindFirstNonFull(hash);
+                SetControl(index, H2(hash));
+                slots_[index].hash = hash;
+                ::new (slots_[index].storage) Entry(std::move(*entry));
+                entry->~Entry();
+            }
+        }
+
+        /// 析构全部元素并释放内存
+        void DestroyAll()
+        {
+            for (size_t i = 0; i < capacity_; i++)
+            {
+                if (control_[i] >= 0)
+                {
+                    slots_[i].Get()->~Entry();
+                }
+            }
+            control_ = nullptr;
+            slots_ = nullptr;
+            capacity_ = 0;
+            used_ = 0;
+            deleted_ = 0;
+        }
+
+        /// 拷贝操作的实现，按原有的布局逐个复制元素
+        void CopyFrom(const FlatDictionary &other)
+        {
+            if (other.capacity_ == 0)
+            {
+                return;
+            }
+            control_ = std::make_unique<ControlByte[]>(other.capacity_ + GROUP_WIDTH);
+            std::copy_n(other.control_.get(), other.capacity_ + GROUP_WIDTH, control_.get());
+            slots_ = std::unique_ptr<Slot[]>(new Slot[other.capacity_]);
+            for (size_t i = 0; i < other.capacity_; i++)
+            {
+                if (other.control_[i] >= 0)
+                {
+                    slots_[i].hash = other.slots_[i].hash;
+                    ::new (slots_[i].storage) Entry(*other.slots_[i].Get());
+                }
+            }
+            capacity_ = other.capacity_;
+            used_ = other.used_;
+            deleted_ = other.deleted_;
+        }
+
+        /// 交换
+        void Swap(FlatDictionary &other) noexcept
+        {
+            std::swap(control_, other.control_);
+            std::swap(slots_, other.slots_);
+            std::swap(capacity_, other.capacity_);
+            std::swap(used_, other.used_);
+            std::swap(deleted_, other.deleted_);
+        }
+
+    private:
+        HashFunction hash_;
+        EqualFunction equal_;
+        /// 控制字节，长度为 capacity_ + GROUP_WIDTH，尾部是头部一组控制字节的镜像
+        std::unique_ptr<ControlByte[]> control_{};
+        std::unique_ptr<Slot[]> slots_{};
+        size_t capacity_ = 0;
+        size_t used_ = 0;
+        /// 墓碑数量
+        size_t deleted_ = 0;
+    };
+
+} // namespace base
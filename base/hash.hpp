@@ -0,0 +1,324 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+namespace base
+{
+
+    /// 字符串哈希算法
+    enum class HashAlgorithm : uint16_t
+    {
+        /// SipHash-1-3，带 128 位密钥，能抵抗哈希洪水攻击，用于对外提供服务的键空间
+        SipHash = 0,
+        /// wyhash，速度最快，但密钥泄露后容易构造碰撞，只用于可信的负载
+        WyHash = 1,
+        /// 标准库实现的 std::hash<std::string_view>
+        StdHash = 2
+    };
+
+    /// 哈希函数的 128 位密钥
+    using HashSeed = std::array<uint8_t, 16>;
+
+    namespace hash_detail
+    {
+        /// 小端序读取 8 字节
+        inline uint64_t Read64(const uint8_t *p)
+        {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        /// 小端序读取 4 字节
+        inline uint64_t Read32(const uint8_t *p)
+        {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint64_t RotateLeft(uint64_t x, int b)
+        {
+            return (x << b) | (x >> (64 - b));
+        }
+
+        /// 128 位乘法，低 64 位写回 a，高 64 位写回 b
+        inline void Multiply(uint64_t &a, uint64_t &b)
+        {
+            auto product = static_cast<unsigned __int128>(a) * b;
+            a = static_cast<uint64_t>(product);
+            b = static_cast<uint64_t>(product >> 64);
+        }
+
+        /// 128 位乘法后把高低 64 位异或
+        inline uint64_t Mix(uint64_t a, uint64_t b)
+        {
+            Multiply(a, b);
+            return a ^ b;
+        }
+
+        /// wyhash 的默认常量
+        inline constexpr uint64_t WY_SECRET[4] = {
+            0xa0761d6478bd642fULL,
+            0xe7037ed1a0b428dbULL,
+            0x8ebc6af09c88c6e3ULL,
+            0x589965cc75374cc3ULL,
+        };
+
+        /// 全局哈希配置，服务启动时设置一次，之后只读
+        struct HashConfig
+        {
+            HashAlgorithm algorithm = HashAlgorithm::SipHash;
+            HashSeed seed{};
+            /// seed 的前 8 字节，wyhash 使用
+            uint64_t seed64 = 0;
+        };
+
+        inline HashConfig g_hash_config{};
+    } // namespace hash_detail
+
+    /// redis function: siphash_1_3
+    /// SipHash 的 1-3 变体：每 8 字节一轮压缩，结束时三轮。
+    /// 相比 SipHash-2-4 快将近一倍，对哈希表场景仍然足够安全，redis 和 CPython 都使用该变体
+    template <int CompressionRounds = 1, int FinalizationRounds = 3>
+    inline uint64_t SipHash(const void *data, size_t length, const HashSeed &seed)
+    {
+        using namespace hash_detail;
+        auto k0 = Read64(seed.data());
+        auto k1 = Read64(seed.data() + 8);
+        uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+        uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+        uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+        uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+        auto round = [&]() {
+            v0 += v1;
+            v1 = RotateLeft(v1, 13);
+            v1 ^= v0;
+            v0 = RotateLeft(v0, 32);
+            v2 += v3;
+            v3 = RotateLeft(v3, 16);
+            v3 ^= v2;
+            v0 += v3;
+            v3 = RotateLeft(v3, 21);
+            v3 ^= v0;
+            v2 += v1;
+            v1 = RotateLeft(v1, 17);
+            v1 ^= v2;
+            v2 = RotateLeft(v2, 32);
+        };
+
+        auto *p = static_cast<const uint8_t *>(data);
+        auto *end = p + (length & ~size_t{7});
+        for (; p != end; p += 8)
+        {
+            auto m = Read64(p);
+            v3 ^= m;
+            for (int i = 0; i < CompressionRounds; i++)
+            {
+                round();
+            }
+            v0 ^= m;
+        }
+
+        // 最后不足 8 字节的部分，最高字节存放长度的低 8 位
+        uint64_t b = static_cast<uint64_t>(length) << 56;
+        switch (length & 7)
+        {
+        case 7:
+            b |= static_cast<uint64_t>(p[6]) << 48;
+            [[fallthrough]];
+        case 6:
+            b |= static_cast<uint64_t>(p[5]) << 40;
+            [[fallthrough]];
+        case 5:
+            b |= static_cast<uint64_t>(p[4]) << 32;
+            [[fallthrough]];
+        case 4:
+            b |= static_cast<uint64_t>(p[3]) << 24;
+            [[fallthrough]];
+        case 3:
+            b |= static_cast<uint64_t>(p[2]) << 16;
+            [[fallthrough]];
+        case 2:
+            b |= static_cast<uint64_t>(p[1]) << 8;
+            [[fallthrough]];
+        case 1:
+            b |= static_cast<uint64_t>(p[0]);
+            break;
+        case 0:
+            break;
+        }
+
+        v3 ^= b;
+        for (int i = 0; i < CompressionRounds; i++)
+        {
+            round();
+        }
+        v0 ^= b;
+        v2 ^= 0xff;
+        for (int i = 0; i < FinalizationRounds; i++)
+        {
+            round();
+        }
+        return v0 ^ v1 ^ v2 ^ v3;
+    }
+
+    /// wyhash（final4 版本）。短 key 只需要一到两次 128 位乘法，长 key 每 48 字节三路并行，
+    /// 吞吐量与 xxh3 同一量级，但不保证抵抗哈希洪水攻击
+    inline uint64_t WyHash(const void *data, size_t length, uint64_t seed)
+    {
+        using namespace hash_detail;
+        const auto *secret = WY_SECRET;
+        auto *p = static_cast<const uint8_t *>(data);
+        seed ^= Mix(seed ^ secret[0], secret[1]);
+
+        uint64_t a = 0;
+        uint64_t b = 0;
+        if (length <= 16)
+        {
+            if (length >= 4)
+            {
+                // 首尾各读两个 4 字节，允许重叠
+                auto offset = (length >> 3) << 2;
+                a = (Read32(p) << 32) | Read32(p + offset);
+                b = (Read32(p + length - 4) << 32) | Read32(p + length - 4 - offset);
+            }
+            else if (length > 0)
+            {
+                a = (static_cast<uint64_t>(p[0]) << 16) |
+                    (static_cast<uint64_t>(p[length >> 1]) << 8) |
+                    p[length - 1];
+            }
+        }
+        else
+        {
+            auto remain = length;
+            if (remain > 48)
+            {
+                auto see1 = seed;
+                auto see2 = seed;
+                do
+                {
+                    seed = Mix(Read64(p) ^ secret[1], Read64(p + 8) ^ seed);
+                    see1 = Mix(Read64(p + 16) ^ secret[2], Read64(p + 24) ^ see1);
+                    see2 = Mix(Read64(p + 32) ^ secret[3], Read64(p + 40) ^ see2);
+                    p += 48;
+                    remain -= 48;
+                } while (remain > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (remain > 16)
+            {
+                seed = Mix(Read64(p) ^ secret[1], Read64(p + 8) ^ seed);
+                p += 16;
+                remain -= 16;
+            }
+            a = Read64(p + remain - 16);
+            b = Read64(p + remain - 8);
+        }
+
+        a ^= secret[1];
+        b ^= seed;
+        Multiply(a, b);
+        return Mix(a ^ secret[0] ^ length, b ^ secret[1]);
+    }
+
+    /// redis function: dictSetHashFunctionSeed
+    /// 设置全局哈希函数的密钥。必须在任何字典存入元素之前调用，
+    /// 否则已经存入的元素的哈希值会和之后计算的对不上
+    inline void SetHashSeed(const HashSeed &seed)
+    {
+        hash_detail::g_hash_config.seed = seed;
+        hash_detail::g_hash_config.seed64 = hash_detail::Read64(seed.data());
+    }
+
+    /// redis function: dictGetHashFunctionSeed
+    inline const HashSeed &GetHashSeed()
+    {
+        return hash_detail::g_hash_config.seed;
+    }
+
+    /// 选择全局使用的字符串哈希算法，与 SetHashSeed 一样只能在启动时调用
+    inline void SetHashAlgorithm(HashAlgorithm algorithm)
+    {
+        hash_detail::g_hash_config.algorithm = algorithm;
+    }
+
+    inline HashAlgorithm GetHashAlgorithm()
+    {
+        return hash_detail::g_hash_config.algorithm;
+    }
+
+    /// redis function: dictGenHashFunction
+    /// 使用全局配置的算法和密钥计算字节串的哈希值
+    inline uint64_t HashBytes(const void *data, size_t length)
+    {
+        const auto &config = hash_detail::g_hash_config;
+        switch (config.algorithm)
+        {
+        case HashAlgorithm::WyHash:
+            return WyHash(data, length, config.seed64);
+        case HashAlgorithm::StdHash:
+            return std::hash<std::string_view>{}(
+                std::string_view(static_cast<const char *>(data), length));
+        case HashAlgorithm::SipHash:
+        default:
+            return SipHash(data, length, config.seed);
+        }
+    }
+
+    /// 支持异构查找的字符串哈希函数，使用全局配置的算法，见 SetHashAlgorithm。
+    /// 任何能隐式转换成 std::string_view 的类型（std::string、const char *、
+    /// SimpleDynamicString）计算出的哈希值都相同，配合 StringEqual 使用时，
+    /// 以 std::string 为 key 的 Dictionary 可以直接用 std::string_view 查找，
+    /// 不需要先构造临时的 std::string
+    struct StringHash
+    {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view key) const noexcept
+        {
+            return HashBytes(key.data(), key.size());
+        }
+    };
+
+    /// 固定使用 SipHash-1-3 的字符串哈希函数，密钥取全局配置
+    struct SipStringHash
+    {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view key) const noexcept
+        {
+            return SipHash(key.data(), key.size(), GetHashSeed());
+        }
+    };
+
+    /// 固定使用 wyhash 的字符串哈希函数，密钥取全局配置
+    struct WyStringHash
+    {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view key) const noexcept
+        {
+            return WyHash(key.data(), key.size(), hash_detail::g_hash_config.seed64);
+        }
+    };
+
+    /// 支持异构查找的字符串比较函数
+    struct StringEqual
+    {
+        using is_transparent = void;
+
+        bool operator()(std::string_view lhs, std::string_view rhs) const noexcept
+        {
+            return lhs == rhs;
+        }
+    };
+
+} // namespace base
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace base
+{
+
+    /// @brief 对数分桶的延迟直方图
+    /// redis: hdr_histogram
+    /// 和 HDR Histogram 一样按 2 的幂分段，每段再均分成 SUB_BUCKETS 个子桶，
+    /// 任何数值的相对误差不超过 1 / SUB_BUCKETS，从 1 纳秒到 2^64 纳秒只需要 500 个计数器。
+    /// 记录一个数值只需要一次 clz 和一次加法，不分配内存，不加锁，只能在一个线程里使用
+    class LatencyHistogram
+    {
+    public:
+        /// 每段的子桶数量的对数
+        static constexpr uint32_t SUB_BUCKET_BITS = 3;
+        static constexpr uint64_t SUB_BUCKETS = 1ULL << SUB_BUCKET_BITS;
+        /// 小于 2 * SUB_BUCKETS 的数值每个数值一个桶
+        static constexpr uint64_t LINEAR_LIMIT = SUB_BUCKETS * 2;
+        static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS) * SUB_BUCKETS + SUB_BUCKETS;
+
+        /// 记录一个数值
+        void Record(uint64_t value)
+        {
+            buckets_[BucketIndex(value)]++;
+            count_++;
+            min_ = std::min(min_, value);
+            max_ = std::max(max_, value);
+        }
+
+        /// 记录的数值数量
+        uint64_t Count() const
+        {
+            return count_;
+        }
+
+        uint64_t Min() const
+        {
+            return count_ == 0 ? 0 : min_;
+        }
+
+        uint64_t Max() const
+        {
+            return max_;
+        }
+
+        /// redis function: hdr_value_at_percentile
+        /// 百分位数，percentile 的范围是 [0, 100]。返回所在桶的上界，不超过记录过的最大值
+        uint64_t ValueAtPercentile(double percentile) const
+        {
+            if (count_ == 0)
+            {
+                return 0;
+            }
+            auto target = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(count_) + 0.5);
+            target = std::clamp<uint64_t>(target, 1, count_);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKET_COUNT; i++)
+            {
+                seen += buckets_[i];
+                if (seen >= target)
+                {
+                    return std::min(BucketUpperBound(i), max_);
+                }
+            }
+            return max_;
+        }
+
+        /// 依次访问不为空的桶，参数是桶的上界和桶里的数值数量
+        template <typename Visitor>
+        void ForEachBucket(Visitor &&visitor) const
+        {
+            for (size_t i = 0; i < BUCKET_COUNT; i++)
+            {
+                if (buckets_[i] != 0)
+                {
+                    visitor(BucketUpperBound(i), buckets_[i]);
+                }
+            }
+        }
+
+        void Reset()
+        {
+            buckets_.fill(0);
+            count_ = 0;
+            min_ = UINT64_MAX;
+            max_ = 0;
+        }
+
+        /// 数值所在的桶
+        static constexpr size_t BucketIndex(uint64_t value)
+        {
+            if (value < LINEAR_LIMIT)
+            {
+                return static_cast<size_t>(value);
+            }
+            // 最高位决定所在的段，接下来的 SUB_BUCKET_BITS 位决定段里的子桶
+            auto shift = static_cast<uint32_t>(std::bit_width(value)) - 1 - SUB_BUCKET_BITS;
+            return static_cast<size_t>(shift * SUB_BUCKETS + (value >> shift));
+        }
+
+        /// 桶里最大的数值
+        static constexpr uint64_t BucketUpperBound(size_t index)
+        {
+            if (index < LINEAR_LIMIT)
+            {
+                return index;
+            }
+            auto shift = index / SUB_BUCKETS - 1;
+            auto mantissa = index % SUB_BUCKETS + SUB_BUCKETS;
+            return ((mantissa + 1) << shift) - 1;
+        }
+
+    private:
+        std::array<uint64_t, BUCKET_COUNT> buckets_{};
+        uint64_t count_ = 0;
+        uint64_t min_ = UINT64_MAX;
+        uint64_t max_ = 0;
+    };
+
+} // namespace base
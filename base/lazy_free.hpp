@@ -0,0 +1,108 @@
+#pragma once
+
+#include "base/marco.hpp"
+#include "base/message_queue.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace base
+{
+
+    /// @brief 后台释放线程
+    /// redis: bio.c 的 BIO_LAZY_FREE 任务
+    /// 释放大对象（例如存有上百万个 key 的键空间）需要逐个析构元素，耗时和元素数量成正比，
+    /// 放在事件循环线程里会阻塞所有客户端。Free() 只把对象的所有权交给后台线程，
+    /// 由后台线程析构，事件循环线程立即返回。
+    /// 交给后台线程的对象不能再被其它线程访问
+    class LazyFree
+    {
+        /// 类型擦除的待释放对象
+        struct Garbage
+        {
+            virtual ~Garbage() = default;
+        };
+
+        template <typename T>
+        struct GarbageOf : Garbage
+        {
+            explicit GarbageOf(std::unique_ptr<T> p)
+                : object(std::move(p))
+            {
+            }
+
+            std::unique_ptr<T> object;
+        };
+
+        using GarbagePtr = std::unique_ptr<Garbage>;
+
+    public:
+        DISABLE_COPY_AND_MOVE(LazyFree)
+
+        LazyFree()
+            : worker_([this] { Worker(); })
+        {
+        }
+
+        /// 释放完队列里剩余的对象后退出后台线程
+        ~LazyFree()
+        {
+            // 空指针是退出信号
+            queue_.Push(GarbagePtr{});
+            if (worker_.joinable())
+            {
+                worker_.join();
+            }
+        }
+
+        /// redis function: bioCreateLazyFreeJob
+        /// 把对象交给后台线程释放
+        template <typename T>
+        void Free(std::unique_ptr<T> object)
+        {
+            if (object == nullptr)
+            {
+                return;
+            }
+            pending_++;
+            queue_.Push(GarbagePtr{std::make_unique<GarbageOf<T>>(std::move(object))});
+        }
+
+        /// redis function: lazyfreeGetPendingObjectsCount
+        /// 还没有释放完的对象数量
+        size_t Pending() const
+        {
+            return pending_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        void Worker()
+        {
+            while (true)
+            {
+                auto garbage = queue_.Pop();
+                if (!garbage.has_value())
+                {
+                    continue;
+                }
+                if (*garbage == nullptr)
+                {
+                    break;
+                }
+                garbage->reset();
+                pending_--;
+            }
+        }
+
+    private:
+        /// 队列不设上限，Free() 永远不会阻塞事件循环
+        MessageQueue<GarbagePtr> queue_{SIZE_MAX};
+        std::atomic<size_t> pending_{0};
+        std::thread worker_;
+    };
+
+} // namespace base
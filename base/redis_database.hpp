@@ -3,20 +3,279 @@
 //
 #pragma once
 #include "base/dictionary.hpp"
-#include <any>
+#include "base/hash.hpp"
+#include "base/lazy_free.hpp"
+#include "base/redis_object.hpp"
+#include "base/reference_optional.hpp"
+#include "base/time_helper.hpp"
 
-namespace base{
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace base
+{
+    /// 一轮定期删除过期 key 的统计
+    struct ExpireCycleStats
+    {
+        /// 检查过的带过期时间的 key 的数量
+        size_t sampled = 0;
+        /// 其中已经过期并被删除的数量
+        size_t expired = 0;
+    };
+
+    /// redis struct: redisDb
+    /// 一个数据库的键空间，key 是字符串，值是带类型标签的 RedisObject。
+    /// 设置了过期时间的 key 另外记录在 expires_ 里，值是过期的毫秒时间戳。
+    /// 过期的 key 有两种删除方式：访问时发现过期立即删除（惰性删除），
+    /// 以及服务端定期调用 ActiveExpireStep 抽查删除（定期删除）
     class RedisDB
     {
-    private:
-        RedisDB() = default;
     public:
-        static RedisDB *GetInstance()
+        /// 键空间使用的哈希表实现。
+        /// 暂时保留拉链法：BENCH_dictionary 里使用键空间同样的 SipHash 时，开放寻址法在 16~120 字节的
+        /// key 上查找和插入都只在 ±15% 的噪声范围内，没有稳定的优势；而它扩容时一次性搬迁全部元素，
+        /// 大键空间扩容会阻塞事件循环，拉链法的渐进式 rehash 没有这个问题。
+        /// 开放寻址法支持渐进式扩容之后再切换，届时 ExpireDict 需要改回保存 key 的副本
+        using KeySpaceEngine = ChainedHashing;
+        /// 键空间的字典类型，哈希和比较函数支持异构查找，
+        /// 可以直接用 std::string_view 或 SimpleDynamicString 查找
+        using KeySpace = Dictionary<std::string, RedisObject, StringHash, StringEqual, KeySpaceEngine>;
+        /// key 到过期时间（毫秒时间戳）的映射。
+        /// key 是指向键空间里的 key 的视图，不再复制一份字符串，key 从键空间删除之前必须先从这里删除。
+        /// 拉链法的节点在 rehash 时整体搬迁，key 的地址在节点释放之前保持不变；
+        /// 两个字典使用相同的哈希函数，查找时可以共用同一个哈希值
+        using ExpireDict = Dictionary<std::string_view, int64_t, StringHash, StringEqual, ChainedHashing>;
+
+        static_assert(std::is_same_v<KeySpaceEngine, ChainedHashing>,
+                      "ExpireDict 引用键空间里的 key，要求键空间的元素地址在 rehash 时保持不变");
+
+        /// redis macro: LAZYFREE_THRESHOLD
+        /// 元素数量超过该值时才交给后台线程释放，小的键空间直接释放比投递任务更快
+        static constexpr size_t LAZYFREE_THRESHOLD = 64;
+
+        explicit RedisDB(int32_t id = 0)
+            : id_(id)
+        {
+        }
+
+        int32_t Id() const
+        {
+            return id_;
+        }
+
+        /// redis function: lookupKey
+        /// 查找 key 对应的值对象，key 已经过期时删除并返回空
+        template <typename KT>
+        ReferenceOptional<RedisObject> LookupKey(const KT &key)
+        {
+            // 只计算一次哈希值，同时用于 expires_ 和 dict_ 的查找
+            auto hash = dict_.Hash(key);
+            if (ExpireIfNeeded(key, hash))
+            {
+                return std::nullopt;
+            }
+            auto entry = dict_.Find(key, hash);
+            if (!entry.has_value())
+            {
+                return std::nullopt;
+            }
+            return entry->get().second;
+        }
+
+        /// redis function: setKey
+        /// 设置 key 的值，key 已经存在时覆盖原来的值，不管原来是什么类型，
+        /// 同时清除原来的过期时间
+        template <typename KT>
+        void SetKey(KT &&key, RedisObject value)
+        {
+            RemoveExpire(key);
+            dict_.Replace(std::forward<KT>(key), std::move(value));
+        }
+
+        /// redis function: dbAdd
+        /// 新增 key，key 已经存在时返回 false
+        template <typename KT>
+        bool Add(KT &&key, RedisObject value)
+        {
+            return dict_.Add(std::forward<KT>(key), std::move(value));
+        }
+
+        /// redis function: dbDelete
+        template <typename KT>
+        bool Delete(const KT &key)
+        {
+            if (!expires_.Empty())
+            {
+                expires_.Delete(key);
+            }
+            return dict_.Delete(key);
+        }
+
+        /// redis function: dbSize
+        /// key 的数量，包括已经过期但还没有被删除的 key
+        size_t Size()
+        {
+            return dict_.ElementSize();
+        }
+
+        /// 设置了过期时间的 key 的数量
+        size_t ExpiresSize()
+        {
+            return expires_.ElementSize();
+        }
+
+        /// redis function: setExpire
+        /// 设置 key 的过期时间（毫秒时间戳），key 不存在时返回 false
+        template <typename KT>
+        bool SetExpire(const KT &key, int64_t when)
         {
-            static RedisDB instance;
-            return &instance;
+            auto entry = dict_.Find(key);
+            if (!entry.has_value())
+            {
+                return false;
+            }
+            expires_.Replace(entry->get().first, when);
+            return true;
         }
+
+        /// redis function: getExpire
+        /// 获取 key 的过期时间（毫秒时间戳），没有设置过期时间时返回 -1
+        template <typename KT>
+        int64_t GetExpire(const KT &key)
+        {
+            if (expires_.Empty())
+            {
+                return -1;
+            }
+            return GetExpire(key, expires_.Hash(key));
+        }
+
+        /// redis function: removeExpire
+        /// 清除 key 的过期时间，原来没有设置过期时间时返回 false
+        template <typename KT>
+        bool RemoveExpire(const KT &key)
+        {
+            if (expires_.Empty())
+            {
+                return false;
+            }
+            return expires_.Delete(key);
+        }
+
+        /// redis function: expireIfNeeded
+        /// key 已经过期时删除它并返回 true
+        template <typename KT>
+        bool ExpireIfNeeded(const KT &key)
+        {
+            return ExpireIfNeeded(key, dict_.Hash(key));
+        }
+
+        /// redis function: activeExpireCycleTryExpire
+        /// 定期删除的一步：从上一次停下的位置继续遍历 expires_，
+        /// 检查最多 max_samples 个 key，删除其中已经过期的 key。
+        /// 为了避免遇到大量空的表空位导致耗时过长，最多访问 max_samples * 20 个表空位
+        ExpireCycleStats ActiveExpireStep(int64_t now, size_t max_samples)
+        {
+            ExpireCycleStats stats;
+            if (expires_.Empty())
+            {
+                return stats;
+            }
+
+            auto max_buckets = max_samples * 20;
+            size_t buckets = 0;
+            do
+            {
+                expiresCursor_ = expires_.Scan(expiresCursor_, [&](auto &entry) {
+                    stats.sampled++;
+                    if (entry.second <= now)
+                    {
+                        // entry.first 指向键空间里的 key，先从 expires_ 删除，再删除键空间里的 key
+                        auto key = entry.first;
+                        expires_.Delete(key);
+                        dict_.Delete(key);
+                        stats.expired++;
+                    }
+                });
+                buckets++;
+            } while (expiresCursor_ != 0 && stats.sampled < max_samples && buckets < max_buckets);
+            return stats;
+        }
+
+        /// redis function: emptyDb
+        /// 清空键空间，返回删除的 key 的数量。
+        /// lazy_free 不为空并且 key 足够多时，整个字典交给后台线程释放，不阻塞调用者
+        size_t Empty(LazyFree *lazy_free = nullptr)
+        {
+            auto removed = Size();
+            if (lazy_free != nullptr && removed > LAZYFREE_THRESHOLD)
+            {
+                lazy_free->Free(std::make_unique<KeySpace>(std::move(dict_)));
+                lazy_free->Free(std::make_unique<ExpireDict>(std::move(expires_)));
+            }
+            else
+            {
+                expires_.Release();
+                dict_.Release();
+            }
+            expiresCursor_ = 0;
+            return removed;
+        }
+
+        /// redis function: dbSwapDatabases
+        /// 交换两个数据库的键空间，编号保持不变，
+        /// 已经选择了其中一个数据库的客户端会立即看到另一个数据库的数据
+        void SwapKeySpace(RedisDB &other)
+        {
+            std::swap(dict_, other.dict_);
+            std::swap(expires_, other.expires_);
+            std::swap(expiresCursor_, other.expiresCursor_);
+        }
+
+        /// 底层的字典，用于 rehash、缩容等维护操作
+        KeySpace &Dict()
+        {
+            return dict_;
+        }
+
+        ExpireDict &Expires()
+        {
+            return expires_;
+        }
+
     private:
-        Dictionary<std::string, std::any> *dict;
+        /// hash 是调用者已经算好的 key 的哈希值
+        template <typename KT>
+        int64_t GetExpire(const KT &key, size_t hash)
+        {
+            if (expires_.Empty())
+            {
+                return -1;
+            }
+            auto entry = expires_.Find(key, hash);
+            return entry.has_value() ? entry->get().second : -1;
+        }
+
+        template <typename KT>
+        bool ExpireIfNeeded(const KT &key, size_t hash)
+        {
+            auto when = GetExpire(key, hash);
+            if (when == -1 || when > NowMilliseconds())
+            {
+                return false;
+            }
+            Delete(key);
+            return true;
+        }
+
+        int32_t id_;
+        KeySpace dict_;
+        ExpireDict expires_;
+        /// 定期删除遍历 expires_ 的游标
+        size_t expiresCursor_ = 0;
     };
-}
\ No newline at end of file
+} // namespace base
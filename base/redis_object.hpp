@@ -0,0 +1,503 @@
+#pragma once
+
+#include "base/dictionary.hpp"
+#include "base/hash.hpp"
+#include "base/list.hpp"
+#include "base/simple_dynamic_string.hpp"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+namespace base
+{
+
+    /// redis macro: OBJ_STRING, OBJ_LIST, OBJ_SET, OBJ_ZSET, OBJ_HASH
+    /// 对象的类型
+    enum class ObjectType : uint8_t
+    {
+        String = 0,
+        List = 1,
+        Set = 2,
+        ZSet = 3,
+        Hash = 4
+    };
+
+    /// redis macro: OBJ_ENCODING_*
+    /// 对象的编码方式，同一种类型可以有多种编码
+    enum class ObjectEncoding : uint8_t
+    {
+        /// 字符串：值能表示成 int64_t，直接存放在对象里
+        Int = 0,
+        /// 字符串：短字符串，直接存放在对象里，不额外分配内存
+        EmbStr = 1,
+        /// 字符串：长字符串，存放在堆上的 SimpleDynamicString
+        Raw = 2,
+        /// 列表：双向链表
+        LinkedList = 3,
+        /// 集合、有序集合、哈希：哈希表
+        HashTable = 4
+    };
+
+    /// redis function: string2ll
+    /// 把字符串转换成整数，只接受规范的十进制表示：不允许前导零、'+'、空白和 "-0"，
+    /// 保证整数再转换回字符串时和原字符串完全相同
+    inline bool StringToInteger(std::string_view s, int64_t &value)
+    {
+        if (s.empty() || s.size() > 20)
+        {
+            return false;
+        }
+        auto digits = s[0] == '-' ? s.substr(1) : s;
+        if (digits.empty() || (digits[0] == '0' && s.size() > 1))
+        {
+            return false;
+        }
+        auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+        return ec == std::errc{} && end == s.data() + s.size();
+    }
+
+    /// @brief 带引用计数的不可变字符串
+    /// redis: robj 的 refcount
+    /// Raw 编码的字符串内容。回复大的字符串时输出缓冲区持有一个引用，直接从这里发送，
+    /// 不复制到输出缓冲区；key 在回复发送完之前被删除或者覆盖时，内容仍然有效。
+    /// 引用可能在 IO 线程或者后台释放线程里释放，引用计数是原子的
+    class SharedString
+    {
+    public:
+        explicit SharedString(std::string_view value)
+            : content_(value)
+        {
+        }
+
+        SharedString(const SharedString &) = delete;
+        SharedString &operator=(const SharedString &) = delete;
+
+        std::string_view View() const
+        {
+            return content_;
+        }
+
+        /// redis function: incrRefCount
+        void IncrRef()
+        {
+            refcount_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// redis function: decrRefCount
+        /// 最后一个引用释放时删除自己
+        void DecrRef()
+        {
+            if (refcount_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                delete this;
+            }
+        }
+
+    private:
+        ~SharedString() = default;
+
+        std::atomic<uint32_t> refcount_{1};
+        SimpleDynamicString content_;
+    };
+
+    /// 持有 SharedString 的一个引用，析构时释放
+    class SharedStringRef
+    {
+    public:
+        SharedStringRef() = default;
+
+        /// 接管一个已经增加过的引用
+        explicit SharedStringRef(SharedString *string)
+            : string_(string)
+        {
+        }
+
+        SharedStringRef(const SharedStringRef &other)
+            : string_(other.string_)
+        {
+            if (string_ != nullptr)
+            {
+                string_->IncrRef();
+            }
+        }
+
+        SharedStringRef(SharedStringRef &&other) noexcept
+            : string_(std::exchange(other.string_, nullptr))
+        {
+        }
+
+        SharedStringRef &operator=(SharedStringRef other) noexcept
+        {
+            std::swap(string_, other.string_);
+            return *this;
+        }
+
+        ~SharedStringRef()
+        {
+            if (string_ != nullptr)
+            {
+                string_->DecrRef();
+            }
+        }
+
+        std::string_view View() const
+        {
+            return string_ == nullptr ? std::string_view() : string_->View();
+        }
+
+        explicit operator bool() const
+        {
+            return string_ != nullptr;
+        }
+
+    private:
+        SharedString *string_ = nullptr;
+    };
+
+    /// @brief 键空间里的值对象
+    /// redis struct: redisObject
+    /// 带类型标签的值，替代 std::any：不做类型擦除，不为整数和短字符串分配内存。
+    /// 整数和不超过 EMBSTR_MAX_LENGTH 字节的字符串直接存放在对象内部，
+    /// 其它类型通过指针持有对应编码的数据结构，对象析构时一起释放。
+    /// redis 用共享的小整数对象减少内存，这里整数本身就存放在对象里，不需要共享。
+    /// 对象只能移动，需要复制时调用 Duplicate()
+    class RedisObject
+    {
+    public:
+        /// 列表编码
+        using ListObject = LinkedList<SimpleDynamicString>;
+        /// 哈希编码
+        using HashObject = Dictionary<std::string, std::string, StringHash, StringEqual>;
+        /// 集合编码，只使用 key
+        using SetObject = Dictionary<std::string, std::monostate, StringHash, StringEqual>;
+        /// 有序集合编码，成员到分值的映射
+        using ZSetObject = Dictionary<std::string, double, StringHash, StringEqual>;
+
+        /// 内嵌字符串的最大长度
+        static constexpr size_t EMBSTR_MAX_LENGTH = 16;
+
+        /// 整数编码转换成字符串时使用的缓冲区，能放下 int64_t 的最小值
+        using IntegerBuffer = std::array<char, 20>;
+
+    public:
+        /// 构造空字符串
+        RedisObject() = default;
+
+        /// redis function: createStringObject, tryObjectEncoding
+        /// 创建字符串对象，自动选择最节省内存的编码
+        static RedisObject CreateString(std::string_view value)
+        {
+            int64_t integer;
+            if (StringToInteger(value, integer))
+            {
+                return CreateInteger(integer);
+            }
+
+            RedisObject object;
+            if (value.size() <= EMBSTR_MAX_LENGTH)
+            {
+                object.encoding_ = ObjectEncoding::EmbStr;
+                object.length_ = static_cast<uint8_t>(value.size());
+                std::memcpy(object.value_.embedded, value.data(), value.size());
+            }
+            else
+            {
+                object.encoding_ = ObjectEncoding::Raw;
+                object.value_.raw = new SharedString(value);
+            }
+            return object;
+        }
+
+        /// redis function: createStringObjectFromLongLong
+        static RedisObject CreateInteger(int64_t value)
+        {
+            RedisObject object;
+            object.encoding_ = ObjectEncoding::Int;
+            object.value_.integer = value;
+            return object;
+        }
+
+        /// redis function: createQuicklistObject
+        static RedisObject CreateList()
+        {
+            RedisObject object;
+            object.type_ = ObjectType::List;
+            object.encoding_ = ObjectEncoding::LinkedList;
+            object.value_.list = new ListObject();
+            return object;
+        }
+
+        /// redis function: createHashObject
+        static RedisObject CreateHash()
+        {
+            RedisObject object;
+            object.type_ = ObjectType::Hash;
+            object.encoding_ = ObjectEncoding::HashTable;
+            object.value_.hash = new HashObject();
+            return object;
+        }
+
+        /// redis function: createSetObject
+        static RedisObject CreateSet()
+        {
+            RedisObject object;
+            object.type_ = ObjectType::Set;
+            object.encoding_ = ObjectEncoding::HashTable;
+            object.value_.set = new SetObject();
+            return object;
+        }
+
+        /// redis function: createZsetObject
+        static RedisObject CreateZSet()
+        {
+            RedisObject object;
+            object.type_ = ObjectType::ZSet;
+            object.encoding_ = ObjectEncoding::HashTable;
+            object.value_.zset = new ZSetObject();
+            return object;
+        }
+
+        RedisObject(const RedisObject &) = delete;
+        RedisObject &operator=(const RedisObject &) = delete;
+
+        /// 移动构造
+        RedisObject(RedisObject &&other) noexcept
+        {
+            Steal(other);
+        }
+
+        /// 移动赋值
+        RedisObject &operator=(RedisObject &&other) noexcept
+        {
+            if (this != &other)
+            {
+                Free();
+                Steal(other);
+            }
+            return *this;
+        }
+
+        /// redis function: decrRefCount
+        ~RedisObject()
+        {
+            Free();
+        }
+
+        /// redis function: dupStringObject
+        /// 深拷贝
+        RedisObject Duplicate() const
+        {
+            RedisObject object;
+            object.type_ = type_;
+            object.encoding_ = encoding_;
+            object.length_ = length_;
+            switch (encoding_)
+            {
+            case ObjectEncoding::Int:
+            case ObjectEncoding::EmbStr:
+                object.value_ = value_;
+                break;
+            case ObjectEncoding::Raw:
+                object.value_.raw = new SharedString(value_.raw->View());
+                break;
+            case ObjectEncoding::LinkedList:
+                object.value_.list = new ListObject(*value_.list);
+                break;
+            case ObjectEncoding::HashTable:
+                if (type_ == ObjectType::Hash)
+                {
+                    object.value_.hash = new HashObject(*value_.hash);
+                }
+                else if (type_ == ObjectType::Set)
+                {
+                    object.value_.set = new SetObject(*value_.set);
+                }
+                else
+                {
+                    object.value_.zset = new ZSetObject(*value_.zset);
+                }
+                break;
+            }
+            return object;
+        }
+
+        ObjectType Type() const
+        {
+            return type_;
+        }
+
+        ObjectEncoding Encoding() const
+        {
+            return encoding_;
+        }
+
+        bool IsString() const
+        {
+            return type_ == ObjectType::String;
+        }
+
+        /// 字符串对象能否表示成整数，能的话返回该整数
+        std::optional<int64_t> GetInteger() const
+        {
+            assert(IsString());
+            if (encoding_ == ObjectEncoding::Int)
+            {
+                return value_.integer;
+            }
+            int64_t integer;
+            if (StringToInteger(StringView(), integer))
+            {
+                return integer;
+            }
+            return std::nullopt;
+        }
+
+        /// redis function: getDecodedObject
+        /// 获取字符串对象的内容。整数编码的对象格式化到调用者提供的 buffer 里，
+        /// 返回的 string_view 在 buffer 和对象被修改或销毁前有效
+        std::string_view StringView(IntegerBuffer &buffer) const
+        {
+            if (encoding_ == ObjectEncoding::Int)
+            {
+                auto [end, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value_.integer);
+                assert(ec == std::errc{});
+                return {buffer.data(), static_cast<size_t>(end - buffer.data())};
+            }
+            return StringView();
+        }
+
+        /// 取得 Raw 编码字符串内容的一个引用，引用释放之前内容一直有效。
+        /// 其它编码的内容存放在对象内部，不能共享，返回空引用
+        SharedStringRef ShareString() const
+        {
+            if (encoding_ != ObjectEncoding::Raw)
+            {
+                return {};
+            }
+            value_.raw->IncrRef();
+            return SharedStringRef(value_.raw);
+        }
+
+        /// redis function: stringObjectLen
+        /// 字符串的长度，整数编码时是十进制表示的长度
+        size_t StringLength() const
+        {
+            IntegerBuffer buffer;
+            return StringView(buffer).size();
+        }
+
+        ListObject &List()
+        {
+            assert(type_ == ObjectType::List);
+            return *value_.list;
+        }
+
+        HashObject &Hash()
+        {
+            assert(type_ == ObjectType::Hash);
+            return *value_.hash;
+        }
+
+        SetObject &Set()
+        {
+            assert(type_ == ObjectType::Set);
+            return *value_.set;
+        }
+
+        ZSetObject &ZSet()
+        {
+            assert(type_ == ObjectType::ZSet);
+            return *value_.zset;
+        }
+
+    private:
+        /// 非整数编码的字符串内容
+        std::string_view StringView() const
+        {
+            assert(IsString() && encoding_ != ObjectEncoding::Int);
+            if (encoding_ == ObjectEncoding::EmbStr)
+            {
+                return {value_.embedded, length_};
+            }
+            return value_.raw->View();
+        }
+
+        /// 接管另一个对象的内容，另一个对象变成空字符串
+        void Steal(RedisObject &other) noexcept
+        {
+            type_ = other.type_;
+            encoding_ = other.encoding_;
+            length_ = other.length_;
+            value_ = other.value_;
+            other.type_ = ObjectType::String;
+            other.encoding_ = ObjectEncoding::EmbStr;
+            other.length_ = 0;
+        }
+
+        /// 释放持有的数据结构，对象变成空字符串
+        void Free() noexcept
+        {
+            switch (encoding_)
+            {
+            case ObjectEncoding::Int:
+            case ObjectEncoding::EmbStr:
+                break;
+            case ObjectEncoding::Raw:
+                value_.raw->DecrRef();
+                break;
+            case ObjectEncoding::LinkedList:
+                delete value_.list;
+                break;
+            case ObjectEncoding::HashTable:
+                if (type_ == ObjectType::Hash)
+                {
+                    delete value_.hash;
+                }
+                else if (type_ == ObjectType::Set)
+                {
+                    delete value_.set;
+                }
+                else
+                {
+                    delete value_.zset;
+                }
+                break;
+            }
+            type_ = ObjectType::String;
+            encoding_ = ObjectEncoding::EmbStr;
+            length_ = 0;
+        }
+
+    private:
+        /// 对象的值，由 encoding_ 决定哪个成员有效
+        union Value
+        {
+            int64_t integer;
+            char embedded[EMBSTR_MAX_LENGTH];
+            SharedString *raw;
+            ListObject *list;
+            HashObject *hash;
+            SetObject *set;
+            ZSetObject *zset;
+        };
+
+        ObjectType type_ = ObjectType::String;
+        ObjectEncoding encoding_ = ObjectEncoding::EmbStr;
+        /// 内嵌字符串的长度
+        uint8_t length_ = 0;
+        Value value_{};
+    };
+
+    static_assert(sizeof(RedisObject) == 24, "RedisObject 应该保持紧凑");
+
+} // namespace base
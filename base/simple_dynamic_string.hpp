@@ -1,27 +1,225 @@
 #pragma once
 
+#include "base/string_simd.hpp"
+
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <new>
 #include <string>
 #include <string_view>
 #include <vector>
 
 namespace base
 {
+    namespace sds_detail
+    {
+        /// redis macro: SDS_TYPE_5, SDS_TYPE_8, SDS_TYPE_16, SDS_TYPE_32, SDS_TYPE_64
+        /// 堆上 SDS 的头部类型，保存在内容前面一个字节（flags）的低 3 位
+        static constexpr uint8_t SDS_TYPE_5 = 0;
+        static constexpr uint8_t SDS_TYPE_8 = 1;
+        static constexpr uint8_t SDS_TYPE_16 = 2;
+        static constexpr uint8_t SDS_TYPE_32 = 3;
+        static constexpr uint8_t SDS_TYPE_64 = 4;
+        static constexpr uint8_t SDS_TYPE_MASK = 7;
+        static constexpr uint8_t SDS_TYPE_BITS = 3;
+
+        /// redis struct: sdshdr5
+        /// 只有 flags，高 5 位是长度，没有记录容量，不能原地追加
+        struct __attribute__((__packed__)) SdsHeader5
+        {
+            uint8_t flags;
+        };
+
+        /// redis struct: sdshdr8
+        struct __attribute__((__packed__)) SdsHeader8
+        {
+            uint8_t len;
+            uint8_t alloc;
+            uint8_t flags;
+        };
+
+        /// redis struct: sdshdr16
+        struct __attribute__((__packed__)) SdsHeader16
+        {
+            uint16_t len;
+            uint16_t alloc;
+            uint8_t flags;
+        };
+
+        /// redis struct: sdshdr32
+        struct __attribute__((__packed__)) SdsHeader32
+        {
+            uint32_t len;
+            uint32_t alloc;
+            uint8_t flags;
+        };
+
+        /// redis struct: sdshdr64
+        struct __attribute__((__packed__)) SdsHeader64
+        {
+            uint64_t len;
+            uint64_t alloc;
+            uint8_t flags;
+        };
+
+        /// redis function: sdsHdrSize
+        inline size_t HeaderSize(uint8_t type)
+        {
+            switch (type)
+            {
+            case SDS_TYPE_5:
+                return sizeof(SdsHeader5);
+            case SDS_TYPE_8:
+                return sizeof(SdsHeader8);
+            case SDS_TYPE_16:
+                return sizeof(SdsHeader16);
+            case SDS_TYPE_32:
+                return sizeof(SdsHeader32);
+            default:
+                return sizeof(SdsHeader64);
+            }
+        }
+
+        /// redis function: sdsReqType
+        /// 能记录 size 的最小头部类型
+        inline uint8_t RequiredType(size_t size)
+        {
+            if (size < (1 << 5))
+            {
+                return SDS_TYPE_5;
+            }
+            if (size < (1 << 8))
+            {
+                return SDS_TYPE_8;
+            }
+            if (size < (1 << 16))
+            {
+                return SDS_TYPE_16;
+            }
+            if (size < (1ULL << 32))
+            {
+                return SDS_TYPE_32;
+            }
+            return SDS_TYPE_64;
+        }
+
+        template <typename Header>
+        Header *HeaderOf(char *buffer)
+        {
+            return reinterpret_cast<Header *>(buffer - sizeof(Header));
+        }
+
+        inline uint8_t TypeOf(const char *buffer)
+        {
+            return static_cast<uint8_t>(buffer[-1]) & SDS_TYPE_MASK;
+        }
+
+        /// redis function: sdslen
+        inline size_t Length(char *buffer)
+        {
+            switch (TypeOf(buffer))
+            {
+            case SDS_TYPE_5:
+                return static_cast<uint8_t>(buffer[-1]) >> SDS_TYPE_BITS;
+            case SDS_TYPE_8:
+                return HeaderOf<SdsHeader8>(buffer)->len;
+            case SDS_TYPE_16:
+                return HeaderOf<SdsHeader16>(buffer)->len;
+            case SDS_TYPE_32:
+                return HeaderOf<SdsHeader32>(buffer)->len;
+            default:
+                return HeaderOf<SdsHeader64>(buffer)->len;
+            }
+        }
+
+        /// redis function: sdsalloc
+        /// 容量，不包括结尾的 '\0'
+        inline size_t Alloc(char *buffer)
+        {
+            switch (TypeOf(buffer))
+            {
+            case SDS_TYPE_5:
+                return Length(buffer);
+            case SDS_TYPE_8:
+                return HeaderOf<SdsHeader8>(buffer)->alloc;
+            case SDS_TYPE_16:
+                return HeaderOf<SdsHeader16>(buffer)->alloc;
+            case SDS_TYPE_32:
+                return HeaderOf<SdsHeader32>(buffer)->alloc;
+            default:
+                return HeaderOf<SdsHeader64>(buffer)->alloc;
+            }
+        }
+
+        /// redis function: sdssetlen
+        inline void SetLength(char *buffer, size_t length)
+        {
+            switch (TypeOf(buffer))
+            {
+            case SDS_TYPE_5:
+                buffer[-1] = static_cast<char>(SDS_TYPE_5 | (length << SDS_TYPE_BITS));
+                break;
+            case SDS_TYPE_8:
+                HeaderOf<SdsHeader8>(buffer)->len = static_cast<uint8_t>(length);
+                break;
+            case SDS_TYPE_16:
+                HeaderOf<SdsHeader16>(buffer)->len = static_cast<uint16_t>(length);
+                break;
+            case SDS_TYPE_32:
+                HeaderOf<SdsHeader32>(buffer)->len = static_cast<uint32_t>(length);
+                break;
+            default:
+                HeaderOf<SdsHeader64>(buffer)->len = length;
+                break;
+            }
+        }
 
+        /// redis function: sdssetalloc
+        /// SDS_TYPE_5 没有容量字段，容量总是等于长度
+        inline void SetAlloc(char *buffer, size_t alloc)
+        {
+            switch (TypeOf(buffer))
+            {
+            case SDS_TYPE_5:
+                break;
+            case SDS_TYPE_8:
+                HeaderOf<SdsHeader8>(buffer)->alloc = static_cast<uint8_t>(alloc);
+                break;
+            case SDS_TYPE_16:
+                HeaderOf<SdsHeader16>(buffer)->alloc = static_cast<uint16_t>(alloc);
+                break;
+            case SDS_TYPE_32:
+                HeaderOf<SdsHeader32>(buffer)->alloc = static_cast<uint32_t>(alloc);
+                break;
+            default:
+                HeaderOf<SdsHeader64>(buffer)->alloc = alloc;
+                break;
+            }
+        }
+    } // namespace sds_detail
+
+    /// @brief 简单动态字符串
+    /// redis: sds.c
+    /// 对象本身 16 字节。不超过 INLINE_CAPACITY 字节的内容直接存放在对象内部，不分配内存；
+    /// 更长的内容和头部放在同一块堆内存里，对象只保存指向内容的指针，
+    /// 头部在内容的前面，长度和容量字段的宽度按字符串的大小选择 1 到 8 字节，
+    /// 短字符串的额外开销只有几个字节。内容的结尾总是有一个 '\0'
     class SimpleDynamicString
     {
     public:
+        /// 直接存放在对象内部的最大长度
+        static constexpr size_t INLINE_CAPACITY = 15;
+
         /// 默认构造空的 SDS
         SimpleDynamicString() = default;
 
         /// 从指定内存地址构造指定长度的 SDS
         SimpleDynamicString(const char *init, size_t init_length)
-            : length_(init_length)
         {
             CreateFrom(init, init_length);
         }
@@ -49,44 +247,74 @@ namespace base
         SimpleDynamicString(SimpleDynamicString &&other) noexcept
         {
             Swap(other);
-            other.length_ = 0;
-            other.free_ = 0;
-            other.buffer_ = nullptr;
+        }
+
+        ~SimpleDynamicString()
+        {
+            Release();
         }
 
         /// 复制赋值
         SimpleDynamicString &operator=(const SimpleDynamicString &other)
         {
-            CopyFrom(other);
+            if (this != &other)
+            {
+                CopyFrom(other);
+            }
             return *this;
         }
 
         /// 移动赋值
         SimpleDynamicString &operator=(SimpleDynamicString &&other) noexcept
         {
-            Swap(other);
-            other.length_ = 0;
-            other.free_ = 0;
-            other.buffer_ = nullptr;
+            if (this != &other)
+            {
+                Clean();
+                Swap(other);
+            }
             return *this;
         }
 
         /// 获取 SDS 的数据指针
         const char *Data() const
         {
-            return buffer_.get();
+            return IsInline() ? storage_ : HeapBuffer();
+        }
+
+        /// 转换成 string_view，不复制数据。
+        /// 用于异构查找时直接拿 SDS 作为 Dictionary 的查找 key
+        operator std::string_view() const noexcept
+        {
+            return {Data(), Length()};
         }
 
         /// 获取 SDS 的长度
         size_t Length() const
         {
-            return length_;
+            return IsInline() ? INLINE_CAPACITY - InlineTag() : sds_detail::Length(HeapBuffer());
         }
 
         /// 剩余未使用的容量
         size_t Avail() const
         {
-            return free_;
+            if (IsInline())
+            {
+                return InlineTag();
+            }
+            auto buffer = HeapBuffer();
+            return sds_detail::Alloc(buffer) - sds_detail::Length(buffer);
+        }
+
+        /// redis function: sdsAllocSize
+        /// 在堆上分配的字节数，包括头部和结尾的 '\0'，内容存放在对象内部时为 0
+        size_t AllocSize() const
+        {
+            if (IsInline())
+            {
+                return 0;
+            }
+            auto buffer = HeapBuffer();
+            return sds_detail::HeaderSize(sds_detail::TypeOf(buffer)) + sds_detail::Alloc(buffer) + 1;
         }
 
         /// TODO: 刷新长度数据，重新计算实际字符串的长度
@@ -95,41 +323,56 @@ namespace base
         /// 追加容量
         void MakeRoomFor(size_t append_length)
         {
-            assert(append_length >= 0);
-
             if (Avail() >= append_length)
             {
                 return;
             }
 
             // 简单两倍扩容
-            auto new_length = (Length() + append_length) << 1;
-            auto new_buffer = std::make_unique<char[]>(new_length + 1);
-            // assert(buffer_ != nullptr && "Out Of Memory");
-            if (buffer_ != nullptr)
+            Reallocate((Length() + append_length) << 1);
+        }
+
+        /// redis function: sdsMakeRoomForNonGreedy
+        /// 追加容量，只分配刚好够用的内存。
+        /// 用于已经知道最终长度的场景，例如接收长度已知的大参数，避免两倍扩容浪费一半内存
+        void MakeRoomForNonGreedy(size_t append_length)
+        {
+            if (Avail() >= append_length)
             {
-                std::copy_n(buffer_.get(), Length(), new_buffer.get());
+                return;
             }
+            Reallocate(Length() + append_length);
+        }
 
-            new_buffer[Length()] = '\0';
+        /// 空闲空间的起始地址。调用者先用 MakeRoomFor 预留空间，直接写入之后调用 IncrLength，
+        /// 例如 read() 直接读进 SDS，不需要经过临时缓冲区再复制一次
+        char *End()
+        {
+            return MutableData() + Length();
+        }
 
-            std::swap(buffer_, new_buffer);
-            free_ = new_length - Length();
+        /// redis function: sdsIncrLen
+        /// 直接写入空闲空间之后更新长度
+        void IncrLength(size_t increment)
+        {
+            assert(increment <= Avail());
+            SetLength(Length() + increment);
         }
 
         /// 追加内容，从指定内存地址读取指定长度的数据追加到当前 SDS 后面
         void Append(const char *target, size_t length)
         {
-            if (Avail() < length)
+            if (length == 0)
             {
-                MakeRoomFor(length);
+                return;
             }
-            for (size_t i = 0; i < length; i++)
+            if (Avail() < length)
             {
-                buffer_[length_++] = target[i];
-                free_--;
+                MakeRoomFor(length);
             }
-            buffer_[length_] = '\0';
+            auto old_length = Length();
+            std::memcpy(MutableData() + old_length, target, length);
+            SetLength(old_length + length);
         }
 
         /// 追加内容，追加 C-Style 字符串到当前 SDS 后面
@@ -142,110 +385,82 @@ namespace base
         /// 追加内容，追加 string_view 的内容到当前 SDS 后面
         void Append(std::string_view target)
         {
-            Append(target.data());
+            Append(target.data(), target.size());
         }
 
         /// 追加内容，将另一个 SDS 追加到当前 SDS 后面
         void Append(const SimpleDynamicString &other)
         {
-            Append(other.buffer_.get(), other.Length());
+            Append(other.Data(), other.Length());
         }
 
-        /// 删除两端的指定字符
+        /// 删除开头和结尾的字符串 c，两端都有时都删除
         /// TODO: 提供 string_view 版本
         void Trim(const char *c)
         {
-            size_t lengthOfC = strlen(c);
-            assert(length_ > lengthOfC);
-            size_t begin = 0;
-            for (; begin < lengthOfC; begin++)
-            {
-                if (c[begin] != buffer_[begin])
-                {
-                    break;
-                }
-            }
-            size_t end = lengthOfC - 1;
-            for (; end >= 0; end--)
-            {
-                if (c[end] != buffer_[end])
-                {
-                    break;
-                }
-            }
-            if (begin == lengthOfC && end > lengthOfC)
-            {
-                Range(begin, Length() - lengthOfC);
-                return;
-            }
-            if (begin == lengthOfC)
+            std::string_view target(c);
+            std::string_view view = *this;
+            size_t begin = view.starts_with(target) ? target.size() : 0;
+            size_t end = Length();
+            if (end - begin >= target.size() && view.substr(begin).ends_with(target))
             {
-                Range(begin, Length());
-                return;
-            }
-            if (end > lengthOfC)
-            {
-                Range(0, Length() - lengthOfC);
-                return;
+                end -= target.size();
             }
+            Range(begin, end);
         }
 
+        /// redis function: sdstrim 的单字符版本
+        /// 删除两端连续的字符 c
         void Trim2(const char c)
         {
-            auto view = std::string_view(buffer_.get());
-            int start = view.find_first_not_of(c);
-            int end = view.find_last_not_of(c) + 1;
+            auto start = simd::CountLeading(Data(), Length(), c);
+            auto end = Length() - simd::CountTrailing(Data() + start, Length() - start, c);
             Range(start, end);
         }
 
+        /// redis function: sdsrange
         /// 保留指定区间内的内容
         /// TODO: 提供 string_view 版本
         void Range(uint64_t start, uint64_t end)
         {
             assert(Length() >= end);
-            assert(start >= 0);
-            uint64_t freeLength = length_ - end + start;
-            if (start != 0)
+            assert(start <= end);
+            auto new_length = end - start;
+            if (start != 0 && new_length > 0)
             {
-                uint64_t current = 0;
-                for (; start < end; start++)
-                {
-                    buffer_[current++] = buffer_[start];
-                }
-                end = current;
+                std::memmove(MutableData(), Data() + start, new_length);
             }
-            length_ = length_ - freeLength;
-            free_ = free_ + freeLength;
-            buffer_[end] = '\0';
+            SetLength(new_length);
         }
 
-        /// 全转小写
+        /// redis function: sdstolower
+        /// 全转小写，只转换 ASCII 字母
         void ToLower()
         {
-            std::transform(&buffer_[0], &buffer_[Length()], &buffer_[0],
-                           [](unsigned char c) { return std::tolower(c); });
+            simd::ToLower(MutableData(), Length());
         }
 
-        /// 全转大写
+        /// redis function: sdstoupper
+        /// 全转大写，只转换 ASCII 字母
         void ToUpper()
         {
-            std::transform(&buffer_[0], &buffer_[Length()], &buffer_[0],
-                           [](unsigned char c) { return std::toupper(c); });
+            simd::ToUpper(MutableData(), Length());
         }
 
-        /// 分割
-        std::vector<std::string> Split(std::string_view separator) const
+        /// redis function: sdssplitlen
+        /// 按 separator 分割，返回指向 SDS 内部的 string_view，不复制内容。
+        /// 结果在 SDS 被修改、移动或者销毁之前有效
+        std::vector<std::string_view> Split(std::string_view separator) const
         {
-            auto data = std::string(buffer_.get());
-            std::vector<std::string> result;
-
-            if (data.find(separator) == std::string_view::npos)
+            std::string_view data = *this;
+            std::vector<std::string_view> result;
+            if (separator.empty())
             {
                 result.push_back(data);
                 return result;
             }
 
-            int index = 0;
+            size_t index = 0;
             while (true)
             {
                 auto indexOf = data.find(separator, index);
@@ -255,7 +470,7 @@ namespace base
                     break;
                 }
                 result.push_back(data.substr(index, indexOf - index));
-                index += (indexOf - index) + separator.length();
+                index = indexOf + separator.length();
             }
             return result;
         }
@@ -264,8 +479,7 @@ namespace base
         /// @Abandoned 无用代码
         std::string_view::size_type IndexOf(std::string_view target)
         {
-            auto view = std::string_view(buffer_.get());
-            return view.find(target);
+            return std::string_view(*this).find(target);
         }
 
         // 查找是否包含目标字符串
@@ -278,78 +492,181 @@ namespace base
         char At(int index)
         {
             // 调用者保证数据不越界
-            auto data = buffer_.get();
-            return data[index];
+            return Data()[index];
         }
 
+        /// 释放内存，变成空字符串
         void Clean() noexcept
         {
-            length_ = 0;
-            free_ = 0;
-            buffer_ = nullptr;
+            Release();
+            SetInlineLength(0);
+        }
+
+        /// redis function: sdsclear
+        /// 清空内容但保留已经分配的内存，之后追加内容不需要重新分配
+        void Clear() noexcept
+        {
+            SetLength(0);
         }
 
     private:
-        /// 初始化的实现
-        void CreateFrom(const char *init, size_t init_length)
+        /// 内容是否存放在对象内部
+        bool IsInline() const
         {
-            assert(length_ >= 0);
+            return (static_cast<uint8_t>(storage_[INLINE_CAPACITY]) & HEAP_FLAG) == 0;
+        }
+
+        /// 内容存放在对象内部时，最后一个字节保存 INLINE_CAPACITY - 长度。
+        /// 长度达到 INLINE_CAPACITY 时这个字节是 0，同时充当结尾的 '\0'
+        size_t InlineTag() const
+        {
+            return static_cast<uint8_t>(storage_[INLINE_CAPACITY]);
+        }
 
-            length_ = init_length;
-            free_ = 0;
+        void SetInlineLength(size_t length)
+        {
+            assert(length <= INLINE_CAPACITY);
+            storage_[INLINE_CAPACITY] = static_cast<char>(INLINE_CAPACITY - length);
+            storage_[length] = '\0';
+        }
 
-            // 分配的内存比指定字符串多一个字节，存放 '\n'
-            buffer_ = std::make_unique<char[]>(length_ + 1);
-            assert(buffer_ != nullptr && "Out Of Memory");
+        char *HeapBuffer() const
+        {
+            char *buffer;
+            std::memcpy(&buffer, storage_, sizeof(buffer));
+            return buffer;
+        }
 
-            if (init != nullptr)
+        void SetHeapBuffer(char *buffer)
+        {
+            std::memcpy(storage_, &buffer, sizeof(buffer));
+            storage_[INLINE_CAPACITY] = static_cast<char>(HEAP_FLAG);
+        }
+
+        char *MutableData()
+        {
+            return IsInline() ? storage_ : HeapBuffer();
+        }
+
+        /// 修改长度并在结尾写入 '\0'，调用者保证不超过容量
+        void SetLength(size_t length)
+        {
+            if (IsInline())
             {
-                std::copy_n(init, length_, buffer_.get());
-                buffer_[length_] = '\0';
+                SetInlineLength(length);
+                return;
             }
-            else
+            auto buffer = HeapBuffer();
+            sds_detail::SetLength(buffer, length);
+            buffer[length] = '\0';
+        }
+
+        /// redis function: sdsnewlen 的内存分配部分
+        /// 分配一块能放下 capacity 字节内容的堆内存，返回内容的起始地址
+        static char *Allocate(uint8_t type, size_t capacity)
+        {
+            auto header_size = sds_detail::HeaderSize(type);
+            auto memory = static_cast<char *>(std::malloc(header_size + capacity + 1));
+            if (memory == nullptr)
             {
-                std::fill_n(buffer_.get(), length_, '\0');
+                throw std::bad_alloc();
             }
+            auto buffer = memory + header_size;
+            buffer[-1] = static_cast<char>(type);
+            return buffer;
         }
 
-        /// 复制构造和赋值的实现函数
-        void CopyFrom(const SimpleDynamicString &other)
+        /// 释放堆内存，不修改对象的状态
+        void Release() noexcept
         {
-            length_ = other.length_;
-            free_ = other.free_;
+            if (!IsInline())
+            {
+                auto buffer = HeapBuffer();
+                std::free(buffer - sds_detail::HeaderSize(sds_detail::TypeOf(buffer)));
+            }
+        }
 
-            if (length_ > 0)
+        /// redis function: _sdsMakeRoomFor
+        /// 把容量调整为 capacity，保留原来的内容
+        void Reallocate(size_t capacity)
+        {
+            auto length = Length();
+            // 需要追加内容的字符串不使用 SDS_TYPE_5，它没有记录容量
+            auto type = std::max(sds_detail::RequiredType(capacity), sds_detail::SDS_TYPE_8);
+            char *buffer;
+            if (!IsInline() && sds_detail::TypeOf(HeapBuffer()) == type)
             {
-                assert(other.buffer_ != nullptr);
+                // 头部类型不变时原地扩容，realloc 可能不需要复制
+                auto header_size = sds_detail::HeaderSize(type);
+                auto memory = static_cast<char *>(
+                    std::realloc(HeapBuffer() - header_size, header_size + capacity + 1));
+                if (memory == nullptr)
+                {
+                    throw std::bad_alloc();
+                }
+                buffer = memory + header_size;
+            }
+            else
+            {
+                buffer = Allocate(type, capacity);
+                std::memcpy(buffer, Data(), length);
+                Release();
+            }
+            SetHeapBuffer(buffer);
+            sds_detail::SetAlloc(buffer, capacity);
+            SetLength(length);
+        }
 
-                buffer_ = std::make_unique<char[]>(length_ + 1);
-                assert(buffer_ != nullptr && "Out Of Memory");
+        /// 初始化的实现，init 为空时内容填充 '\0'
+        void CreateFrom(const char *init, size_t init_length)
+        {
+            char *data;
+            if (init_length <= INLINE_CAPACITY)
+            {
+                data = storage_;
+            }
+            else
+            {
+                auto type = sds_detail::RequiredType(init_length);
+                data = Allocate(type, init_length);
+                SetHeapBuffer(data);
+                sds_detail::SetAlloc(data, init_length);
+            }
 
-                std::copy_n(other.buffer_.get(), length_, buffer_.get());
+            if (init != nullptr)
+            {
+                std::memcpy(data, init, init_length);
             }
             else
             {
-                length_ = 0;
-                free_ = 0;
-                buffer_ = nullptr;
+                std::memset(data, 0, init_length);
             }
+            SetLength(init_length);
+        }
+
+        /// 复制构造和赋值的实现函数，只按内容的长度分配内存
+        void CopyFrom(const SimpleDynamicString &other)
+        {
+            Clean();
+            CreateFrom(other.Data(), other.Length());
         }
 
         /// 交换两个 SDS 的内容
         void Swap(SimpleDynamicString &other) noexcept
         {
-            std::swap(length_, other.length_);
-            std::swap(free_, other.free_);
-            std::swap(buffer_, other.buffer_);
+            std::swap(storage_, other.storage_);
         }
 
     private:
-        uint64_t length_ = 0;
-        uint64_t free_ = 0;
-        std::unique_ptr<char[]> buffer_ = nullptr;
+        /// 最后一个字节的最高位为 1 代表内容在堆上，前 8 个字节是指向内容的指针
+        static constexpr uint8_t HEAP_FLAG = 0x80;
+
+        alignas(char *) char storage_[INLINE_CAPACITY + 1] = {0, 0, 0, 0, 0, 0, 0, 0,
+                                                              0, 0, 0, 0, 0, 0, 0, INLINE_CAPACITY};
     };
 
+    static_assert(sizeof(SimpleDynamicString) == 16);
+
     /// 比较两个 SDS 的内容是否相同
     inline bool operator==(const SimpleDynamicString &lhs, const SimpleDynamicString &rhs)
     {
@@ -372,4 +689,4 @@ namespace base
 
     } // namespace literals
 
-} // namespace base
\ No newline at end of file
+} // namespace base
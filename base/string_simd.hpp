@@ -0,0 +1,275 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TOY_REDIS_X86_SIMD 1
+#endif
+
+namespace base
+{
+    /// @brief SDS 使用的字节处理函数的向量化实现
+    /// 每个函数有标量、SSE2 和 AVX2 三个版本，第一次使用时按 CPU 支持的指令集选择一次，
+    /// 之后通过函数指针调用。AVX2 版本用 target 属性单独编译，不需要给整个程序打开 -mavx2，
+    /// 同一个二进制在不支持 AVX2 的机器上使用 SSE2 版本
+    namespace simd
+    {
+        /// 指令集等级
+        enum class Level
+        {
+            Scalar,
+            SSE2,
+            AVX2
+        };
+
+        /// 一个指令集等级的全部函数
+        struct Kernels
+        {
+            /// ASCII 大写字母转小写，其它字节不变
+            void (*toLower)(char *data, size_t length);
+            /// ASCII 小写字母转大写，其它字节不变
+            void (*toUpper)(char *data, size_t length);
+            /// 开头连续等于 c 的字节数
+            size_t (*countLeading)(const char *data, size_t length, char c);
+            /// 结尾连续等于 c 的字节数
+            size_t (*countTrailing)(const char *data, size_t length, char c);
+        };
+
+        namespace detail
+        {
+            /// 把 [first, last] 区间内的字节加上 delta，大小写转换时 delta 是 ±0x20
+            inline void ShiftRangeScalar(char *data, size_t length, char first, char last, char delta)
+            {
+                for (size_t i = 0; i < length; i++)
+                {
+                    if (data[i] >= first && data[i] <= last)
+                    {
+                        data[i] = static_cast<char>(data[i] + delta);
+                    }
+                }
+            }
+
+            inline void ToLowerScalar(char *data, size_t length)
+            {
+                ShiftRangeScalar(data, length, 'A', 'Z', 'a' - 'A');
+            }
+
+            inline void ToUpperScalar(char *data, size_t length)
+            {
+                ShiftRangeScalar(data, length, 'a', 'z', 'A' - 'a');
+            }
+
+            inline size_t CountLeadingScalar(const char *data, size_t length, char c)
+            {
+                size_t i = 0;
+                while (i < length && data[i] == c)
+                {
+                    i++;
+                }
+                return i;
+            }
+
+            inline size_t CountTrailingScalar(const char *data, size_t length, char c)
+            {
+                size_t i = 0;
+                while (i < length && data[length - 1 - i] == c)
+                {
+                    i++;
+                }
+                return i;
+            }
+
+#if defined(TOY_REDIS_X86_SIMD)
+            /// 有符号比较：0x80 以上的字节是负数，不会落在 ASCII 字母的区间里
+            __attribute__((target("sse2"))) inline void ShiftRangeSSE2(char *data, size_t length, char first,
+                                                                        char last, char delta)
+            {
+                auto lower_bound = _mm_set1_epi8(static_cast<char>(first - 1));
+                auto upper_bound = _mm_set1_epi8(static_cast<char>(last + 1));
+                auto shift = _mm_set1_epi8(delta);
+                size_t i = 0;
+                for (; i + 16 <= length; i += 16)
+                {
+                    auto p = reinterpret_cast<__m128i *>(data + i);
+                    auto v = _mm_loadu_si128(p);
+                    auto in_range = _mm_and_si128(_mm_cmpgt_epi8(v, lower_bound), _mm_cmplt_epi8(v, upper_bound));
+                    _mm_storeu_si128(p, _mm_add_epi8(v, _mm_and_si128(in_range, shift)));
+                }
+                ShiftRangeScalar(data + i, length - i, first, last, delta);
+            }
+
+            inline void ToLowerSSE2(char *data, size_t length)
+            {
+                ShiftRangeSSE2(data, length, 'A', 'Z', 'a' - 'A');
+            }
+
+            inline void ToUpperSSE2(char *data, size_t length)
+            {
+                ShiftRangeSSE2(data, length, 'a', 'z', 'A' - 'a');
+            }
+
+            __attribute__((target("sse2"))) inline size_t CountLeadingSSE2(const char *data, size_t length, char c)
+            {
+                auto target = _mm_set1_epi8(c);
+                size_t i = 0;
+                for (; i + 16 <= length; i += 16)
+                {
+                    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                    auto mismatch = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, target))) & 0xFFFF;
+                    if (mismatch != 0)
+                    {
+                        return i + __builtin_ctz(mismatch);
+                    }
+                }
+                return i + CountLeadingScalar(data + i, length - i, c);
+            }
+
+            __attribute__((target("sse2"))) inline size_t CountTrailingSSE2(const char *data, size_t length, char c)
+            {
+                auto target = _mm_set1_epi8(c);
+                size_t count = 0;
+                for (; count + 16 <= length; count += 16)
+                {
+                    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + length - count - 16));
+                    auto mismatch = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, target))) & 0xFFFF;
+                    if (mismatch != 0)
+                    {
+                        // 掩码的第 15 位对应这 16 个字节里的最后一个字节
+                        return count + __builtin_clz(mismatch) - 16;
+                    }
+                }
+                return count + CountTrailingScalar(data, length - count, c);
+            }
+
+            __attribute__((target("avx2"))) inline void ShiftRangeAVX2(char *data, size_t length, char first,
+                                                                        char last, char delta)
+            {
+                auto lower_bound = _mm256_set1_epi8(static_cast<char>(first - 1));
+                auto upper_bound = _mm256_set1_epi8(static_cast<char>(last + 1));
+                auto shift = _mm256_set1_epi8(delta);
+                size_t i = 0;
+                for (; i + 32 <= length; i += 32)
+                {
+                    auto p = reinterpret_cast<__m256i *>(data + i);
+                    auto v = _mm256_loadu_si256(p);
+                    auto in_range = _mm256_and_si256(_mm256_cmpgt_epi8(v, lower_bound),
+                                                     _mm256_cmpgt_epi8(upper_bound, v));
+                    _mm256_storeu_si256(p, _mm256_add_epi8(v, _mm256_and_si256(in_range, shift)));
+                }
+                ShiftRangeSSE2(data + i, length - i, first, last, delta);
+            }
+
+            inline void ToLowerAVX2(char *data, size_t length)
+            {
+                ShiftRangeAVX2(data, length, 'A', 'Z', 'a' - 'A');
+            }
+
+            inline void ToUpperAVX2(char *data, size_t length)
+            {
+                ShiftRangeAVX2(data, length, 'a', 'z', 'A' - 'a');
+            }
+
+            __attribute__((target("avx2"))) inline size_t CountLeadingAVX2(const char *data, size_t length, char c)
+            {
+                auto target = _mm256_set1_epi8(c);
+                size_t i = 0;
+                for (; i + 32 <= length; i += 32)
+                {
+                    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                    auto mismatch = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, target)));
+                    if (mismatch != 0)
+                    {
+                        return i + __builtin_ctz(mismatch);
+                    }
+                }
+                return i + CountLeadingSSE2(data + i, length - i, c);
+            }
+
+            __attribute__((target("avx2"))) inline size_t CountTrailingAVX2(const char *data, size_t length, char c)
+            {
+                auto target = _mm256_set1_epi8(c);
+                size_t count = 0;
+                for (; count + 32 <= length; count += 32)
+                {
+                    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + length - count - 32));
+                    auto mismatch = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, target)));
+                    if (mismatch != 0)
+                    {
+                        return count + __builtin_clz(mismatch);
+                    }
+                }
+                return count + CountTrailingSSE2(data, length - count, c);
+            }
+#endif
+        } // namespace detail
+
+        /// 当前 CPU 支持的最高指令集等级
+        inline Level DetectLevel()
+        {
+#if defined(TOY_REDIS_X86_SIMD)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return Level::AVX2;
+            }
+            if (__builtin_cpu_supports("sse2"))
+            {
+                return Level::SSE2;
+            }
+#endif
+            return Level::Scalar;
+        }
+
+        /// 指定指令集等级的实现，调用者保证 CPU 支持这个等级。用于测试和性能对比
+        inline const Kernels &KernelsFor(Level level)
+        {
+            static constexpr Kernels scalar{detail::ToLowerScalar, detail::ToUpperScalar,
+                                            detail::CountLeadingScalar, detail::CountTrailingScalar};
+#if defined(TOY_REDIS_X86_SIMD)
+            static constexpr Kernels sse2{detail::ToLowerSSE2, detail::ToUpperSSE2,
+                                          detail::CountLeadingSSE2, detail::CountTrailingSSE2};
+            static constexpr Kernels avx2{detail::ToLowerAVX2, detail::ToUpperAVX2,
+                                          detail::CountLeadingAVX2, detail::CountTrailingAVX2};
+            switch (level)
+            {
+            case Level::AVX2:
+                return avx2;
+            case Level::SSE2:
+                return sse2;
+            case Level::Scalar:
+                break;
+            }
+#endif
+            return scalar;
+        }
+
+        /// 当前 CPU 上最快的实现，第一次调用时检测一次
+        inline const Kernels &Dispatch()
+        {
+            static const Kernels &kernels = KernelsFor(DetectLevel());
+            return kernels;
+        }
+
+        inline void ToLower(char *data, size_t length)
+        {
+            Dispatch().toLower(data, length);
+        }
+
+        inline void ToUpper(char *data, size_t length)
+        {
+            Dispatch().toUpper(data, length);
+        }
+
+        inline size_t CountLeading(const char *data, size_t length, char c)
+        {
+            return Dispatch().countLeading(data, length, c);
+        }
+
+        inline size_t CountTrailing(const char *data, size_t length, char c)
+        {
+            return Dispatch().countTrailing(data, length, c);
+        }
+    } // namespace simd
+} // namespace base
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <ctime>
 #include <sys/time.h>
 
 namespace base
@@ -43,6 +44,16 @@ namespace base
         return ToMicroseconds(Now());
     }
 
+    /// redis function: getMonotonicUs
+    /// 单调时钟的纳秒数，不受系统时间调整影响，只用于计算耗时。
+    /// CLOCK_MONOTONIC 通过 vDSO 读取，不陷入内核
+    inline int64_t MonotonicNanoseconds()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
     inline timeval MicrosecondsToTimeval(int64_t ms)
     {
         auto tv = timeval{};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "base/hash.hpp"
+
 #include <cstdint>
 #include <cstring>
 #include <functional>
@@ -13,8 +15,6 @@
 #define HEADER_HASH_CODE_SIZE 4
 #define HEADER_SIZE HEADER_KEY_LENGTH_SIZE + HEADER_VALUE_LENGTH_SIZE + HEADER_HASH_CODE_SIZE
 
-auto hash = std::hash<std::string_view>{};
-
 namespace base
 {
     struct ZipMapItem
@@ -73,7 +73,7 @@ namespace base
             // 直接把新元素放到后面
             auto start_pointer = buffer_.get() + old_size;
             // 对key进行哈希计算
-            uint32_t hashcode = hash(key_view);
+            uint32_t hashcode = HashCode(key_view);
             AddIndex(hashcode, old_size);
 
             auto hashcode_pointer = start_pointer;
@@ -113,7 +113,7 @@ namespace base
                 item->pointer[0] = '\0';
                 used_ -= 1;
                 wait_freed_ += required_length;
-                DelIndex(hash(key), item->pointer);
+                DelIndex(HashCode(key), item->pointer);
                 return true;
             }
             return false;
@@ -184,7 +184,7 @@ namespace base
                 return std::nullopt;
 
             // 计算需要查找的 key 的 hashcode
-            uint32_t key_hashcode = hash(std::string_view(key));
+            uint32_t key_hashcode = HashCode(std::string_view(key));
 
             // index 查询流程
             for (int i = 0; i < index_used_; i++)
@@ -267,6 +267,12 @@ namespace base
         }
 
     private:
+        /// 计算 key 的 32 位哈希值，与键空间使用同一个全局配置的哈希算法，截取低 32 位
+        static uint32_t HashCode(std::string_view key)
+        {
+            return static_cast<uint32_t>(StringHash{}(key));
+        }
+
         // 迭代 zip map，根据 key length value length 获得下一个位置的指针
         char *Next(char *data_pointer, size_t key_length, size_t value_length)
         {
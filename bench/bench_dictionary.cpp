@@ -0,0 +1,112 @@
+#include "base/dictionary.hpp"
+#include "base/hash.hpp"
+#include "base/time_helper.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+/// 对比拉链法和开放寻址法两种 Dictionary 在读多写少场景下的性能
+/// 用法: BENCH_dictionary [元素数量] [查找次数]
+
+namespace
+{
+    /// 生成指定长度的 key，前缀不同长度的填充字符模拟业务里的长 key
+    std::vector<std::string> MakeKeys(size_t count, size_t key_length)
+    {
+        std::vector<std::string> keys;
+        keys.reserve(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            auto key = "key:" + std::to_string(i);
+            if (key.size() < key_length)
+            {
+                key.insert(0, key_length - key.size(), 'x');
+            }
+            keys.emplace_back(std::move(key));
+        }
+        return keys;
+    }
+
+    template <typename Dict>
+    void Run(const char *name, const std::vector<std::string> &keys,
+             const std::vector<std::string> &misses, const std::vector<uint32_t> &lookups)
+    {
+        Dict dict;
+
+        auto start = base::NowMicroseconds();
+        for (const auto &key : keys)
+        {
+            dict.Add(key, key.size());
+        }
+        while (dict.IsRehashing())
+        {
+            dict.RehashMilliseconds(100);
+        }
+        auto insert_us = base::NowMicroseconds() - start;
+
+        size_t hits = 0;
+        start = base::NowMicroseconds();
+        for (auto index : lookups)
+        {
+            // 下标超出范围的查找用一个不存在的 key 模拟未命中
+            if (index < keys.size())
+            {
+                hits += dict.Find(keys[index]).has_value();
+            }
+            else
+            {
+                hits += dict.Find(misses[index - keys.size()]).has_value();
+            }
+        }
+        auto find_us = base::NowMicroseconds() - start;
+
+        printf("%-16s key=%3zu  insert %8.2f Mops/s  find %8.2f Mops/s  hits=%zu\n",
+               name, keys.front().size(),
+               static_cast<double>(keys.size()) / static_cast<double>(insert_us),
+               static_cast<double>(lookups.size()) / static_cast<double>(find_us),
+               hits);
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 1 << 20;
+    size_t lookup_count = argc > 2 ? std::stoul(argv[2]) : 10000000;
+
+    // 90% 命中，10% 未命中
+    std::mt19937 rng(20221018);
+    std::uniform_int_distribution<uint32_t> hit(0, count - 1);
+    std::vector<uint32_t> lookups(lookup_count);
+    for (size_t i = 0; i < lookup_count; i++)
+    {
+        lookups[i] = hit(rng) + (i % 10 == 0 ? count : 0);
+    }
+
+    using Chained = base::Dictionary<std::string, size_t>;
+    using Flat = base::Dictionary<std::string, size_t, std::hash<std::string>,
+                                  std::equal_to<>, base::OpenAddressing>;
+    // 和 RedisDB::KeySpace 相同的哈希函数（默认 SipHash）
+    using ChainedKeySpace = base::Dictionary<std::string, size_t, base::StringHash, base::StringEqual>;
+    using FlatKeySpace = base::Dictionary<std::string, size_t, base::StringHash, base::StringEqual,
+                                          base::OpenAddressing>;
+
+    for (size_t key_length : {16, 64, 120})
+    {
+        auto keys = MakeKeys(count, key_length);
+        // 未命中的 key 提前生成，不把构造字符串的时间算进查找
+        std::vector<std::string> misses;
+        misses.reserve(keys.size());
+        for (const auto &key : keys)
+        {
+            misses.emplace_back(key + "-");
+        }
+        Run<Chained>("ChainedHashing", keys, misses, lookups);
+        Run<Flat>("OpenAddressing", keys, misses, lookups);
+        Run<ChainedKeySpace>("Chained/SipHash", keys, misses, lookups);
+        Run<FlatKeySpace>("Flat/SipHash", keys, misses, lookups);
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "base/hash.hpp"
+#include "base/time_helper.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// 对比不同字符串哈希算法在各种 key 长度下的吞吐量
+/// 用法: BENCH_hash [每种长度计算的总字节数，单位 MB]
+
+namespace
+{
+    /// 防止编译器把哈希计算当成无用代码优化掉
+    volatile uint64_t g_sink = 0;
+
+    template <typename Hasher>
+    void Run(const char *name, const std::vector<std::string> &keys, size_t rounds, Hasher &&hasher)
+    {
+        uint64_t sum = 0;
+        auto start = base::NowMicroseconds();
+        for (size_t round = 0; round < rounds; round++)
+        {
+            for (const auto &key : keys)
+            {
+                sum += hasher(std::string_view(key));
+            }
+        }
+        auto elapsed_us = base::NowMicroseconds() - start;
+        g_sink = g_sink + sum;
+
+        auto count = static_cast<double>(rounds * keys.size());
+        auto bytes = count * static_cast<double>(keys.front().size());
+        auto seconds = static_cast<double>(elapsed_us) / 1e6;
+        printf("%-10s key=%5zu  %9.2f Mhash/s  %8.2f GB/s\n",
+               name, keys.front().size(),
+               count / seconds / 1e6,
+               bytes / seconds / 1e9);
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    size_t total_mb = argc > 1 ? std::stoul(argv[1]) : 512;
+    base::HashSeed seed{};
+    for (size_t i = 0; i < seed.size(); i++)
+    {
+        seed[i] = static_cast<uint8_t>(i * 13 + 1);
+    }
+    base::SetHashSeed(seed);
+
+    for (size_t key_length : {8, 16, 32, 64, 120, 256, 1024, 4096})
+    {
+        // 1024 个不同的 key 循环计算，数据常驻 L1/L2，测的是纯计算吞吐量
+        std::vector<std::string> keys;
+        for (size_t i = 0; i < 1024; i++)
+        {
+            auto key = std::to_string(i);
+            key.insert(0, key_length - key.size(), 'k');
+            keys.emplace_back(std::move(key));
+        }
+        auto rounds = std::max<size_t>(1, total_mb * 1024 * 1024 / (key_length * keys.size()));
+
+        Run("std::hash", keys, rounds, std::hash<std::string_view>{});
+        Run("SipHash13", keys, rounds, base::SipStringHash{});
+        Run("WyHash", keys, rounds, base::WyStringHash{});
+        printf("\n");
+    }
+    return 0;
+}
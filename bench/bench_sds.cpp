@@ -0,0 +1,114 @@
+#include "base/simple_dynamic_string.hpp"
+#include "base/string_simd.hpp"
+#include "base/time_helper.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+/// 对比 SDS 各个操作在不同长度下的吞吐量，大小写转换和两端裁剪分别测试每个指令集等级
+/// 用法: BENCH_sds [每种长度处理的总字节数，单位 MB]
+
+namespace
+{
+    /// 防止编译器把结果当成无用代码优化掉
+    volatile uint64_t g_sink = 0;
+
+    template <typename Operation>
+    void Run(const char *name, size_t length, size_t rounds, Operation &&operation)
+    {
+        uint64_t sum = 0;
+        auto start = base::NowMicroseconds();
+        for (size_t round = 0; round < rounds; round++)
+        {
+            sum += operation();
+        }
+        auto elapsed_us = std::max<int64_t>(1, base::NowMicroseconds() - start);
+        g_sink = g_sink + sum;
+
+        auto bytes = static_cast<double>(rounds) * static_cast<double>(length);
+        auto seconds = static_cast<double>(elapsed_us) / 1e6;
+        printf("%-16s len=%8zu  %10.2f Mops/s  %8.2f GB/s\n",
+               name, length,
+               static_cast<double>(rounds) / seconds / 1e6,
+               bytes / seconds / 1e9);
+    }
+
+    const char *LevelName(base::simd::Level level)
+    {
+        switch (level)
+        {
+        case base::simd::Level::AVX2:
+            return "avx2";
+        case base::simd::Level::SSE2:
+            return "sse2";
+        case base::simd::Level::Scalar:
+            break;
+        }
+        return "scalar";
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    size_t total_mb = argc > 1 ? std::stoul(argv[1]) : 256;
+    auto detected = base::simd::DetectLevel();
+    printf("detected: %s\n\n", LevelName(detected));
+
+    for (size_t length : {8, 64, 512, 4096, 32768, 262144, 1048576})
+    {
+        std::string content(length, 0);
+        for (size_t i = 0; i < length; i++)
+        {
+            content[i] = static_cast<char>("Hello, Redis! "[i % 14]);
+        }
+        auto rounds = std::max<size_t>(16, total_mb * 1024 * 1024 / length);
+
+        base::SimpleDynamicString sds;
+        Run("Append", length, rounds, [&] {
+            sds.Clear();
+            sds.Append(content);
+            return sds.Length();
+        });
+
+        base::SimpleDynamicString range(content);
+        Run("Range", length, rounds, [&] {
+            // 删除开头 1 个字节再补回去，每次移动 length - 1 个字节
+            range.Range(1, range.Length());
+            range.Append("H", 1);
+            return range.Length();
+        });
+
+        std::string padded(length, ' ');
+        padded[length / 2] = 'x';
+        for (auto level : {base::simd::Level::Scalar, base::simd::Level::SSE2, base::simd::Level::AVX2})
+        {
+            if (level > detected)
+            {
+                continue;
+            }
+            auto &kernels = base::simd::KernelsFor(level);
+            std::string name = std::string("ToLower/") + LevelName(level);
+            auto lower = content;
+            Run(name.c_str(), length, rounds, [&] {
+                kernels.toLower(lower.data(), length);
+                kernels.toUpper(lower.data(), length);
+                return static_cast<uint64_t>(lower[0]);
+            });
+            name = std::string("Trim/") + LevelName(level);
+            Run(name.c_str(), length, rounds, [&] {
+                auto leading = kernels.countLeading(padded.data(), length, ' ');
+                return leading + kernels.countTrailing(padded.data() + leading, length - leading, ' ');
+            });
+        }
+
+        base::SimpleDynamicString split(content);
+        Run("Split", length, std::max<size_t>(1, rounds / 8), [&] {
+            return split.Split(" ").size();
+        });
+        printf("\n");
+    }
+    return 0;
+}
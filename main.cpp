@@ -1,10 +1,49 @@
 #include "base/hello.h"
 
+#include "toy-redis/multi_reactor_server.hpp"
 #include "toy-redis/server.hpp"
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
-int main(int, char **)
+int main(int argc, char **argv)
 {
     std::cout << HelloMessage() << std::endl;
-    tr::ToyRedisServer server("");
+    tr::ToyRedisServer::ServerConfig config;
+    // 和 redis-server 一样支持在命令行覆盖配置，例如 --io-threads 4
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--io-threads") == 0)
+        {
+            config.ioThreads = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--port") == 0)
+        {
+            config.port = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--reactors") == 0)
+        {
+            config.reactors = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--edge-triggered") == 0)
+        {
+            config.edgeTriggered = strcmp(argv[i + 1], "yes") == 0;
+        }
+        else if (strcmp(argv[i], "--io-uring") == 0)
+        {
+            config.ioUring = strcmp(argv[i + 1], "yes") == 0;
+        }
+        else if (strcmp(argv[i], "--zero-copy-threshold") == 0)
+        {
+            config.zeroCopyThreshold = strtoull(argv[i + 1], nullptr, 10);
+        }
+    }
+    if (config.reactors > 1)
+    {
+        tr::MultiReactorServer server("", config);
+        server.Run();
+        return 0;
+    }
+    tr::ToyRedisServer server("", config);
+    server.Run();
 }
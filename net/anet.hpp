@@ -13,7 +13,9 @@
 #include <cstdio>
 #include <cstring>
 #include <error.h>
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 
 namespace net {
@@ -25,7 +27,9 @@ namespace net {
         RedisNet() = default;
         ~RedisNet() = default;
         // 创建tcp服务
-        int anetTcpServer(char *err, int port, const char *bindaddr)
+        // reuse_port 为 true 时设置 SO_REUSEPORT，多个事件循环可以各自监听同一个端口，
+        // 由内核把新连接分配给其中一个监听 socket
+        int anetTcpServer(char *err, int port, const char *bindaddr, bool reuse_port = false)
         {
             int s;
             struct sockaddr_in sa;
@@ -33,6 +37,10 @@ namespace net {
             if ((s = anetCreateSocket(err, AF_INET)) == ANET_ERR) {
                 return ANET_ERR;
             }
+            if (reuse_port && anetSetReusePort(err, s) == ANET_ERR) {
+                close(s);
+                return ANET_ERR;
+            }
 
             memset(&sa,0,sizeof(sa));
             sa.sin_family = AF_INET;
@@ -62,15 +70,77 @@ namespace net {
         }
 
         // 新的tcp链接的处理函数
-        void acceptTcpHandler(int fd, std::function<void(std::shared_ptr<tr::RedisClient>)> handler) {
+        // redis function: acceptTcpHandler
+        // 一次可读事件最多接受 max_accepts 个连接，没有等待的连接时返回。
+        // 监听 socket 必须是非阻塞的；边缘触发时需要一直接受到 EAGAIN，max_accepts 传 SIZE_MAX。
+        // 对端在 accept 之前重置的连接直接跳过，继续接受后面的连接。
+        // 因为其它错误（例如 fd 用尽的 EMFILE/ENFILE）停止时返回 false，等待的连接可能还留在队列里
+        bool acceptTcpHandler(int fd, std::function<void(std::shared_ptr<tr::RedisClient>)> handler,
+                              size_t max_accepts = MAX_ACCEPTS_PER_CALL) {
             int cPort, cfd;
             char ip[128];
             char netErr[net::ANET_ERR_LEN];
-            cfd = anetTcpAccept(netErr, fd, ip, &cPort);
-            if (cfd == net::ANET_ERR) {
-                return;
+            while (max_accepts--) {
+                cfd = anetTcpAccept(netErr, fd, ip, &cPort);
+                if (cfd == net::ANET_ERR) {
+                    if (errno == EWOULDBLOCK || errno == EAGAIN) {
+                        return true;
+                    }
+                    if (errno == ECONNABORTED || errno == EPROTO || errno == EINTR) {
+                        continue;
+                    }
+                    fprintf(stderr, "Accepting client connection: %s\n", netErr);
+                    return false;
+                }
+                acceptCommonHandler(cfd, handler);
             }
-            acceptCommonHandler(cfd, handler);
+            return true;
+        }
+
+        // 为新连接创建客户端，连接由 accept 或者 io_uring 的 accept 完成事件得到
+        void acceptCommonHandler(int fd, std::function<void(std::shared_ptr<tr::RedisClient>)> handler){
+            // accept4 已经把 socket 设置为非阻塞，输出缓冲区依赖非阻塞的 socket 处理部分写入
+            char netErr[net::ANET_ERR_LEN];
+            anetEnableTcpNoDelay(netErr, fd);
+            // todo 创建客户端
+            auto c = tr::RedisClient::CreateClient(fd);
+            // 添加到server中
+            handler(c);
+            // todo 添加处理回调函数
+        }
+
+        // 设置非阻塞模式，读写不完整时立即返回 EAGAIN，由事件循环在下一轮继续处理
+        int anetNonBlock(char *err, int fd) {
+            int flags;
+            if ((flags = fcntl(fd, F_GETFL)) == -1) {
+                anetSetError(err, "fcntl(F_GETFL): %s", strerror(errno));
+                return ANET_ERR;
+            }
+            if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+                anetSetError(err, "fcntl(F_SETFL,O_NONBLOCK): %s", strerror(errno));
+                return ANET_ERR;
+            }
+            return ANET_OK;
+        }
+
+        // 关闭 Nagle 算法，小的回复立即发送
+        int anetEnableTcpNoDelay(char *err, int fd) {
+            int yes = 1;
+            if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)) == -1) {
+                anetSetError(err, "setsockopt TCP_NODELAY: %s", strerror(errno));
+                return ANET_ERR;
+            }
+            return ANET_OK;
+        }
+
+        // 允许在这个 socket 上使用 MSG_ZEROCOPY 发送，内核不支持时返回 ANET_ERR
+        int anetSetZeroCopy(char *err, int fd) {
+            int yes = 1;
+            if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &yes, sizeof(yes)) == -1) {
+                anetSetError(err, "setsockopt SO_ZEROCOPY: %s", strerror(errno));
+                return ANET_ERR;
+            }
+            return ANET_OK;
         }
 
     private:
@@ -87,6 +157,15 @@ namespace net {
             return s;
         }
 
+        int anetSetReusePort(char *err, int s) {
+            int yes = 1;
+            if (setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) == -1) {
+                anetSetError(err, "setsockopt SO_REUSEPORT: %s", strerror(errno));
+                return ANET_ERR;
+            }
+            return ANET_OK;
+        }
+
         void anetSetError(char *err, const char *fmt, ...) {
             va_list ap;
 
@@ -96,10 +175,11 @@ namespace net {
             va_end(ap);
         }
 
+        // accept4 直接创建非阻塞、exec 时关闭的 socket，省掉两次 fcntl
         int anetGenericAccept(char *err, int s, struct sockaddr *sa, socklen_t *len) {
             int fd;
             while(1) {
-                fd = accept(s,sa,len);
+                fd = accept4(s,sa,len,SOCK_NONBLOCK|SOCK_CLOEXEC);
                 if (fd == -1) {
                     if (errno == EINTR)
                         continue;
@@ -127,14 +207,6 @@ namespace net {
             return ANET_OK;
         }
 
-        void acceptCommonHandler(int fd, std::function<void(std::shared_ptr<tr::RedisClient>)> handler){
-            // todo 创建客户端
-            auto c = tr::RedisClient::CreateClient(fd);
-            // 添加到server中
-            handler(c);
-            // todo 添加处理回调函数
-        }
-
     private:
     };
 }
\ No newline at end of file
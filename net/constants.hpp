@@ -11,7 +11,12 @@ namespace net
         static constexpr int ANET_ERR_LEN = 256;
         static constexpr int ANET_ERR = -1;
         static constexpr int ANET_OK = 0;
-        static constexpr int REDIS_IOBUF_LEN = 1024;
+        /// redis macro: PROTO_IOBUF_LEN
+        /// 每次从 socket 读取的最大字节数，需要足够大才能一次读入整批 pipeline 命令
+        static constexpr int REDIS_IOBUF_LEN = 16 * 1024;
+        /// redis macro: MAX_ACCEPTS_PER_CALL
+        /// 水平触发时每次监听 socket 可读最多接受的连接数量，避免连接风暴时长时间占用事件循环
+        static constexpr size_t MAX_ACCEPTS_PER_CALL = 1000;
 
     }
 } // namespace net
\ No newline at end of file
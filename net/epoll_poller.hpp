@@ -8,6 +8,7 @@
 #include "net/constants.hpp"
 #include "net/poller_types.hpp"
 
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -30,6 +31,21 @@ namespace net
             epfd_ = epoll_create(1024);
         }
 
+        /// 切换到边缘触发模式，之后注册的 fd 都带上 EPOLLET，必须在注册任何 fd 之前调用。
+        /// 边缘触发时 fd 只在状态变化时通知一次，事件处理函数必须一直读写到 EAGAIN，
+        /// 否则剩下的数据不会再触发事件。好处是一次通知可以处理完 fd 上的全部数据，
+        /// 大量连接同时活跃时 epoll_wait 返回的次数更少
+        void SetEdgeTriggered(bool edge_triggered)
+        {
+            assert(max_fd_ == -1 && "必须在注册 fd 之前设置");
+            edge_triggered_ = edge_triggered;
+        }
+
+        bool IsEdgeTriggered() const
+        {
+            return edge_triggered_;
+        }
+
         int32_t AddEvent(int32_t fd, int32_t events)
         {
 
@@ -45,6 +61,8 @@ namespace net
                 ee.events |= EPOLLIN;
             if (events & Event::Write)
                 ee.events |= EPOLLOUT;
+            if (edge_triggered_)
+                ee.events |= EPOLLET;
             std::cout << "add event fd is " << fd << " and events is " << ee.events << std::endl;
             ee.data.fd = fd;
             // 判断是否加入成功
@@ -69,6 +87,8 @@ namespace net
                 ee.events |= EPOLLIN;
             if (mask & Event::Write)
                 ee.events |= EPOLLOUT;
+            if (edge_triggered_)
+                ee.events |= EPOLLET;
 
             ee.data.fd = fd;
             if (mask != Event::None)
@@ -101,6 +121,9 @@ namespace net
                         mask |= Event::Read;
                     if (e->events & EPOLLOUT)
                         mask |= Event::Write;
+                    // 出错或者对端关闭时交给读写处理函数，由 read/write 的返回值发现错误
+                    if (e->events & (EPOLLERR | EPOLLHUP))
+                        mask |= Event::Read | Event::Write;
                     // if (fired_fds_.)
                     fired_fds_.EmplaceBack((int32_t)e->data.fd, mask);
                 }
@@ -138,7 +161,9 @@ namespace net
     private:
         int epfd_{-1};
         int max_fd_{-1};
-        struct FiredEvent fdEvent[MAX_NUMBER_OF_FD];
+        bool edge_triggered_{false};
+        // 必须初始化为 Event::None，AddEvent 据此选择 EPOLL_CTL_ADD 或者 EPOLL_CTL_MOD
+        struct FiredEvent fdEvent[MAX_NUMBER_OF_FD]{};
         struct epoll_event eEvents[MAX_NUMBER_OF_FD];
         // epoll_wait() 返回后触发了 io 事件的 fd 队列
         base::RingQueue<FiredEvent, MAX_NUMBER_OF_FD> fired_fds_;
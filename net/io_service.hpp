@@ -13,6 +13,7 @@
 #include "net/timer.hpp"
 
 #include <any>
+#include <atomic>
 #include <array>
 #include <cassert>
 #include <cstddef>
@@ -76,6 +77,7 @@ namespace net
         }
 
         /// redis function: aeStop
+        /// 允许跨线程调用，跨线程调用后需要 WakeUp() 让阻塞中的 poller 立即返回
         void Stop()
         {
             stop_ = true;
@@ -123,6 +125,12 @@ namespace net
             return true;
         }
 
+        /// 底层的 poller，用于设置 poller 特有的选项
+        PollerType &GetPoller()
+        {
+            return poller_;
+        }
+
         /// redis function: aeDeleteFileEvent
         /// 移除事件监听
         void DeleteEventListener(int32_t fd, Event event)
@@ -288,6 +296,8 @@ namespace net
                 if (fired_event.events & mask & Event::Read) {
                     ev.read_handler_(fired_event.fd, fired_event.events, ev.client_data_);
                 }
+                // 读事件的处理函数可能已经关闭了连接，重新检查写事件是否还在监听
+                mask = poller_.GetFdEventByFd(fired_event.fd).events;
                 if (fired_event.events & mask & Event::Write) {
                     ev.write_handler_(fired_event.fd, fired_event.events, ev.client_data_);
                 }
@@ -428,7 +438,7 @@ namespace net
         PendingTaskQueue pending_task_queue_{};
         /// 用于提前唤醒 poller 的管道
         ipc::SimplePipeline notify_pipe_;
-        bool stop_{false};
+        std::atomic<bool> stop_{false};
         base::Log io_service_logger;
     };
 
@@ -0,0 +1,772 @@
+#pragma once
+
+#include "base/marco.hpp"
+#include "base/ring_queue.hpp"
+#include "net/constants.hpp"
+#include "net/epoll_poller.hpp"
+#include "net/poller_types.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace net
+{
+    /// @brief 基于 io_uring 的 poller
+    /// 监听 fd 用 IORING_OP_POLL_ADD 提交，修改和删除监听用 IORING_OP_POLL_REMOVE 提交，
+    /// 这些请求先放进提交队列，在 Poll() 里和等待完成事件一起通过一次 io_uring_enter 交给内核，
+    /// 事件循环每一轮只需要一次系统调用，不再需要每次修改监听都调用一次 epoll_ctl。
+    ///
+    /// 每个 POLL_ADD 只触发一次，触发后在下一次 Poll() 里重新提交。重新提交时内核会立即检查
+    /// fd 的状态，数据没有读完时会再次触发，因此行为和水平触发的 epoll 相同，
+    /// 客户端的读写处理函数不需要任何修改。
+    ///
+    /// 除了可读可写的通知，还支持以完成事件的方式接受连接和接收数据：
+    /// AcceptMultishot() 提交一个多次触发的 accept，每个新连接产生一个完成事件；
+    /// RecvMultishot() 提交一个多次触发的 recv，内核把数据直接收进注册给它的缓冲区环，
+    /// 完成事件里带着收到的数据。这两种请求提交一次之后一直有效，
+    /// 读请求不再需要“可读通知 + read 系统调用”，全部 IO 都在每轮一次的 io_uring_enter 里完成。
+    /// 内核不支持多次触发时（低于 5.19 / 6.0）自动改为每次完成后重新提交的单次请求。
+    ///
+    /// 内核不支持 io_uring（低于 5.11 或者被禁用）时，EnableIoUring() 返回 false，
+    /// 全部操作转交给 EpollPoller
+    class IoUringPoller
+    {
+        /// 提交队列的大小，一轮事件循环的请求超过这个数量时会先提交一部分
+        static constexpr unsigned SQ_ENTRIES = 1024;
+        /// 完成队列的大小，每个 fd 最多同时有一个 POLL_ADD 和一个 POLL_REMOVE 在等待完成
+        static constexpr unsigned CQ_ENTRIES = 4 * 8192;
+        /// POLL_REMOVE 和 ASYNC_CANCEL 请求的 user_data，它们的完成事件直接忽略
+        static constexpr uint64_t REMOVE_USER_DATA = UINT64_MAX;
+        /// 缓冲区环里的缓冲区数量，必须是 2 的幂
+        static constexpr unsigned BUFFER_COUNT = 256;
+        /// 每个缓冲区的大小，和 read 方式每次读取的大小相同
+        static constexpr unsigned BUFFER_SIZE = REDIS_IOBUF_LEN;
+        /// 缓冲区环的编号
+        static constexpr uint16_t BUFFER_GROUP = 0;
+        /// user_data 里版本号的位数，剩下的高 8 位是请求类型，低 32 位是 fd
+        static constexpr uint32_t GENERATION_MASK = 0xFFFFFF;
+
+        /// 提交给内核的请求类型
+        enum class Operation : uint8_t
+        {
+            None,
+            Poll,
+            Accept,
+            Recv
+        };
+
+        /// 每个 fd 的监听状态
+        struct FdState
+        {
+            /// 提交 POLL_ADD 时的版本号，修改监听后递增，用于忽略已经取消的请求的完成事件
+            uint32_t generation = 0;
+            /// 是否有等待完成的 POLL_ADD
+            bool armed = false;
+            /// 是否已经在 dirty_fds_ 里
+            bool dirty = false;
+            /// fd 上的 accept 或者 recv 请求，None 表示没有
+            Operation operation = Operation::None;
+            /// accept/recv 请求是否已经提交、还没有结束
+            bool operationArmed = false;
+            /// accept/recv 请求的版本号，取消后递增
+            uint32_t operationGeneration = 0;
+        };
+
+        /// 从完成队列里取出、等待在 ConsumeAll() 里交给处理函数的完成事件
+        struct Completion
+        {
+            int32_t fd;
+            uint32_t generation;
+            int32_t result;
+            /// 收到数据的缓冲区编号，没有使用缓冲区时是 -1
+            int32_t buffer;
+        };
+
+    public:
+        /// 完成事件的处理函数。accept 时 result 是新连接的 fd；
+        /// recv 时 result 是收到的字节数，data 指向收到的数据，只在调用期间有效，0 表示对端关闭。
+        /// result 小于 0 时是出错的 errno 取负
+        using CompletionHandler = std::function<void(int32_t result, std::string_view data)>;
+
+        DISABLE_COPY(IoUringPoller)
+
+        IoUringPoller()
+            : epoll_(std::make_unique<EpollPoller>())
+        {
+        }
+
+        ~IoUringPoller()
+        {
+            if (ring_fd_ == -1)
+            {
+                return;
+            }
+            if (buffer_ring_ != nullptr)
+            {
+                munmap(buffer_ring_, BUFFER_COUNT * sizeof(io_uring_buf));
+            }
+            munmap(sqes_, sq_entries_ * sizeof(io_uring_sqe));
+            munmap(ring_, ring_size_);
+            close(ring_fd_);
+        }
+
+        /// 切换到 io_uring，必须在注册任何 fd 之前调用。内核不支持时返回 false，继续使用 epoll
+        bool EnableIoUring()
+        {
+            assert(epoll_ != nullptr && "不能重复调用");
+            if (!SetupRing())
+            {
+                return false;
+            }
+            epoll_.reset();
+            return true;
+        }
+
+        /// 是否正在使用 io_uring
+        bool UsingIoUring() const
+        {
+            return epoll_ == nullptr;
+        }
+
+        /// 使用 epoll 时切换到边缘触发，io_uring 的 POLL_ADD 只支持水平触发的语义
+        void SetEdgeTriggered(bool edge_triggered)
+        {
+            if (epoll_ != nullptr)
+            {
+                epoll_->SetEdgeTriggered(edge_triggered);
+            }
+        }
+
+        int32_t AddEvent(int32_t fd, int32_t events)
+        {
+            if (epoll_ != nullptr)
+            {
+                return epoll_->AddEvent(fd, events);
+            }
+            auto merged = fd_events_[fd].events | events;
+            UpdateEvents(fd, merged);
+            return 0;
+        }
+
+        /// 删除读事件时同时取消 fd 上的 accept/recv 请求，它们都代表从 fd 读取
+        int32_t DeleteEvent(int32_t fd, int32_t events)
+        {
+            if (epoll_ != nullptr)
+            {
+                return epoll_->DeleteEvent(fd, events);
+            }
+            if (events & Event::Read)
+            {
+                CancelOperation(fd);
+            }
+            UpdateEvents(fd, fd_events_[fd].events & ~events);
+            return 0;
+        }
+
+        /// 在监听 socket 上提交多次触发的 accept，每接受一个连接调用一次 handler，
+        /// 新连接已经是非阻塞的。只能在使用 io_uring 时调用
+        void AcceptMultishot(int32_t fd, CompletionHandler handler)
+        {
+            assert(UsingIoUring());
+            StartOperation(fd, Operation::Accept, std::move(handler));
+        }
+
+        /// 在 socket 上提交多次触发的 recv，内核把数据收进缓冲区环，每次收到数据调用一次 handler。
+        /// 对端关闭或者出错之后请求结束，不再调用 handler。
+        /// 只能在使用 io_uring 时调用，内核不支持缓冲区环（低于 5.19）时返回 false，调用者改为监听读事件
+        bool RecvMultishot(int32_t fd, CompletionHandler handler)
+        {
+            assert(UsingIoUring());
+            if (buffer_ring_ == nullptr && !SetupBufferRing())
+            {
+                return false;
+            }
+            StartOperation(fd, Operation::Recv, std::move(handler));
+            return true;
+        }
+
+        /// 提交这一轮积累的请求并等待完成事件，返回触发的 fd 数量加上 accept/recv 完成事件的数量
+        int32_t Poll(uint64_t timeout_ms)
+        {
+            if (epoll_ != nullptr)
+            {
+                return epoll_->Poll(timeout_ms);
+            }
+
+            // 上一轮触发过、仍然需要监听的 fd 重新提交，结束了的 accept/recv 请求也重新提交
+            for (auto fd : dirty_fds_)
+            {
+                auto &state = fd_states_[fd];
+                state.dirty = false;
+                if (!state.armed && fd_events_[fd].events != Event::None)
+                {
+                    SubmitPollAdd(fd);
+                }
+                if (!state.operationArmed && state.operation != Operation::None)
+                {
+                    SubmitOperation(fd);
+                }
+            }
+            dirty_fds_.clear();
+            FlushBacklog();
+
+            __kernel_timespec ts{};
+            ts.tv_sec = static_cast<int64_t>(timeout_ms / 1000);
+            ts.tv_nsec = static_cast<int64_t>(timeout_ms % 1000) * 1000000;
+            io_uring_getevents_arg arg{};
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+            // 已经有完成事件，或者还有没能放进提交队列的请求时不等待
+            auto wait = CompletionReady() || !sq_backlog_.empty() ? 0 : 1;
+            // 提交失败时直接返回，先取出已经完成的事件腾出完成队列，没有提交的请求留到下一轮
+            Enter(wait, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+            return ReapCompletions();
+        }
+
+        const struct FiredEvent &GetFdEventByFd(int32_t fd)
+        {
+            if (epoll_ != nullptr)
+            {
+                return epoll_->GetFdEventByFd(fd);
+            }
+            return fd_events_[fd];
+        }
+
+        /// 先把 accept/recv 的完成事件交给各自的处理函数，再逐个返回触发了读写事件的 fd
+        template <std::invocable<FiredEvent> Consumer>
+        void ConsumeAll(Consumer fn)
+        {
+            if (epoll_ != nullptr)
+            {
+                epoll_->ConsumeAll(fn);
+                return;
+            }
+            DispatchCompletions();
+            while (!fired_fds_.Empty())
+            {
+                fn(fired_fds_.Front());
+                fired_fds_.Pop();
+            }
+        }
+
+        std::optional<FiredEvent> Consume()
+        {
+            if (epoll_ != nullptr)
+            {
+                return epoll_->Consume();
+            }
+            DispatchCompletions();
+            if (fired_fds_.Empty())
+            {
+                return std::nullopt;
+            }
+            auto result = std::make_optional(fired_fds_.Front());
+            fired_fds_.Pop();
+            return result;
+        }
+
+    private:
+        /// 创建 io_uring 实例并映射提交队列和完成队列
+        bool SetupRing()
+        {
+            io_uring_params params{};
+            params.flags = IORING_SETUP_CQSIZE;
+            params.cq_entries = CQ_ENTRIES;
+            int fd = static_cast<int>(syscall(__NR_io_uring_setup, SQ_ENTRIES, &params));
+            if (fd < 0)
+            {
+                return false;
+            }
+            // 等待完成事件时带超时需要 5.11 的 IORING_FEAT_EXT_ARG
+            if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG))
+            {
+                close(fd);
+                return false;
+            }
+
+            auto sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            auto cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            ring_size_ = std::max<size_t>(sq_size, cq_size);
+            ring_ = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_SQ_RING);
+            if (ring_ == MAP_FAILED)
+            {
+                close(fd);
+                return false;
+            }
+            sq_entries_ = params.sq_entries;
+            auto *sqes = mmap(nullptr, sq_entries_ * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED)
+            {
+                munmap(ring_, ring_size_);
+                close(fd);
+                return false;
+            }
+            sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+            auto *base = static_cast<char *>(ring_);
+            sq_head_ = reinterpret_cast<unsigned *>(base + params.sq_off.head);
+            sq_tail_ = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+            sq_mask_ = *reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+            cq_head_ = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+            cq_tail_ = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+            cq_mask_ = *reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<io_uring_cqe *>(base + params.cq_off.cqes);
+            // 提交队列的下标数组固定为 i -> i，SQE 按环形顺序使用
+            auto *array = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+            for (unsigned i = 0; i < sq_entries_; i++)
+            {
+                array[i] = i;
+            }
+            ring_fd_ = fd;
+            return true;
+        }
+
+        /// 修改 fd 的监听事件。正在等待的 POLL_ADD 先取消，下一次 Poll() 按新的事件重新提交
+        void UpdateEvents(int32_t fd, int32_t events)
+        {
+            assert(fd >= 0 && static_cast<size_t>(fd) < MAX_NUMBER_OF_FD);
+            auto &state = fd_states_[fd];
+            if (events == fd_events_[fd].events && (state.armed || state.dirty))
+            {
+                return;
+            }
+            fd_events_[fd].fd = fd;
+            fd_events_[fd].events = events;
+            RemovePoll(fd);
+            MarkDirty(fd);
+        }
+
+        /// 取消 fd 上等待的 POLL_ADD
+        void RemovePoll(int32_t fd)
+        {
+            auto &state = fd_states_[fd];
+            if (state.armed)
+            {
+                auto *sqe = GetSqe();
+                sqe->opcode = IORING_OP_POLL_REMOVE;
+                sqe->fd = -1;
+                sqe->addr = UserData(Operation::Poll, fd, state.generation);
+                sqe->user_data = REMOVE_USER_DATA;
+                state.armed = false;
+            }
+            // 旧请求的完成事件可能已经在完成队列里，递增版本号后会被忽略
+            state.generation++;
+        }
+
+        void MarkDirty(int32_t fd)
+        {
+            auto &state = fd_states_[fd];
+            if (!state.dirty)
+            {
+                state.dirty = true;
+                dirty_fds_.emplace_back(fd);
+            }
+        }
+
+        /// 注册缓冲区环，内核 recv 时从里面取空闲的缓冲区存放数据
+        bool SetupBufferRing()
+        {
+            auto ring_bytes = BUFFER_COUNT * sizeof(io_uring_buf);
+            auto *ring = mmap(nullptr, ring_bytes, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+            if (ring == MAP_FAILED)
+            {
+                return false;
+            }
+            io_uring_buf_reg reg{};
+            reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+            reg.ring_entries = BUFFER_COUNT;
+            reg.bgid = BUFFER_GROUP;
+            if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+            {
+                munmap(ring, ring_bytes);
+                return false;
+            }
+            buffer_ring_ = static_cast<io_uring_buf_ring *>(ring);
+            buffers_ = std::make_unique<char[]>(static_cast<size_t>(BUFFER_COUNT) * BUFFER_SIZE);
+            for (unsigned i = 0; i < BUFFER_COUNT; i++)
+            {
+                RecycleBuffer(static_cast<uint16_t>(i));
+            }
+            return true;
+        }
+
+        /// 把缓冲区还给内核。第一个元素的 resv 字段和环的 tail 重叠，只能逐个字段写入。
+        /// 头文件里的 bufs 是 C 的柔性数组，在 C++ 里编译成偏移 8 字节的成员，直接按数组访问环的起始地址
+        void RecycleBuffer(uint16_t id)
+        {
+            auto &buf = reinterpret_cast<io_uring_buf *>(buffer_ring_)[buffer_tail_ & (BUFFER_COUNT - 1)];
+            buf.addr = reinterpret_cast<uint64_t>(buffers_.get() + static_cast<size_t>(id) * BUFFER_SIZE);
+            buf.len = BUFFER_SIZE;
+            buf.bid = id;
+            buffer_tail_++;
+            __atomic_store_n(&buffer_ring_->tail, buffer_tail_, __ATOMIC_RELEASE);
+        }
+
+        void StartOperation(int32_t fd, Operation operation, CompletionHandler handler)
+        {
+            assert(fd >= 0 && static_cast<size_t>(fd) < MAX_NUMBER_OF_FD);
+            CancelOperation(fd);
+            if (handlers_.empty())
+            {
+                handlers_.resize(MAX_NUMBER_OF_FD);
+            }
+            handlers_[fd] = std::move(handler);
+            fd_states_[fd].operation = operation;
+            MarkDirty(fd);
+        }
+
+        /// 取消 fd 上的 accept/recv 请求。处理函数可能正在执行，保留到 fd 下一次提交请求时再替换
+        void CancelOperation(int32_t fd)
+        {
+            auto &state = fd_states_[fd];
+            if (state.operation != Operation::None && state.operationArmed)
+            {
+                auto *sqe = GetSqe();
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = -1;
+                sqe->addr = UserData(state.operation, fd, state.operationGeneration);
+                sqe->user_data = REMOVE_USER_DATA;
+            }
+            state.operation = Operation::None;
+            state.operationArmed = false;
+            // 已经在完成队列里、还没有交给处理函数的完成事件会被忽略
+            state.operationGeneration++;
+        }
+
+        void SubmitOperation(int32_t fd)
+        {
+            auto &state = fd_states_[fd];
+            auto *sqe = GetSqe();
+            sqe->fd = fd;
+            if (state.operation == Operation::Accept)
+            {
+                sqe->opcode = IORING_OP_ACCEPT;
+                sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+                sqe->ioprio = multishot_accept_ ? IORING_ACCEPT_MULTISHOT : 0;
+            }
+            else
+            {
+                // len 为 0 时每次最多收满一个缓冲区
+                sqe->opcode = IORING_OP_RECV;
+                sqe->flags = IOSQE_BUFFER_SELECT;
+                sqe->buf_group = BUFFER_GROUP;
+                sqe->ioprio = multishot_recv_ ? IORING_RECV_MULTISHOT : 0;
+            }
+            sqe->user_data = UserData(state.operation, fd, state.operationGeneration);
+            state.operationArmed = true;
+        }
+
+        /// 处理 accept/recv 请求的完成事件，需要交给处理函数的放进 completions_
+        void ReapOperation(const io_uring_cqe &cqe, Operation operation, int32_t fd, uint32_t generation)
+        {
+            auto buffer = (cqe.flags & IORING_CQE_F_BUFFER) ? static_cast<int32_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT)
+                                                            : -1;
+            auto &state = fd_states_[fd];
+            if (generation != (state.operationGeneration & GENERATION_MASK) || state.operation != operation)
+            {
+                // 已经取消的请求，收到的数据直接丢弃
+                if (buffer != -1)
+                {
+                    RecycleBuffer(static_cast<uint16_t>(buffer));
+                }
+                return;
+            }
+            if (!(cqe.flags & IORING_CQE_F_MORE))
+            {
+                // 请求已经结束，仍然需要时在下一次 Poll() 里重新提交
+                state.operationArmed = false;
+                MarkDirty(fd);
+            }
+            if (cqe.res == -EINVAL && (operation == Operation::Accept ? multishot_accept_ : multishot_recv_))
+            {
+                // 内核不支持多次触发，改为单次请求
+                (operation == Operation::Accept ? multishot_accept_ : multishot_recv_) = false;
+                return;
+            }
+            if (cqe.res == -ENOBUFS)
+            {
+                // 缓冲区都在等待处理，处理完还给内核之后重新提交
+                return;
+            }
+            if (operation == Operation::Recv && cqe.res <= 0)
+            {
+                // 对端关闭或者出错，不再接收。版本号不变，之前收到的数据和这个事件都交给处理函数
+                state.operation = Operation::None;
+            }
+            completions_.push_back(Completion{fd, generation, cqe.res, buffer});
+        }
+
+        /// 把完成事件交给处理函数，处理完之后把缓冲区还给内核
+        void DispatchCompletions()
+        {
+            // 处理函数里可能取消后面的完成事件所属的请求，按下标遍历并检查版本号
+            for (size_t i = 0; i < completions_.size(); i++)
+            {
+                auto completion = completions_[i];
+                auto generation = fd_states_[completion.fd].operationGeneration & GENERATION_MASK;
+                if (completion.generation == generation)
+                {
+                    std::string_view data;
+                    if (completion.buffer != -1)
+                    {
+                        data = std::string_view(buffers_.get() + static_cast<size_t>(completion.buffer) * BUFFER_SIZE,
+                                                static_cast<size_t>(completion.result));
+                    }
+                    handlers_[completion.fd](completion.result, data);
+                }
+                if (completion.buffer != -1)
+                {
+                    RecycleBuffer(static_cast<uint16_t>(completion.buffer));
+                }
+            }
+            completions_.clear();
+        }
+
+        void SubmitPollAdd(int32_t fd)
+        {
+            auto &state = fd_states_[fd];
+            auto events = fd_events_[fd].events;
+            auto *sqe = GetSqe();
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = fd;
+            uint32_t poll_events = 0;
+            if (events & Event::Read)
+                poll_events |= POLLIN;
+            if (events & Event::Write)
+                poll_events |= POLLOUT;
+            sqe->poll32_events = poll_events;
+            sqe->user_data = UserData(Operation::Poll, fd, state.generation);
+            state.armed = true;
+        }
+
+        static uint64_t UserData(Operation operation, int32_t fd, uint32_t generation)
+        {
+            return (static_cast<uint64_t>(operation) << 56) |
+                   (static_cast<uint64_t>(generation & GENERATION_MASK) << 32) | static_cast<uint32_t>(fd);
+        }
+
+        /// 提交队列里还能放下的 SQE 数量
+        unsigned SqSpace() const
+        {
+            return sq_entries_ - (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE));
+        }
+
+        /// 取一个空闲的 SQE，提交队列满时先把已有的请求交给内核。
+        /// 内核暂时不接收新的请求时（完成队列溢出、内存不足），请求放进 sq_backlog_，
+        /// 之后的请求也都排在它后面，保证同一个 fd 的 POLL_REMOVE 和 POLL_ADD 按顺序提交
+        io_uring_sqe *GetSqe()
+        {
+            if (sq_backlog_.empty() && SqSpace() == 0)
+            {
+                Enter(0, 0, nullptr, 0);
+            }
+            if (!sq_backlog_.empty() || SqSpace() == 0)
+            {
+                return &sq_backlog_.emplace_back();
+            }
+            auto *sqe = &sqes_[sq_local_tail_ & sq_mask_];
+            *sqe = io_uring_sqe{};
+            sq_local_tail_++;
+            __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+            return sqe;
+        }
+
+        /// 把 sq_backlog_ 里的请求按顺序放进提交队列，放不下的留到下一轮
+        void FlushBacklog()
+        {
+            size_t moved = 0;
+            while (moved < sq_backlog_.size())
+            {
+                if (SqSpace() == 0)
+                {
+                    Enter(0, 0, nullptr, 0);
+                    if (SqSpace() == 0)
+                    {
+                        break;
+                    }
+                }
+                sqes_[sq_local_tail_ & sq_mask_] = sq_backlog_[moved++];
+                sq_local_tail_++;
+                __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+            }
+            sq_backlog_.erase(sq_backlog_.begin(), sq_backlog_.begin() + static_cast<std::ptrdiff_t>(moved));
+        }
+
+        /// 提交积累的请求，wait 不为 0 时等待至少 wait 个完成事件。
+        /// 没有被内核取走的请求留在提交队列里，下一次调用时重新提交
+        void Enter(unsigned wait, unsigned flags, void *arg, size_t arg_size)
+        {
+            auto to_submit = sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+            auto result = syscall(__NR_io_uring_enter, ring_fd_, to_submit, wait, flags, arg, arg_size);
+            if (result >= 0)
+            {
+                return;
+            }
+            switch (errno)
+            {
+            case ETIME:
+            case EINTR:
+                // 超时或者被信号打断，由下一轮事件循环处理
+                break;
+            case EAGAIN:
+            case EBUSY:
+                // 完成队列溢出或者内核暂时没有内存。调用者接着取出完成事件腾出空间，
+                // 请求留在提交队列里，下一次提交
+                break;
+            case EBADR:
+                // 内核内存不足时丢弃了完成事件，重新提交全部请求
+                Resync();
+                break;
+            default:
+                fprintf(stderr, "io_uring_enter: %s\n", strerror(errno));
+                break;
+            }
+        }
+
+        /// 完成事件被丢弃之后恢复：读写事件的 POLL_ADD 换一个版本号重新提交，
+        /// 旧请求之后的完成事件会被忽略；accept 取消后重新提交；
+        /// recv 丢失的完成事件里可能有数据，无法恢复，通知处理函数出错
+        void Resync()
+        {
+            for (size_t i = 0; i < MAX_NUMBER_OF_FD; i++)
+            {
+                auto fd = static_cast<int32_t>(i);
+                auto &state = fd_states_[fd];
+                if (state.armed)
+                {
+                    RemovePoll(fd);
+                    MarkDirty(fd);
+                }
+                if (state.operation == Operation::Accept)
+                {
+                    auto handler = std::move(handlers_[fd]);
+                    StartOperation(fd, Operation::Accept, std::move(handler));
+                }
+                else if (state.operation == Operation::Recv)
+                {
+                    CancelOperation(fd);
+                    completions_.push_back(Completion{fd, state.operationGeneration & GENERATION_MASK, -EBADR, -1});
+                }
+            }
+        }
+
+        bool CompletionReady() const
+        {
+            return *cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        }
+
+        /// 取出全部完成事件，把触发的 fd 放进 fired_fds_
+        int32_t ReapCompletions()
+        {
+            int32_t fired = 0;
+            auto head = *cq_head_;
+            auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++)
+            {
+                auto &cqe = cqes_[head & cq_mask_];
+                if (cqe.user_data == REMOVE_USER_DATA)
+                {
+                    continue;
+                }
+                auto fd = static_cast<int32_t>(cqe.user_data & 0xFFFFFFFF);
+                auto generation = static_cast<uint32_t>(cqe.user_data >> 32) & GENERATION_MASK;
+                auto operation = static_cast<Operation>(cqe.user_data >> 56);
+                if (operation != Operation::Poll)
+                {
+                    ReapOperation(cqe, operation, fd, generation);
+                    continue;
+                }
+                auto &state = fd_states_[fd];
+                // 已经取消或者修改过的请求
+                if (generation != (state.generation & GENERATION_MASK) || !state.armed)
+                {
+                    continue;
+                }
+                state.armed = false;
+                MarkDirty(fd);
+                if (cqe.res < 0)
+                {
+                    continue;
+                }
+
+                int32_t mask = Event::None;
+                if (cqe.res & POLLIN)
+                    mask |= Event::Read;
+                if (cqe.res & POLLOUT)
+                    mask |= Event::Write;
+                // 和 EpollPoller 一样，出错或者对端关闭时交给读写处理函数
+                if (cqe.res & (POLLERR | POLLHUP))
+                    mask |= Event::Read | Event::Write;
+                if (mask != Event::None)
+                {
+                    fired_fds_.EmplaceBack(fd, mask);
+                    fired++;
+                }
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+            return fired + static_cast<int32_t>(completions_.size());
+        }
+
+    private:
+        /// 内核不支持 io_uring 时使用的 poller，切换到 io_uring 后释放
+        std::unique_ptr<EpollPoller> epoll_;
+
+        int ring_fd_{-1};
+        void *ring_{nullptr};
+        size_t ring_size_{0};
+        io_uring_sqe *sqes_{nullptr};
+        unsigned sq_entries_{0};
+        unsigned *sq_head_{nullptr};
+        unsigned *sq_tail_{nullptr};
+        unsigned sq_mask_{0};
+        /// 已经填写的 SQE 的尾部位置
+        unsigned sq_local_tail_{0};
+        /// 提交队列放不下、等待下一次 Poll() 提交的请求
+        std::vector<io_uring_sqe> sq_backlog_;
+        unsigned *cq_head_{nullptr};
+        unsigned *cq_tail_{nullptr};
+        unsigned cq_mask_{0};
+        io_uring_cqe *cqes_{nullptr};
+
+        /// 每个 fd 监听的事件
+        struct FiredEvent fd_events_[MAX_NUMBER_OF_FD]{};
+        FdState fd_states_[MAX_NUMBER_OF_FD]{};
+        /// 需要在下一次 Poll() 里重新提交 POLL_ADD 的 fd
+        std::vector<int32_t> dirty_fds_;
+        /// 完成队列里取出的触发了事件的 fd
+        base::RingQueue<FiredEvent, MAX_NUMBER_OF_FD> fired_fds_;
+
+        /// 以 fd 为下标的 accept/recv 处理函数，第一次提交请求时分配
+        std::vector<CompletionHandler> handlers_;
+        /// 等待交给处理函数的完成事件
+        std::vector<Completion> completions_;
+        /// 内核是否支持多次触发的 accept 和 recv，第一次提交失败后改为单次请求
+        bool multishot_accept_{true};
+        bool multishot_recv_{true};
+        /// 缓冲区环，recv 请求从这里取缓冲区
+        io_uring_buf_ring *buffer_ring_{nullptr};
+        /// 缓冲区环的 tail，归还的缓冲区放在这里
+        uint16_t buffer_tail_{0};
+        /// 全部缓冲区的内存
+        std::unique_ptr<char[]> buffers_;
+    };
+} // namespace net
@@ -0,0 +1,93 @@
+#include "toy-redis/client.hpp"
+#include "toy-redis/command_table.hpp"
+#include "gtest/gtest.h"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+using tr::COMMAND_TABLE;
+using tr::CommandInfo;
+using tr::CommandTable;
+
+namespace
+{
+    constexpr size_t GENERATED_COUNT = 300;
+
+    /// 编译期生成 "cmd000" ~ "cmd299"
+    constexpr auto GENERATED_NAMES = [] {
+        std::array<std::array<char, 6>, GENERATED_COUNT> names{};
+        for (size_t i = 0; i < GENERATED_COUNT; i++)
+        {
+            names[i] = {'c', 'm', 'd', static_cast<char>('0' + i / 100),
+                        static_cast<char>('0' + i / 10 % 10), static_cast<char>('0' + i % 10)};
+        }
+        return names;
+    }();
+
+    constexpr auto GENERATED_TABLE = CommandTable{[] {
+        std::array<CommandInfo, GENERATED_COUNT> commands{};
+        for (size_t i = 0; i < GENERATED_COUNT; i++)
+        {
+            commands[i].name = std::string_view(GENERATED_NAMES[i].data(), GENERATED_NAMES[i].size());
+            commands[i].arity = static_cast<int32_t>(i);
+        }
+        return commands;
+    }()};
+
+    // 查找在编译期也可以使用
+    static_assert(COMMAND_TABLE.Lookup("GET") != nullptr);
+    static_assert(COMMAND_TABLE.Lookup("nosuchcommand") == nullptr);
+    static_assert(GENERATED_TABLE.IndexOf("CMD123") == 123);
+} // namespace
+
+TEST(command_table, LookupIsCaseInsensitive)
+{
+    for (auto name : {"get", "GET", "Get", "gEt"})
+    {
+        auto command = COMMAND_TABLE.Lookup(name);
+        ASSERT_NE(command, nullptr) << name;
+        EXPECT_EQ(command->name, "get");
+        EXPECT_TRUE(command->HasFlag(tr::command_flag::READONLY));
+    }
+    EXPECT_EQ(COMMAND_TABLE.Lookup(""), nullptr);
+    EXPECT_EQ(COMMAND_TABLE.Lookup("ge"), nullptr);
+    EXPECT_EQ(COMMAND_TABLE.Lookup("gett"), nullptr);
+    EXPECT_EQ(COMMAND_TABLE.IndexOf("unknown"), COMMAND_TABLE.Size());
+}
+
+TEST(command_table, EveryCommandIsFound)
+{
+    for (auto &command : COMMAND_TABLE)
+    {
+        std::string upper(command.name);
+        for (auto &c : upper)
+        {
+            c = static_cast<char>(std::toupper(c));
+        }
+        EXPECT_EQ(COMMAND_TABLE.Lookup(upper), &command);
+        EXPECT_EQ(COMMAND_TABLE.IndexOf(command.name), COMMAND_TABLE.IndexOf(command));
+    }
+
+    for (size_t i = 0; i < GENERATED_COUNT; i++)
+    {
+        std::string_view name(GENERATED_NAMES[i].data(), GENERATED_NAMES[i].size());
+        ASSERT_EQ(GENERATED_TABLE.IndexOf(name), i);
+    }
+    EXPECT_EQ(GENERATED_TABLE.Lookup("cmd300"), nullptr);
+}
+
+TEST(command_table, Arity)
+{
+    auto get = COMMAND_TABLE.Lookup("get");
+    EXPECT_FALSE(get->CheckArity(1));
+    EXPECT_TRUE(get->CheckArity(2));
+    EXPECT_FALSE(get->CheckArity(3));
+
+    // 负数表示参数数量至少是 -arity
+    auto set = COMMAND_TABLE.Lookup("set");
+    EXPECT_FALSE(set->CheckArity(2));
+    EXPECT_TRUE(set->CheckArity(3));
+    EXPECT_TRUE(set->CheckArity(5));
+}
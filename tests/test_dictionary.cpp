@@ -1,4 +1,6 @@
 #include "base/dictionary.hpp"
+#include "base/hash.hpp"
+#include "base/simple_dynamic_string.hpp"
 #include "gtest/gtest.h"
 
 TEST(dict, Create)
@@ -84,4 +86,333 @@ TEST(dict, Delete)
     ASSERT_EQ(dict.ElementSize(), 1);
     find_hello = dict.Find("hello");
     ASSERT_EQ(find_hello.has_value(), false);
-}
\ No newline at end of file
+}
+
+TEST(dict, IncrementalRehash)
+{
+    base::Dictionary<std::string, int64_t> dict;
+    for (int64_t i = 0; i < 1024; i++)
+    {
+        dict.Add(std::to_string(i), i);
+    }
+    dict.RehashMilliseconds(1000);
+    ASSERT_EQ(dict.IsRehashing(), false);
+    ASSERT_EQ(dict.BucketSize(), 1024);
+
+    // 触发扩容后只分配新表，元素在后续操作中逐步搬迁
+    dict.Add("1024", 1024);
+    ASSERT_EQ(dict.IsRehashing(), true);
+    ASSERT_EQ(dict.BucketSize(), 1024 + 2048);
+    ASSERT_EQ(dict.ElementSize(), 1025);
+
+    // 正在 rehash 时不允许再次扩容
+    ASSERT_EQ(dict.Expand(8192), false);
+
+    // rehash 期间新旧两张表的元素都能查找和删除
+    for (int64_t i = 0; i <= 1024; i++)
+    {
+        auto result = dict.Find(std::to_string(i));
+        ASSERT_EQ(result.has_value(), true);
+        ASSERT_EQ(result->get().second, i);
+    }
+    ASSERT_EQ(dict.Delete("0"), true);
+    ASSERT_EQ(dict.Delete("1024"), true);
+    ASSERT_EQ(dict.Add("1", 1), false);
+    ASSERT_EQ(dict.ElementSize(), 1023);
+
+    dict.RehashMilliseconds(1000);
+    ASSERT_EQ(dict.IsRehashing(), false);
+    ASSERT_EQ(dict.BucketSize(), 2048);
+    ASSERT_EQ(dict.ElementSize(), 1023);
+    for (int64_t i = 1; i < 1024; i++)
+    {
+        ASSERT_EQ(dict.Find(std::to_string(i)).has_value(), true);
+    }
+}
+
+TEST(dict, RehashStepOnAccess)
+{
+    base::Dictionary<int64_t, int64_t> dict;
+    for (int64_t i = 0; i < 64; i++)
+    {
+        dict.Add(i, i);
+    }
+    // 不主动调用 Rehash，查找操作会逐步完成搬迁
+    while (dict.IsRehashing())
+    {
+        dict.Find(0);
+    }
+    ASSERT_EQ(dict.BucketSize(), 64);
+    for (int64_t i = 0; i < 64; i++)
+    {
+        ASSERT_EQ(dict.Find(i)->get().second, i);
+    }
+}
+
+TEST(dict, ShrinkAndRelease)
+{
+    base::Dictionary<std::string, int64_t> dict;
+    for (int64_t i = 0; i < 1000; i++)
+    {
+        dict.Add(std::to_string(i), i);
+    }
+    dict.RehashMilliseconds(1000);
+    ASSERT_EQ(dict.BucketSize(), 1024);
+    ASSERT_EQ(dict.NeedsShrink(), false);
+    ASSERT_EQ(dict.ShrinkIfNeeded(), false);
+
+    for (int64_t i = 10; i < 1000; i++)
+    {
+        dict.Delete(std::to_string(i));
+    }
+    dict.RehashMilliseconds(1000);
+    ASSERT_EQ(dict.ElementSize(), 10);
+    ASSERT_EQ(dict.NeedsShrink(), true);
+
+    // 缩容同样是渐进式的，先分配小表，元素逐步搬迁
+    ASSERT_EQ(dict.ShrinkIfNeeded(), true);
+    ASSERT_EQ(dict.IsRehashing(), true);
+    ASSERT_EQ(dict.BucketSize(), 1024 + 16);
+    for (int64_t i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(dict.Find(std::to_string(i))->get().second, i);
+    }
+    dict.RehashMilliseconds(1000);
+    ASSERT_EQ(dict.IsRehashing(), false);
+    ASSERT_EQ(dict.BucketSize(), 16);
+    ASSERT_EQ(dict.NeedsShrink(), false);
+    ASSERT_EQ(dict.Fit(), false);
+
+    dict.Release();
+    ASSERT_EQ(dict.Empty(), true);
+    ASSERT_EQ(dict.BucketSize(), 0);
+    ASSERT_EQ(dict.Find("0").has_value(), false);
+    dict.Add("0", 0);
+    ASSERT_EQ(dict.Find("0")->get().second, 0);
+}
+
+TEST(dict, Iterator)
+{
+    base::Dictionary<int64_t, int64_t> dict;
+    int64_t count = 0;
+    for ([[maybe_unused]] auto &entry : dict)
+    {
+        count++;
+    }
+    ASSERT_EQ(count, 0);
+
+    int64_t expect_sum = 0;
+    for (int64_t i = 0; i < 100; i++)
+    {
+        dict.Add(i, i);
+        expect_sum += i;
+    }
+    // 最后一次扩容还在 rehash，遍历需要覆盖新旧两张表
+    ASSERT_EQ(dict.IsRehashing(), true);
+
+    int64_t sum = 0;
+    for (auto &[key, value] : dict)
+    {
+        ASSERT_EQ(key, value);
+        sum += value;
+        count++;
+    }
+    ASSERT_EQ(count, 100);
+    ASSERT_EQ(sum, expect_sum);
+}
+
+TEST(dict, SafeIteratorDelete)
+{
+    base::Dictionary<int64_t, int64_t> dict;
+    for (int64_t i = 0; i < 100; i++)
+    {
+        dict.Add(i, i);
+    }
+    ASSERT_EQ(dict.IsRehashing(), true);
+
+    // 安全迭代器遍历期间允许查找和删除当前元素，并且不会推进 rehash
+    int64_t count = 0;
+    for (auto &entry : dict.SafeRange())
+    {
+        ASSERT_EQ(dict.Find(entry.first).has_value(), true);
+        if (entry.first % 2 == 0)
+        {
+            ASSERT_EQ(dict.Delete(entry.first), true);
+        }
+        count++;
+    }
+    ASSERT_EQ(count, 100);
+    ASSERT_EQ(dict.ElementSize(), 50);
+    ASSERT_EQ(dict.IsRehashing(), true);
+
+    // 遍历结束后恢复渐进式 rehash
+    dict.RehashMilliseconds(1000);
+    ASSERT_EQ(dict.IsRehashing(), false);
+    for (int64_t i = 0; i < 100; i++)
+    {
+        ASSERT_EQ(dict.Find(i).has_value(), i % 2 == 1);
+    }
+}
+
+TEST(dict, SafeIteratorAddToEmpty)
+{
+    // 空字典还没有分配表，安全迭代器存活期间第一次添加直接分配 ht_[0]
+    base::Dictionary<int64_t, int64_t> dict;
+    auto range = dict.SafeRange();
+    ASSERT_EQ(dict.Add(1, 10), true);
+    ASSERT_EQ(dict.IsRehashing(), false);
+    ASSERT_EQ(dict.Find(1).has_value(), true);
+    ASSERT_EQ(dict.Find(1)->get().second, 10);
+}
+
+TEST(dict, ScanAcrossResize)
+{
+    base::Dictionary<int64_t, int64_t> dict;
+    for (int64_t i = 0; i < 500; i++)
+    {
+        dict.Add(i, i);
+    }
+    dict.RehashMilliseconds(1000);
+
+    std::vector<int64_t> visited(1000, 0);
+    auto callback = [&](auto &entry) {
+        visited[entry.first]++;
+    };
+
+    // 遍历到一半时触发扩容，扩容期间继续遍历
+    size_t cursor = dict.Scan(0, callback);
+    for (int i = 0; i < 100 && cursor != 0; i++)
+    {
+        cursor = dict.Scan(cursor, callback);
+    }
+    for (int64_t i = 500; i < 1000; i++)
+    {
+        dict.Add(i, i);
+    }
+    ASSERT_EQ(dict.IsRehashing(), true);
+    while (cursor != 0)
+    {
+        cursor = dict.Scan(cursor, callback);
+        dict.Rehash(1);
+    }
+
+    // 遍历开始时就存在的元素至少遍历到一次
+    for (int64_t i = 0; i < 500; i++)
+    {
+        ASSERT_GE(visited[i], 1) << "key " << i;
+    }
+    // 扩容后不会重复遍历
+    for (int64_t i = 0; i < 500; i++)
+    {
+        ASSERT_EQ(visited[i], 1) << "key " << i;
+    }
+
+    // 遍历到一半时缩容
+    std::fill(visited.begin(), visited.end(), 0);
+    dict.RehashMilliseconds(1000);
+    cursor = 0;
+    for (int i = 0; i < 300; i++)
+    {
+        cursor = dict.Scan(cursor, callback);
+    }
+    for (int64_t i = 100; i < 1000; i++)
+    {
+        dict.Delete(i);
+    }
+    ASSERT_EQ(dict.ShrinkIfNeeded(), true);
+    while (cursor != 0)
+    {
+        cursor = dict.Scan(cursor, callback);
+        dict.Rehash(1);
+    }
+    for (int64_t i = 0; i < 100; i++)
+    {
+        ASSERT_GE(visited[i], 1) << "key " << i;
+    }
+}
+
+TEST(dict, ScanDeleteInCallback)
+{
+    base::Dictionary<int64_t, int64_t> dict;
+    for (int64_t i = 0; i < 100; i++)
+    {
+        dict.Add(i, i);
+    }
+    size_t cursor = 0;
+    do
+    {
+        cursor = dict.Scan(cursor, [&](auto &entry) {
+            dict.Delete(entry.first);
+        });
+    } while (cursor != 0);
+    ASSERT_EQ(dict.Empty(), true);
+}
+
+TEST(dict, HeterogeneousLookup)
+{
+    using namespace base::literals;
+    base::Dictionary<std::string, int64_t, base::StringHash, base::StringEqual> dict;
+
+    // std::string_view 作为 key 新增时原地构造 std::string
+    ASSERT_EQ(dict.Add(std::string_view("hello"), 1024), true);
+    ASSERT_EQ(dict.Add(std::string("world"), 2048), true);
+    ASSERT_EQ(dict.Add(std::string_view("hello"), 0), false);
+
+    // 不构造 std::string，直接用 std::string_view、SDS、C 风格字符串查找
+    std::string_view buffer = "get hello world";
+    ASSERT_EQ(dict.Find(buffer.substr(4, 5))->get().second, 1024);
+    ASSERT_EQ(dict.Find("world"_sds)->get().second, 2048);
+    ASSERT_EQ(dict.Find("world")->get().second, 2048);
+    ASSERT_EQ(dict.Find(buffer.substr(0, 3)).has_value(), false);
+
+    ASSERT_EQ(dict.Replace(buffer.substr(10), 4096), false);
+    ASSERT_EQ(dict.Find("world")->get().second, 4096);
+
+    ASSERT_EQ(dict.Delete("hello"_sds), true);
+    ASSERT_EQ(dict.Delete(buffer.substr(4, 5)), false);
+    ASSERT_EQ(dict.ElementSize(), 1);
+}
+
+/// 统计调用次数的哈希函数
+struct CountingHash
+{
+    inline static size_t calls = 0;
+
+    size_t operator()(int64_t key) const
+    {
+        calls++;
+        return std::hash<int64_t>()(key);
+    }
+};
+
+TEST(dict, CachedHash)
+{
+    base::Dictionary<int64_t, int64_t, CountingHash> dict;
+    CountingHash::calls = 0;
+    for (int64_t i = 0; i < 1024; i++)
+    {
+        ASSERT_EQ(dict.Add(i, i), true);
+    }
+    // 新增只计算一次哈希值，扩容和 rehash 使用节点缓存的哈希值
+    ASSERT_EQ(CountingHash::calls, 1024);
+    while (dict.Rehash(100))
+    {
+    }
+    ASSERT_EQ(dict.Fit(), false);
+    ASSERT_EQ(CountingHash::calls, 1024);
+
+    for (int64_t i = 0; i < 1024; i++)
+    {
+        ASSERT_EQ(dict.Find(i)->get().second, i);
+    }
+    ASSERT_EQ(CountingHash::calls, 2048);
+
+    // 调用者提供哈希值时不再计算
+    for (int64_t i = 0; i < 1024; i++)
+    {
+        auto hash = std::hash<int64_t>()(i);
+        ASSERT_EQ(dict.Find(i, hash)->get().second, i);
+    }
+    ASSERT_EQ(dict.Find(int64_t{1024}, std::hash<int64_t>()(1024)).has_value(), false);
+    ASSERT_EQ(CountingHash::calls, 2048);
+}
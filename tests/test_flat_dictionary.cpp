@@ -0,0 +1,233 @@
+#include "base/dictionary.hpp"
+#include "base/flat_dictionary.hpp"
+#include "base/hash.hpp"
+#include "gtest/gtest.h"
+
+#include <string>
+
+TEST(flat_dict, AddAndFind)
+{
+    base::FlatDictionary<std::string, int64_t> dict;
+    ASSERT_EQ(dict.Empty(), true);
+
+    ASSERT_EQ(dict.Add("hello", 1024), true);
+    ASSERT_EQ(dict.Add("world", 2048), true);
+    ASSERT_EQ(dict.Add("hello", 4096), false);
+    ASSERT_EQ(dict.ElementSize(), 2);
+    ASSERT_EQ(dict.BucketSize(), 16);
+
+    auto find_hello = dict.Find("hello");
+    ASSERT_EQ(find_hello.has_value(), true);
+    ASSERT_EQ(find_hello->get().second, 1024);
+
+    find_hello->get().second = 4096;
+    ASSERT_EQ(dict.Find("hello")->get().second, 4096);
+    ASSERT_EQ(dict.Find("redis").has_value(), false);
+}
+
+TEST(flat_dict, Replace)
+{
+    base::FlatDictionary<std::string, int64_t> dict;
+    ASSERT_EQ(dict.Replace("hello", 1024), true);
+    ASSERT_EQ(dict.Replace("hello", 2048), false);
+    ASSERT_EQ(dict.ElementSize(), 1);
+    ASSERT_EQ(dict.Find("hello")->get().second, 2048);
+}
+
+TEST(flat_dict, Expand)
+{
+    base::FlatDictionary<int64_t, int64_t> dict;
+    dict.Expand(100);
+    ASSERT_EQ(dict.BucketSize(), 128);
+
+    for (int64_t i = 0; i < 10000; i++)
+    {
+        ASSERT_EQ(dict.Add(i, i * 2), true);
+    }
+    ASSERT_EQ(dict.ElementSize(), 10000);
+    // 负载因子不超过 7/8
+    ASSERT_GE(dict.BucketSize() * 7 / 8, dict.ElementSize());
+    for (int64_t i = 0; i < 10000; i++)
+    {
+        auto result = dict.Find(i);
+        ASSERT_EQ(result.has_value(), true);
+        ASSERT_EQ(result->get().second, i * 2);
+    }
+}
+
+TEST(flat_dict, DeleteAndReuseTombstone)
+{
+    base::FlatDictionary<std::string, std::string> dict;
+    for (int i = 0; i < 1000; i++)
+    {
+        dict.Add(std::to_string(i), std::to_string(i));
+    }
+    auto bucket_size = dict.BucketSize();
+
+    // 反复删除、插入，墓碑会被复用或者原容量重建清理，容量不会无限增长
+    for (int round = 0; round < 20; round++)
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            ASSERT_EQ(dict.Delete(std::to_string(i)), true);
+        }
+        ASSERT_EQ(dict.Empty(), true);
+        ASSERT_EQ(dict.Delete("0"), false);
+        for (int i = 0; i < 1000; i++)
+        {
+            ASSERT_EQ(dict.Add(std::to_string(i), std::to_string(i + round)), true);
+        }
+    }
+    ASSERT_EQ(dict.BucketSize(), bucket_size);
+    for (int i = 0; i < 1000; i++)
+    {
+        ASSERT_EQ(dict.Find(std::to_string(i))->get().second, std::to_string(i + 19));
+    }
+}
+
+TEST(flat_dict, CopyAndMove)
+{
+    base::FlatDictionary<std::string, std::string> dict;
+    dict.Add("hello", "world");
+
+    auto copy = dict;
+    copy.Replace("hello", "redis");
+    ASSERT_EQ(dict.Find("hello")->get().second, "world");
+    ASSERT_EQ(copy.Find("hello")->get().second, "redis");
+
+    auto moved = std::move(copy);
+    ASSERT_EQ(moved.Find("hello")->get().second, "redis");
+    ASSERT_EQ(copy.Empty(), true);
+    ASSERT_EQ(copy.Find("hello").has_value(), false);
+}
+
+TEST(flat_dict, SelectByTemplateParameter)
+{
+    // 通过 Dictionary 的最后一个模板参数选择开放寻址的实现
+    base::Dictionary<std::string, int64_t, std::hash<std::string>, std::equal_to<>, base::OpenAddressing> dict;
+    dict.Add("hello", 1024);
+    ASSERT_EQ(dict.Find("hello")->get().second, 1024);
+    ASSERT_EQ(dict.IsRehashing(), false);
+    ASSERT_EQ(dict.Delete("hello"), true);
+    ASSERT_EQ(dict.Empty(), true);
+}
+
+TEST(flat_dict, ShrinkAndRelease)
+{
+    base::FlatDictionary<int64_t, int64_t> dict;
+    for (int64_t i = 0; i < 1000; i++)
+    {
+        dict.Add(i, i);
+    }
+    ASSERT_EQ(dict.ShrinkIfNeeded(), false);
+    for (int64_t i = 10; i < 1000; i++)
+    {
+        dict.Delete(i);
+    }
+    ASSERT_EQ(dict.NeedsShrink(), true);
+    ASSERT_EQ(dict.ShrinkIfNeeded(), true);
+    ASSERT_EQ(dict.BucketSize(), 16);
+    for (int64_t i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(dict.Find(i)->get().second, i);
+    }
+
+    dict.Release();
+    ASSERT_EQ(dict.Empty(), true);
+    ASSERT_EQ(dict.BucketSize(), 0);
+    ASSERT_EQ(dict.Fit(), false);
+}
+
+TEST(flat_dict, IteratorAndScan)
+{
+    base::FlatDictionary<int64_t, int64_t> dict;
+    ASSERT_EQ(dict.begin() == dict.end(), true);
+    ASSERT_EQ(dict.Scan(0, [](auto &) {}), 0);
+
+    for (int64_t i = 0; i < 100; i++)
+    {
+        dict.Add(i, i);
+    }
+
+    int64_t count = 0;
+    for (auto &[key, value] : dict)
+    {
+        ASSERT_EQ(key, value);
+        count++;
+    }
+    ASSERT_EQ(count, 100);
+
+    // 遍历期间删除当前元素
+    for (auto &entry : dict.SafeRange())
+    {
+        if (entry.first % 2 == 0)
+        {
+            dict.Delete(entry.first);
+        }
+    }
+    ASSERT_EQ(dict.ElementSize(), 50);
+
+    std::vector<int64_t> visited(100, 0);
+    size_t cursor = 0;
+    do
+    {
+        cursor = dict.Scan(cursor, [&](auto &entry) {
+            visited[entry.first]++;
+        });
+    } while (cursor != 0);
+    for (int64_t i = 0; i < 100; i++)
+    {
+        ASSERT_EQ(visited[i], i % 2);
+    }
+}
+
+TEST(flat_dict, HeterogeneousLookup)
+{
+    base::FlatDictionary<std::string, int64_t, base::StringHash, base::StringEqual> dict;
+    ASSERT_EQ(dict.Add(std::string_view("hello"), 1024), true);
+
+    std::string_view buffer = "get hello";
+    ASSERT_EQ(dict.Find(buffer.substr(4))->get().second, 1024);
+    ASSERT_EQ(dict.Replace(buffer.substr(4), 2048), false);
+    ASSERT_EQ(dict.Find("hello")->get().second, 2048);
+    ASSERT_EQ(dict.Delete(buffer.substr(4)), true);
+    ASSERT_EQ(dict.Empty(), true);
+}
+
+/// 统计调用次数的哈希函数
+struct CountingHash
+{
+    inline static size_t calls = 0;
+
+    size_t operator()(int64_t key) const
+    {
+        calls++;
+        return std::hash<int64_t>()(key);
+    }
+};
+
+TEST(flat_dict, CachedHash)
+{
+    base::FlatDictionary<int64_t, int64_t, CountingHash> dict;
+    CountingHash::calls = 0;
+    for (int64_t i = 0; i < 1024; i++)
+    {
+        ASSERT_EQ(dict.Add(i, i), true);
+    }
+    // 扩容时使用缓存的哈希值，不会重新计算
+    ASSERT_EQ(CountingHash::calls, 1024);
+    ASSERT_EQ(dict.Expand(8192), true);
+    ASSERT_EQ(CountingHash::calls, 1024);
+    for (int64_t i = 0; i < 1024; i++)
+    {
+        ASSERT_EQ(dict.Find(i)->get().second, i);
+    }
+
+    // 调用者提供哈希值时不再计算
+    CountingHash::calls = 0;
+    for (int64_t i = 0; i < 1024; i++)
+    {
+        ASSERT_EQ(dict.Find(i, dict.Hash(i))->get().second, i);
+    }
+    ASSERT_EQ(CountingHash::calls, 1024);
+}
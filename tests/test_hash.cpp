@@ -0,0 +1,142 @@
+#include "base/dictionary.hpp"
+#include "base/hash.hpp"
+#include "base/simple_dynamic_string.hpp"
+#include "base/zipmap.hpp"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace
+{
+    /// 0x00 ~ 0x0f 组成的密钥，SipHash 论文测试向量使用的密钥
+    base::HashSeed SequenceSeed()
+    {
+        base::HashSeed seed{};
+        for (size_t i = 0; i < seed.size(); i++)
+        {
+            seed[i] = static_cast<uint8_t>(i);
+        }
+        return seed;
+    }
+
+    /// 每个用例结束后恢复默认配置
+    class HashTest : public ::testing::Test
+    {
+    protected:
+        void TearDown() override
+        {
+            base::SetHashAlgorithm(base::HashAlgorithm::SipHash);
+            base::SetHashSeed(base::HashSeed{});
+        }
+    };
+} // namespace
+
+TEST_F(HashTest, SipHash24Vectors)
+{
+    // SipHash 论文附录的测试向量，消息为 0x00, 0x01, ... 递增的字节
+    auto seed = SequenceSeed();
+    uint8_t message[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    ASSERT_EQ((base::SipHash<2, 4>(message, 0, seed)), 0x726fdb47dd0e0e31ULL);
+    ASSERT_EQ((base::SipHash<2, 4>(message, 1, seed)), 0x74f839c593dc67fdULL);
+    ASSERT_EQ((base::SipHash<2, 4>(message, 2, seed)), 0x0d6c8009d9a94f5aULL);
+    ASSERT_EQ((base::SipHash<2, 4>(message, 3, seed)), 0x85676696d7fb7e2dULL);
+}
+
+TEST_F(HashTest, SipHash13Vectors)
+{
+    // 与 CPython 3.11 在 PYTHONHASHSEED=0（全零密钥）下计算 bytes 的哈希值一致
+    base::HashSeed seed{};
+    auto hash = [&](std::string_view s) { return base::SipHash(s.data(), s.size(), seed); };
+    ASSERT_EQ(hash("a"), 0x407448d2b89b1813ULL);
+    ASSERT_EQ(hash("abcdefgh"), 0x3f7b849c0b8e35eaULL);
+    ASSERT_EQ(hash("hello world, toy redis key"), 0x10d669725a250f91ULL);
+}
+
+TEST_F(HashTest, SeedChangesResult)
+{
+    std::string_view key = "user:1000:session";
+    auto sip0 = base::SipHash(key.data(), key.size(), base::HashSeed{});
+    auto sip1 = base::SipHash(key.data(), key.size(), SequenceSeed());
+    ASSERT_NE(sip0, sip1);
+    ASSERT_NE(base::WyHash(key.data(), key.size(), 0), base::WyHash(key.data(), key.size(), 1));
+}
+
+TEST_F(HashTest, WyHashAllLengths)
+{
+    // 覆盖 0~16、17~48、大于 48 字节的各个分支，结果互不相同并且可重复计算
+    std::string data(300, '\0');
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = static_cast<char>(i * 31 + 7);
+    }
+    std::unordered_set<uint64_t> results;
+    for (size_t length = 0; length <= data.size(); length++)
+    {
+        auto hash = base::WyHash(data.data(), length, 42);
+        ASSERT_EQ(hash, base::WyHash(data.data(), length, 42));
+        results.insert(hash);
+    }
+    ASSERT_EQ(results.size(), data.size() + 1);
+
+    // 只改变一个字节，哈希值也要改变
+    auto changed = data;
+    changed[200] ^= 1;
+    ASSERT_NE(base::WyHash(data.data(), data.size(), 42),
+              base::WyHash(changed.data(), changed.size(), 42));
+}
+
+TEST_F(HashTest, ConfiguredAlgorithm)
+{
+    using namespace base::literals;
+    base::SetHashSeed(SequenceSeed());
+    std::string key = "hello";
+
+    for (auto algorithm : {base::HashAlgorithm::SipHash, base::HashAlgorithm::WyHash,
+                           base::HashAlgorithm::StdHash})
+    {
+        base::SetHashAlgorithm(algorithm);
+        auto hash = base::StringHash{}(key);
+        ASSERT_EQ(hash, base::StringHash{}(std::string_view(key)));
+        ASSERT_EQ(hash, base::StringHash{}("hello"_sds));
+        ASSERT_EQ(hash, base::StringHash{}("hello"));
+    }
+
+    base::SetHashAlgorithm(base::HashAlgorithm::SipHash);
+    ASSERT_EQ(base::StringHash{}(key), base::SipStringHash{}(key));
+    base::SetHashAlgorithm(base::HashAlgorithm::WyHash);
+    ASSERT_EQ(base::StringHash{}(key), base::WyStringHash{}(key));
+}
+
+TEST_F(HashTest, DictionaryWithHashFunctions)
+{
+    base::SetHashSeed(SequenceSeed());
+    base::Dictionary<std::string, int64_t, base::WyStringHash, base::StringEqual> wy;
+    base::Dictionary<std::string, int64_t, base::SipStringHash, base::StringEqual,
+                     base::OpenAddressing>
+        sip;
+    for (int64_t i = 0; i < 1000; i++)
+    {
+        ASSERT_EQ(wy.Add(std::to_string(i), i), true);
+        ASSERT_EQ(sip.Add(std::to_string(i), i), true);
+    }
+    for (int64_t i = 0; i < 1000; i++)
+    {
+        ASSERT_EQ(wy.Find(std::to_string(i))->get().second, i);
+        ASSERT_EQ(sip.Find(std::to_string(i))->get().second, i);
+    }
+}
+
+TEST_F(HashTest, ZipMapUsesConfiguredHash)
+{
+    base::SetHashAlgorithm(base::HashAlgorithm::WyHash);
+    base::ZipMap zmap;
+    zmap.Set("name", "toy-redis");
+    zmap.Set("port", "6758");
+    ASSERT_EQ(zmap.Get("name").value(), "toy-redis");
+    ASSERT_EQ(zmap.Get("port").value(), "6758");
+    ASSERT_EQ(zmap.Delete("name"), true);
+    ASSERT_EQ(zmap.Get("name").has_value(), false);
+}
@@ -0,0 +1,183 @@
+#include "ipc/pipe.hpp"
+#include "net/concepts/poller.hpp"
+#include "net/io_uring_poller.hpp"
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static_assert(net::Poller<net::IoUringPoller>);
+
+namespace
+{
+    std::vector<net::FiredEvent> PollAll(net::IoUringPoller &poller, uint64_t timeout_ms)
+    {
+        std::vector<net::FiredEvent> fired;
+        poller.Poll(timeout_ms);
+        poller.ConsumeAll([&](const net::FiredEvent &event) {
+            fired.push_back(event);
+        });
+        return fired;
+    }
+
+    /// io_uring 和回退的 epoll 行为相同
+    void PollerSemanticsTest(net::IoUringPoller &poller)
+    {
+        ipc::SimplePipeline pipeline;
+        pipeline.SetNotWait(ipc::PipePort::ReadEnd, true);
+        auto read_end = pipeline.ReadEnd();
+        auto write_end = pipeline.WriteEnd();
+
+        ASSERT_EQ(poller.AddEvent(read_end, net::Event::Read), 0);
+        EXPECT_TRUE(PollAll(poller, 0).empty());
+
+        ASSERT_EQ(write(write_end, "ping", 4), 4);
+        auto fired = PollAll(poller, 1000);
+        ASSERT_EQ(fired.size(), 1u);
+        EXPECT_EQ(fired[0].fd, read_end);
+        EXPECT_TRUE(fired[0].events & net::Event::Read);
+
+        // 数据没有读完时继续触发，和水平触发的 epoll 一样
+        fired = PollAll(poller, 1000);
+        ASSERT_EQ(fired.size(), 1u);
+        char buffer[8];
+        ASSERT_EQ(read(read_end, buffer, sizeof(buffer)), 4);
+        EXPECT_TRUE(PollAll(poller, 0).empty());
+
+        // 同一个 fd 同时监听读写
+        ASSERT_EQ(poller.AddEvent(write_end, net::Event::Write), 0);
+        fired = PollAll(poller, 1000);
+        ASSERT_EQ(fired.size(), 1u);
+        EXPECT_EQ(fired[0].fd, write_end);
+        EXPECT_EQ(poller.GetFdEventByFd(write_end).events, net::Event::Write);
+
+        // 删除监听之后不再触发
+        poller.DeleteEvent(write_end, net::Event::Write);
+        ASSERT_EQ(write(write_end, "pong", 4), 4);
+        poller.DeleteEvent(read_end, net::Event::Read);
+        EXPECT_TRUE(PollAll(poller, 10).empty());
+        EXPECT_EQ(poller.GetFdEventByFd(read_end).events, net::Event::None);
+
+        // 重新监听时立即发现已经到达的数据
+        ASSERT_EQ(poller.AddEvent(read_end, net::Event::Read), 0);
+        fired = PollAll(poller, 1000);
+        ASSERT_EQ(fired.size(), 1u);
+        EXPECT_EQ(fired[0].fd, read_end);
+        poller.DeleteEvent(read_end, net::Event::Read);
+    }
+} // namespace
+
+TEST(io_uring_poller, ioUring)
+{
+    auto poller = std::make_unique<net::IoUringPoller>();
+    if (!poller->EnableIoUring())
+    {
+        GTEST_SKIP() << "内核不支持 io_uring";
+    }
+    EXPECT_TRUE(poller->UsingIoUring());
+    PollerSemanticsTest(*poller);
+}
+
+TEST(io_uring_poller, acceptAndRecv)
+{
+    auto poller = std::make_unique<net::IoUringPoller>();
+    if (!poller->EnableIoUring())
+    {
+        GTEST_SKIP() << "内核不支持 io_uring";
+    }
+
+    auto listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    ASSERT_GE(listen_fd, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+    ASSERT_EQ(listen(listen_fd, 16), 0);
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(getsockname(listen_fd, reinterpret_cast<sockaddr *>(&addr), &len), 0);
+
+    std::vector<int32_t> accepted;
+    poller->AcceptMultishot(listen_fd, [&](int32_t result, std::string_view) {
+        accepted.push_back(result);
+    });
+    auto connect_one = [&] {
+        auto fd = socket(AF_INET, SOCK_STREAM, 0);
+        EXPECT_EQ(connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+        return fd;
+    };
+    auto poll_until = [&](auto done) {
+        for (int i = 0; i < 100 && !done(); i++)
+        {
+            PollAll(*poller, 100);
+        }
+    };
+
+    // 一次提交的 accept 接受多个连接
+    auto client1 = connect_one();
+    auto client2 = connect_one();
+    poll_until([&] { return accepted.size() == 2; });
+    ASSERT_EQ(accepted.size(), 2u);
+    EXPECT_GE(accepted[0], 0);
+    EXPECT_GE(accepted[1], 0);
+
+    std::string received;
+    std::vector<int32_t> results;
+    auto server1 = accepted[0];
+    ASSERT_TRUE(poller->RecvMultishot(server1, [&](int32_t result, std::string_view data) {
+        results.push_back(result);
+        received.append(data);
+    }));
+    ASSERT_EQ(write(client1, "PING\r\n", 6), 6);
+    poll_until([&] { return received.size() == 6; });
+    EXPECT_EQ(received, "PING\r\n");
+    ASSERT_EQ(write(client1, "ECHO", 4), 4);
+    poll_until([&] { return received.size() == 10; });
+    EXPECT_EQ(received, "PING\r\nECHO");
+
+    // 对端关闭时收到 0，之后不再调用
+    close(client1);
+    poll_until([&] { return !results.empty() && results.back() == 0; });
+    ASSERT_FALSE(results.empty());
+    EXPECT_EQ(results.back(), 0);
+    auto count = results.size();
+    PollAll(*poller, 10);
+    EXPECT_EQ(results.size(), count);
+
+    // 删除读事件之后取消 recv，收到的数据不再交给处理函数
+    bool called = false;
+    auto server2 = accepted[1];
+    ASSERT_TRUE(poller->RecvMultishot(server2, [&](int32_t, std::string_view) {
+        called = true;
+    }));
+    PollAll(*poller, 0);
+    poller->DeleteEvent(server2, net::Event::Read);
+    ASSERT_EQ(write(client2, "PING\r\n", 6), 6);
+    PollAll(*poller, 10);
+    PollAll(*poller, 10);
+    EXPECT_FALSE(called);
+
+    // 删除监听 socket 的读事件之后不再接受连接
+    poller->DeleteEvent(listen_fd, net::Event::Read);
+    PollAll(*poller, 0);
+    auto client3 = connect_one();
+    PollAll(*poller, 10);
+    EXPECT_EQ(accepted.size(), 2u);
+
+    for (auto fd : {client2, client3, server1, server2, listen_fd})
+    {
+        close(fd);
+    }
+}
+
+TEST(io_uring_poller, epollFallback)
+{
+    auto poller = std::make_unique<net::IoUringPoller>();
+    EXPECT_FALSE(poller->UsingIoUring());
+    PollerSemanticsTest(*poller);
+}
@@ -0,0 +1,61 @@
+#include "base/latency_histogram.hpp"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <vector>
+
+using base::LatencyHistogram;
+
+TEST(latency_histogram, BucketsAreContiguous)
+{
+    // 每个桶的下一个数值落在下一个桶里
+    for (size_t i = 0; i + 1 < LatencyHistogram::BUCKET_COUNT; i++)
+    {
+        auto upper = LatencyHistogram::BucketUpperBound(i);
+        ASSERT_EQ(LatencyHistogram::BucketIndex(upper), i);
+        ASSERT_EQ(LatencyHistogram::BucketIndex(upper + 1), i + 1);
+    }
+    EXPECT_EQ(LatencyHistogram::BucketIndex(UINT64_MAX), LatencyHistogram::BUCKET_COUNT - 1);
+}
+
+TEST(latency_histogram, RelativeError)
+{
+    // 桶的宽度不超过下界的 1 / SUB_BUCKETS
+    for (uint64_t value : {17ULL, 100ULL, 999ULL, 12345ULL, 1000000ULL, 987654321ULL})
+    {
+        auto upper = LatencyHistogram::BucketUpperBound(LatencyHistogram::BucketIndex(value));
+        EXPECT_GE(upper, value);
+        EXPECT_LE(upper - value, value / LatencyHistogram::SUB_BUCKETS);
+    }
+}
+
+TEST(latency_histogram, Percentiles)
+{
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.ValueAtPercentile(50), 0);
+
+    // 1 ~ 1000 各一次
+    for (uint64_t v = 1; v <= 1000; v++)
+    {
+        histogram.Record(v);
+    }
+    EXPECT_EQ(histogram.Count(), 1000);
+    EXPECT_EQ(histogram.Min(), 1);
+    EXPECT_EQ(histogram.Max(), 1000);
+
+    auto p50 = histogram.ValueAtPercentile(50);
+    EXPECT_GE(p50, 500);
+    EXPECT_LE(p50, 500 + 500 / LatencyHistogram::SUB_BUCKETS);
+    auto p99 = histogram.ValueAtPercentile(99);
+    EXPECT_GE(p99, 990);
+    EXPECT_LE(p99, 1000);
+    EXPECT_EQ(histogram.ValueAtPercentile(100), 1000);
+
+    uint64_t total = 0;
+    histogram.ForEachBucket([&](uint64_t, uint64_t count) { total += count; });
+    EXPECT_EQ(total, 1000);
+
+    histogram.Reset();
+    EXPECT_EQ(histogram.Count(), 0);
+    EXPECT_EQ(histogram.Max(), 0);
+}
@@ -0,0 +1,304 @@
+#include "base/redis_database.hpp"
+#include "base/redis_object.hpp"
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using base::ObjectEncoding;
+using base::ObjectType;
+using base::RedisObject;
+
+TEST(redis_object, StringToInteger)
+{
+    int64_t value = 0;
+    ASSERT_EQ(base::StringToInteger("0", value), true);
+    ASSERT_EQ(value, 0);
+    ASSERT_EQ(base::StringToInteger("-1024", value), true);
+    ASSERT_EQ(value, -1024);
+    ASSERT_EQ(base::StringToInteger("9223372036854775807", value), true);
+    ASSERT_EQ(value, std::numeric_limits<int64_t>::max());
+    ASSERT_EQ(base::StringToInteger("-9223372036854775808", value), true);
+    ASSERT_EQ(value, std::numeric_limits<int64_t>::min());
+
+    // 非规范的表示转换回字符串时和原字符串不同，不能使用整数编码
+    for (auto s : {"", "-", "-0", "007", "+1", " 1", "1 ", "1a", "9223372036854775808"})
+    {
+        ASSERT_EQ(base::StringToInteger(s, value), false) << s;
+    }
+}
+
+TEST(redis_object, StringEncoding)
+{
+    RedisObject::IntegerBuffer buffer;
+
+    auto integer = RedisObject::CreateString("-12345");
+    ASSERT_EQ(integer.Type(), ObjectType::String);
+    ASSERT_EQ(integer.Encoding(), ObjectEncoding::Int);
+    ASSERT_EQ(integer.StringView(buffer), "-12345");
+    ASSERT_EQ(integer.GetInteger().value(), -12345);
+    ASSERT_EQ(integer.StringLength(), 6);
+
+    auto embedded = RedisObject::CreateString("hello");
+    ASSERT_EQ(embedded.Encoding(), ObjectEncoding::EmbStr);
+    ASSERT_EQ(embedded.StringView(buffer), "hello");
+    ASSERT_EQ(embedded.GetInteger().has_value(), false);
+
+    std::string long_value(100, 'x');
+    auto raw = RedisObject::CreateString(long_value);
+    ASSERT_EQ(raw.Encoding(), ObjectEncoding::Raw);
+    ASSERT_EQ(raw.StringView(buffer), long_value);
+    ASSERT_EQ(raw.StringLength(), 100);
+
+    auto limit = RedisObject::CreateString(std::string(RedisObject::EMBSTR_MAX_LENGTH, 'y'));
+    ASSERT_EQ(limit.Encoding(), ObjectEncoding::EmbStr);
+}
+
+TEST(redis_object, MoveAndDuplicate)
+{
+    RedisObject::IntegerBuffer buffer;
+    std::string long_value(64, 'z');
+    auto raw = RedisObject::CreateString(long_value);
+
+    auto copy = raw.Duplicate();
+    auto moved = std::move(raw);
+    ASSERT_EQ(moved.StringView(buffer), long_value);
+    ASSERT_EQ(copy.StringView(buffer), long_value);
+    // 被移动的对象变成空字符串
+    ASSERT_EQ(raw.Encoding(), ObjectEncoding::EmbStr);
+    ASSERT_EQ(raw.StringView(buffer), "");
+
+    moved = RedisObject::CreateInteger(7);
+    ASSERT_EQ(moved.StringView(buffer), "7");
+}
+
+TEST(redis_object, ShareString)
+{
+    RedisObject::IntegerBuffer buffer;
+    ASSERT_FALSE(RedisObject::CreateString("short").ShareString());
+    ASSERT_FALSE(RedisObject::CreateInteger(42).ShareString());
+
+    std::string long_value(64, 's');
+    base::SharedStringRef reference;
+    {
+        auto raw = RedisObject::CreateString(long_value);
+        reference = raw.ShareString();
+        ASSERT_TRUE(reference);
+        ASSERT_EQ(reference.View().data(), raw.StringView(buffer).data());
+        auto copy = reference;
+        ASSERT_EQ(copy.View(), long_value);
+    }
+    // 对象释放之后引用仍然有效
+    ASSERT_EQ(reference.View(), long_value);
+}
+
+TEST(redis_object, Containers)
+{
+    auto list = RedisObject::CreateList();
+    ASSERT_EQ(list.Type(), ObjectType::List);
+    ASSERT_EQ(list.Encoding(), ObjectEncoding::LinkedList);
+    list.List().emplace_back("a");
+    list.List().emplace_back("b");
+    ASSERT_EQ(list.List().size(), 2);
+
+    auto hash = RedisObject::CreateHash();
+    ASSERT_EQ(hash.Hash().Add(std::string_view("field"), std::string("value")), true);
+    auto hash_copy = hash.Duplicate();
+    ASSERT_EQ(hash_copy.Hash().Find("field")->get().second, "value");
+
+    auto set = RedisObject::CreateSet();
+    ASSERT_EQ(set.Set().Add(std::string_view("member"), std::monostate{}), true);
+    ASSERT_EQ(set.Set().Add(std::string_view("member"), std::monostate{}), false);
+
+    auto zset = RedisObject::CreateZSet();
+    ASSERT_EQ(zset.ZSet().Add(std::string_view("member"), 1.5), true);
+    ASSERT_EQ(zset.ZSet().Find("member")->get().second, 1.5);
+}
+
+TEST(redis_db, SetLookupDelete)
+{
+    base::RedisDB db(3);
+    ASSERT_EQ(db.Id(), 3);
+    RedisObject::IntegerBuffer buffer;
+
+    db.SetKey(std::string_view("counter"), RedisObject::CreateString("100"));
+    db.SetKey(std::string_view("name"), RedisObject::CreateString("toy-redis"));
+    ASSERT_EQ(db.Size(), 2);
+    ASSERT_EQ(db.LookupKey("counter")->get().Encoding(), ObjectEncoding::Int);
+    ASSERT_EQ(db.LookupKey("name")->get().StringView(buffer), "toy-redis");
+
+    // setKey 覆盖任意类型的旧值
+    db.SetKey(std::string_view("name"), RedisObject::CreateList());
+    ASSERT_EQ(db.LookupKey("name")->get().Type(), ObjectType::List);
+    ASSERT_EQ(db.Add(std::string_view("name"), RedisObject::CreateString("x")), false);
+
+    ASSERT_EQ(db.Delete("counter"), true);
+    ASSERT_EQ(db.LookupKey("counter").has_value(), false);
+    ASSERT_EQ(db.Size(), 1);
+}
+
+TEST(redis_db, SwapKeySpace)
+{
+    base::RedisDB db0(0);
+    base::RedisDB db1(1);
+    db0.SetKey(std::string_view("a"), RedisObject::CreateString("0"));
+    db1.SetKey(std::string_view("b"), RedisObject::CreateString("1"));
+
+    db0.SwapKeySpace(db1);
+    ASSERT_EQ(db0.Id(), 0);
+    ASSERT_EQ(db0.LookupKey("b").has_value(), true);
+    ASSERT_EQ(db0.LookupKey("a").has_value(), false);
+    ASSERT_EQ(db1.LookupKey("a").has_value(), true);
+}
+
+TEST(redis_db, EmptyAsync)
+{
+    base::LazyFree lazy_free;
+    base::RedisDB db;
+    for (int64_t i = 0; i < 10000; i++)
+    {
+        db.SetKey(std::to_string(i), RedisObject::CreateString(std::string(32, 'v')));
+    }
+
+    // key 足够多时交给后台线程释放，当前键空间立即可用
+    ASSERT_EQ(db.Empty(&lazy_free), 10000);
+    ASSERT_EQ(db.Size(), 0);
+    ASSERT_EQ(db.LookupKey("1").has_value(), false);
+    db.SetKey(std::string_view("1"), RedisObject::CreateInteger(1));
+    ASSERT_EQ(db.Size(), 1);
+
+    // 少量 key 直接释放
+    ASSERT_EQ(db.Empty(&lazy_free), 1);
+    ASSERT_EQ(db.Size(), 0);
+
+    for (int i = 0; i < 100 && lazy_free.Pending() > 0; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(lazy_free.Pending(), 0);
+}
+
+TEST(redis_db, DatabaseArray)
+{
+    // 数据库数组扩容时 RedisDB 需要能被移动
+    std::vector<base::RedisDB> dbs;
+    for (int32_t id = 0; id < 16; id++)
+    {
+        dbs.emplace_back(id);
+        dbs.back().SetKey(std::to_string(id), RedisObject::CreateInteger(id));
+    }
+    for (int32_t id = 0; id < 16; id++)
+    {
+        ASSERT_EQ(dbs[id].Id(), id);
+        ASSERT_EQ(dbs[id].LookupKey(std::to_string(id))->get().GetInteger().value(), id);
+    }
+}
+
+TEST(redis_db, LazyExpire)
+{
+    base::RedisDB db;
+    auto now = base::NowMilliseconds();
+    ASSERT_EQ(db.SetExpire("missing", now + 1000), false);
+
+    db.SetKey(std::string_view("alive"), RedisObject::CreateString("1"));
+    db.SetKey(std::string_view("dead"), RedisObject::CreateString("2"));
+    ASSERT_EQ(db.SetExpire("alive", now + 100000), true);
+    ASSERT_EQ(db.SetExpire("dead", now - 1), true);
+    ASSERT_EQ(db.ExpiresSize(), 2);
+    ASSERT_EQ(db.GetExpire("alive"), now + 100000);
+
+    // 访问过期的 key 时才删除
+    ASSERT_EQ(db.Size(), 2);
+    ASSERT_EQ(db.LookupKey("dead").has_value(), false);
+    ASSERT_EQ(db.Size(), 1);
+    ASSERT_EQ(db.ExpiresSize(), 1);
+    ASSERT_EQ(db.LookupKey("alive").has_value(), true);
+
+    // SET 覆盖时清除过期时间
+    db.SetKey(std::string_view("alive"), RedisObject::CreateString("3"));
+    ASSERT_EQ(db.GetExpire("alive"), -1);
+    ASSERT_EQ(db.SetExpire("alive", now + 100000), true);
+    ASSERT_EQ(db.RemoveExpire("alive"), true);
+    ASSERT_EQ(db.RemoveExpire("alive"), false);
+
+    // DEL 同时删除过期时间
+    ASSERT_EQ(db.SetExpire("alive", now + 100000), true);
+    ASSERT_EQ(db.Delete("alive"), true);
+    ASSERT_EQ(db.ExpiresSize(), 0);
+}
+
+TEST(redis_db, ActiveExpire)
+{
+    base::RedisDB db;
+    auto now = base::NowMilliseconds();
+    for (int64_t i = 0; i < 1000; i++)
+    {
+        auto key = std::to_string(i);
+        db.SetKey(key, RedisObject::CreateInteger(i));
+        // 偶数 key 已经过期
+        db.SetExpire(key, i % 2 == 0 ? now - 1 : now + 100000);
+    }
+
+    // 每一步最多抽查指定数量的 key
+    auto stats = db.ActiveExpireStep(now, 20);
+    ASSERT_GE(stats.sampled, 20);
+    ASSERT_LT(stats.sampled, 40);
+    ASSERT_GT(stats.expired, 0);
+
+    // 反复执行直到遍历完一轮，全部过期 key 都被删除
+    size_t expired = stats.expired;
+    for (int i = 0; i < 1000 && db.ExpiresSize() > 500; i++)
+    {
+        expired += db.ActiveExpireStep(now, 20).expired;
+    }
+    ASSERT_EQ(expired, 500);
+    ASSERT_EQ(db.Size(), 500);
+    ASSERT_EQ(db.ExpiresSize(), 500);
+    for (int64_t i = 1; i < 1000; i += 2)
+    {
+        ASSERT_EQ(db.LookupKey(std::to_string(i)).has_value(), true);
+    }
+}
+
+TEST(redis_db, ExpireKeySharesKeySpaceKey)
+{
+    base::RedisDB db;
+    auto now = base::NowMilliseconds();
+    // key 足够长，不会使用 std::string 的短字符串优化
+    std::string prefix(64, 'k');
+    for (int64_t i = 0; i < 1000; i++)
+    {
+        auto key = prefix + std::to_string(i);
+        db.SetKey(key, RedisObject::CreateInteger(i));
+        ASSERT_EQ(db.SetExpire(key, now + 100000 + i), true);
+    }
+
+    // 过期字典里的 key 直接指向键空间里的 key，键空间扩容和 rehash 之后仍然有效
+    while (db.Dict().Rehash(100) || db.Expires().Rehash(100))
+    {
+    }
+    for (auto &[key, when] : db.Expires())
+    {
+        auto entry = db.Dict().Find(key);
+        ASSERT_EQ(entry.has_value(), true);
+        ASSERT_EQ(entry->get().first.data(), key.data());
+    }
+    for (int64_t i = 0; i < 1000; i++)
+    {
+        auto key = prefix + std::to_string(i);
+        ASSERT_EQ(db.GetExpire(key), now + 100000 + i);
+        ASSERT_EQ(db.LookupKey(key)->get().GetInteger().value(), i);
+    }
+
+    // 交换键空间之后过期时间跟着 key 一起移动
+    base::RedisDB other(1);
+    db.SwapKeySpace(other);
+    ASSERT_EQ(other.GetExpire(prefix + "0"), now + 100000);
+    ASSERT_EQ(other.Delete(prefix + "0"), true);
+    ASSERT_EQ(other.ExpiresSize(), 999);
+}
@@ -0,0 +1,245 @@
+#include "toy-redis/reply_buffer.hpp"
+#include "gtest/gtest.h"
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using base::RedisObject;
+using tr::PROTO_REPLY_CHUNK_BYTES;
+using tr::ReplyBuffer;
+
+namespace
+{
+    /// 非阻塞的 socket 对，发送端的缓冲区尽量小，方便制造部分写入
+    struct SocketPair
+    {
+        SocketPair()
+        {
+            EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+            int size = 4096;
+            setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+            fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+            fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+        }
+
+        ~SocketPair()
+        {
+            close(fds[0]);
+            close(fds[1]);
+        }
+
+        /// 读出接收端当前能读到的全部数据
+        std::string Drain()
+        {
+            std::string result;
+            char buf[4096];
+            ssize_t n;
+            while ((n = read(fds[1], buf, sizeof(buf))) > 0)
+            {
+                result.append(buf, n);
+            }
+            return result;
+        }
+
+        int fds[2];
+    };
+
+    /// 非阻塞的 TCP 回环连接，fds[0] 是发送端。unix socket 不支持 MSG_ZEROCOPY
+    struct TcpPair : SocketPair
+    {
+        TcpPair()
+        {
+            close(fds[0]);
+            close(fds[1]);
+            int listener = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t length = sizeof(addr);
+            EXPECT_EQ(bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+            EXPECT_EQ(listen(listener, 1), 0);
+            getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &length);
+            fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+            EXPECT_EQ(connect(fds[0], reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+            fds[1] = accept(listener, nullptr, nullptr);
+            close(listener);
+            fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+            fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+        }
+    };
+
+    std::string Pattern(size_t size)
+    {
+        std::string value(size, 0);
+        for (size_t i = 0; i < size; i++)
+        {
+            value[i] = static_cast<char>('a' + i % 26);
+        }
+        return value;
+    }
+} // namespace
+
+TEST(ReplyBuffer, SmallRepliesStayInFixedBuffer)
+{
+    ReplyBuffer buffer;
+    EXPECT_TRUE(buffer.Empty());
+    buffer.Append("+OK\r\n");
+    buffer.Append(":1\r\n");
+    EXPECT_FALSE(buffer.Empty());
+    EXPECT_EQ(buffer.PendingBytes(), 9);
+    EXPECT_EQ(buffer.BlockCount(), 0);
+
+    SocketPair pair;
+    EXPECT_EQ(buffer.WriteTo(pair.fds[0], SIZE_MAX), 9);
+    EXPECT_TRUE(buffer.Empty());
+    EXPECT_EQ(pair.Drain(), "+OK\r\n:1\r\n");
+}
+
+TEST(ReplyBuffer, LargeReplySpillsToChunks)
+{
+    ReplyBuffer buffer;
+    std::string header = "$100000\r\n";
+    std::string value(100000, 'x');
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        value[i] = static_cast<char>('a' + i % 26);
+    }
+    buffer.Append(header);
+    buffer.Append(value);
+    buffer.Append("\r\n");
+    // 固定缓冲区写满后剩余内容放在一个刚好放得下的块里，结尾的 "\r\n" 放进新的块
+    EXPECT_EQ(buffer.BlockCount(), 2);
+    EXPECT_EQ(buffer.PendingBytes(), header.size() + value.size() + 2);
+
+    SocketPair pair;
+    std::string received;
+    while (!buffer.Empty())
+    {
+        auto pending = buffer.PendingBytes();
+        auto written = buffer.WriteTo(pair.fds[0], SIZE_MAX);
+        ASSERT_GE(written, 0);
+        EXPECT_EQ(buffer.PendingBytes(), pending - written);
+        received += pair.Drain();
+    }
+    received += pair.Drain();
+    EXPECT_EQ(received, header + value + "\r\n");
+}
+
+TEST(ReplyBuffer, WriteCapPerCall)
+{
+    ReplyBuffer buffer;
+    std::string chunk(PROTO_REPLY_CHUNK_BYTES, 'c');
+    for (int i = 0; i < 8; i++)
+    {
+        buffer.Append(chunk);
+    }
+
+    SocketPair pair;
+    int size = 1024 * 1024;
+    setsockopt(pair.fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    auto total = buffer.PendingBytes();
+    auto written = buffer.WriteTo(pair.fds[0], 1);
+    // 达到上限后不再继续写下一个块
+    ASSERT_GT(written, 0);
+    EXPECT_LE(static_cast<size_t>(written), PROTO_REPLY_CHUNK_BYTES);
+    EXPECT_EQ(buffer.PendingBytes(), total - written);
+}
+
+TEST(ReplyBuffer, OrderIsPreservedAfterSpill)
+{
+    ReplyBuffer buffer;
+    std::string big(PROTO_REPLY_CHUNK_BYTES + 10, 'b');
+    buffer.Append(big);
+    SocketPair pair;
+    // 发送完固定缓冲区之后，新的回复必须排在链表里剩余内容的后面
+    ASSERT_GT(buffer.WriteTo(pair.fds[0], 1), 0);
+    buffer.Append("tail");
+    std::string received = pair.Drain();
+    while (!buffer.Empty())
+    {
+        ASSERT_GE(buffer.WriteTo(pair.fds[0], SIZE_MAX), 0);
+        received += pair.Drain();
+    }
+    EXPECT_EQ(received, big + "tail");
+}
+
+TEST(ReplyBuffer, ReferenceBlocksKeepOrder)
+{
+    ReplyBuffer buffer;
+    auto value = Pattern(3 * PROTO_REPLY_CHUNK_BYTES);
+    {
+        auto object = RedisObject::CreateString(value);
+        buffer.Append("$" + std::to_string(value.size()) + "\r\n");
+        buffer.AppendReference(object.ShareString());
+        buffer.Append("\r\n");
+        buffer.Append("+OK\r\n");
+    }
+    // 引用块之后的回复放进新的块，对象释放之后引用块仍然有效
+    EXPECT_EQ(buffer.BlockCount(), 2);
+    auto expected = "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n+OK\r\n";
+    EXPECT_EQ(buffer.PendingBytes(), expected.size());
+
+    SocketPair pair;
+    std::string received;
+    while (!buffer.Empty())
+    {
+        ASSERT_GE(buffer.WriteTo(pair.fds[0], SIZE_MAX), 0);
+        received += pair.Drain();
+    }
+    EXPECT_EQ(received, expected);
+}
+
+TEST(ReplyBuffer, TakeIncludesReferences)
+{
+    ReplyBuffer buffer;
+    auto value = Pattern(PROTO_REPLY_CHUNK_BYTES);
+    auto object = RedisObject::CreateString(value);
+    buffer.Append("head");
+    buffer.AppendReference(object.ShareString());
+    buffer.Append("tail");
+    EXPECT_EQ(buffer.Take(), "head" + value + "tail");
+    EXPECT_TRUE(buffer.Empty());
+}
+
+TEST(ReplyBuffer, ZeroCopyReleasesAfterCompletion)
+{
+    TcpPair pair;
+    int yes = 1;
+    if (setsockopt(pair.fds[0], SOL_SOCKET, SO_ZEROCOPY, &yes, sizeof(yes)) != 0)
+    {
+        GTEST_SKIP() << "SO_ZEROCOPY is not supported";
+    }
+
+    ReplyBuffer buffer;
+    buffer.SetZeroCopyThreshold(PROTO_REPLY_CHUNK_BYTES);
+    auto value = Pattern(4 * PROTO_REPLY_CHUNK_BYTES);
+    base::SharedStringRef reference;
+    {
+        auto object = RedisObject::CreateString(value);
+        reference = object.ShareString();
+        buffer.Append("$" + std::to_string(value.size()) + "\r\n");
+        buffer.AppendReference(object.ShareString());
+        buffer.Append("\r\n");
+    }
+
+    std::string received;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((!buffer.Empty() || buffer.ZeroCopyPending()) && std::chrono::steady_clock::now() < deadline)
+    {
+        ASSERT_GE(buffer.WriteTo(pair.fds[0], SIZE_MAX), 0);
+        received += pair.Drain();
+        buffer.ReapZeroCopy(pair.fds[0]);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    received += pair.Drain();
+    EXPECT_EQ(received, "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n");
+    // 收到完成通知之后缓冲区不再持有引用
+    EXPECT_FALSE(buffer.ZeroCopyPending());
+    EXPECT_EQ(reference.View(), value);
+}
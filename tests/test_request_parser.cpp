@@ -0,0 +1,175 @@
+#include "toy-redis/request_parser.hpp"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using tr::ParseResult;
+using tr::RequestParser;
+
+namespace
+{
+    std::vector<std::string> ToStrings(const std::vector<std::string_view> &argv)
+    {
+        return {argv.begin(), argv.end()};
+    }
+} // namespace
+
+TEST(RequestParser, Inline)
+{
+    RequestParser parser;
+    std::vector<std::string_view> argv;
+    std::string buffer = "set  k1\tv1\r\n";
+    ASSERT_EQ(parser.Parse(buffer, argv), ParseResult::Complete);
+    EXPECT_EQ(ToStrings(argv), (std::vector<std::string>{"set", "k1", "v1"}));
+    parser.Reset();
+    EXPECT_EQ(parser.Consumable(), buffer.size());
+
+    // 只有 '\n' 也可以
+    buffer += "get k1\n";
+    ASSERT_EQ(parser.Parse(buffer, argv), ParseResult::Complete);
+    EXPECT_EQ(ToStrings(argv), (std::vector<std::string>{"get", "k1"}));
+}
+
+TEST(RequestParser, MultiBulk)
+{
+    RequestParser parser;
+    std::vector<std::string_view> argv;
+    std::string buffer = "*3\r\n$3\r\nSET\r\n$2\r\nk1\r\n$6\r\nv1\r\nv1\r\n";
+    ASSERT_EQ(parser.Parse(buffer, argv), ParseResult::Complete);
+    // 参数可以包含 "\r\n"
+    EXPECT_EQ(ToStrings(argv), (std::vector<std::string>{"SET", "k1", "v1\r\nv1"}));
+    // 参数直接指向缓冲区
+    EXPECT_EQ(argv[0].data(), buffer.data() + 8);
+}
+
+TEST(RequestParser, EmptyMultiBulk)
+{
+    RequestParser parser;
+    std::vector<std::string_view> argv{"stale"};
+    std::string buffer = "*0\r\n";
+    ASSERT_EQ(parser.Parse(buffer, argv), ParseResult::Complete);
+    EXPECT_TRUE(argv.empty());
+}
+
+TEST(RequestParser, PartialFeed)
+{
+    const std::string request = "*2\r\n$3\r\nGET\r\n$10\r\n0123456789\r\n";
+    RequestParser parser;
+    std::vector<std::string_view> argv;
+    std::string buffer;
+    // 逐字节追加，最后一个字节之前都需要更多数据
+    for (size_t i = 0; i < request.size(); i++)
+    {
+        buffer.push_back(request[i]);
+        auto result = parser.Parse(buffer, argv);
+        if (i + 1 < request.size())
+        {
+            ASSERT_EQ(result, ParseResult::NeedMore) << i;
+        }
+        else
+        {
+            ASSERT_EQ(result, ParseResult::Complete);
+        }
+    }
+    EXPECT_EQ(ToStrings(argv), (std::vector<std::string>{"GET", "0123456789"}));
+}
+
+TEST(RequestParser, PipelineAndDiscard)
+{
+    RequestParser parser;
+    std::vector<std::string_view> argv;
+    std::string buffer = "*1\r\n$4\r\nPING\r\nget k\r\n*2\r\n$3\r\nGET\r\n$1";
+
+    ASSERT_EQ(parser.Parse(buffer, argv), ParseResult::Complete);
+    EXPECT_EQ(ToStrings(argv), (std::vector<std::string>{"PING"}));
+    parser.Reset();
+    ASSERT_EQ(parser.Parse(buffer, argv), ParseResult::Complete);
+    EXPECT_EQ(ToStrings(argv), (std::vector<std::string>{"get", "k"}));
+    parser.Reset();
+    ASSERT_EQ(parser.Parse(buffer, argv), ParseResult::NeedMore);
+
+    // 删除已经执行完的两条命令，未完成的命令从原来的位置继续解析
+    auto consumed = parser.Consumable();
+    EXPECT_EQ(consumed, std::string_view("*1\r\n$4\r\nPING\r\nget k\r\n").size());
+    buffer.erase(0, consumed);
+    parser.Discard(consumed);
+    buffer += "\r\nk\r\n";
+    ASSERT_EQ(parser.Parse(buffer, argv), ParseResult::Complete);
+    EXPECT_EQ(ToStrings(argv), (std::vector<std::string>{"GET", "k"}));
+    parser.Reset();
+    EXPECT_EQ(parser.Consumable(), buffer.size());
+}
+
+TEST(RequestParser, ProtocolErrors)
+{
+    std::vector<std::string_view> argv;
+    {
+        RequestParser parser;
+        std::string buffer = "*x\r\n";
+        EXPECT_EQ(parser.Parse(buffer, argv), ParseResult::Error);
+        EXPECT_EQ(parser.Error(), "Protocol error: invalid multibulk length");
+    }
+    {
+        RequestParser parser;
+        std::string buffer = "*1\r\n+3\r\n";
+        EXPECT_EQ(parser.Parse(buffer, argv), ParseResult::Error);
+        EXPECT_EQ(parser.Error(), "Protocol error: expected '$', got '+'");
+    }
+    {
+        RequestParser parser;
+        std::string buffer = "*1\r\n$-5\r\n";
+        EXPECT_EQ(parser.Parse(buffer, argv), ParseResult::Error);
+        EXPECT_EQ(parser.Error(), "Protocol error: invalid bulk length");
+    }
+    {
+        // 长度行的 '\r' 后面必须是 '\n'
+        RequestParser parser;
+        std::string buffer = "*1\rX$3\r\nget\r\n";
+        EXPECT_EQ(parser.Parse(buffer, argv), ParseResult::Error);
+        EXPECT_EQ(parser.Error(), "Protocol error: invalid multibulk length");
+    }
+    {
+        RequestParser parser;
+        std::string buffer = "*1\r\n$3\r\r\nget\r\n";
+        EXPECT_EQ(parser.Parse(buffer, argv), ParseResult::Error);
+        EXPECT_EQ(parser.Error(), "Protocol error: invalid bulk length");
+    }
+    {
+        // 参数数量很大但数据还没有到达时等待更多数据
+        RequestParser parser;
+        std::string buffer = "*1048576\r\n$3\r\nget\r\n";
+        EXPECT_EQ(parser.Parse(buffer, argv), ParseResult::NeedMore);
+    }
+    {
+        RequestParser parser;
+        std::string buffer(tr::PROTO_INLINE_MAX_SIZE + 1, 'a');
+        EXPECT_EQ(parser.Parse(buffer, argv), ParseResult::Error);
+        EXPECT_EQ(parser.Error(), "Protocol error: too big inline request");
+    }
+}
+
+TEST(RequestParser, BigArgumentEnd)
+{
+    RequestParser parser;
+    std::vector<std::string_view> argv;
+    auto length = static_cast<size_t>(tr::PROTO_MBULK_BIG_ARG);
+    std::string header = "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$" + std::to_string(length) + "\r\n";
+    std::string buffer = header + std::string(100, 'v');
+    ASSERT_EQ(parser.Parse(buffer, argv), ParseResult::NeedMore);
+    // 大参数和结尾的 "\r\n" 接收完时缓冲区的长度
+    EXPECT_EQ(parser.BigArgumentEnd(), header.size() + length + 2);
+
+    buffer = header + std::string(length, 'v') + "\r\n";
+    ASSERT_EQ(parser.Parse(buffer, argv), ParseResult::Complete);
+    EXPECT_EQ(argv[2].size(), length);
+    parser.Reset();
+    EXPECT_EQ(parser.BigArgumentEnd(), 0);
+
+    // 小参数不需要预先分配
+    RequestParser small;
+    buffer = "*2\r\n$3\r\nGET\r\n$100\r\nkey";
+    ASSERT_EQ(small.Parse(buffer, argv), ParseResult::NeedMore);
+    EXPECT_EQ(small.BigArgumentEnd(), 0);
+}
@@ -1,10 +1,13 @@
 #include "base/simple_dynamic_string.hpp"
 #include "gtest/gtest.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <iostream>
+#include <string>
 #include <string_view>
+#include <vector>
 
 TEST(SDS, AppendSpecifyTheLength)
 {
@@ -127,4 +130,145 @@ TEST(SDS, SdsSplit)
 
     std::cout << " length: " << result.size() << std::endl;
     ASSERT_EQ(result.size() == 3, true);
-}
\ No newline at end of file
+}
+TEST(SDS, SdsTrim2AllSame)
+{
+    base::SimpleDynamicString sds("rrrr");
+    sds.Trim2('r');
+    ASSERT_EQ(sds.Length(), 0);
+    ASSERT_EQ(std::string_view(sds), "");
+}
+
+TEST(SDS, SdsSplitReturnsViews)
+{
+    base::SimpleDynamicString sds("a,,b,");
+    auto result = sds.Split(",");
+    ASSERT_EQ(result.size(), 4);
+    ASSERT_EQ(result[0], "a");
+    ASSERT_EQ(result[1], "");
+    ASSERT_EQ(result[2], "b");
+    ASSERT_EQ(result[3], "");
+    // 结果直接指向 SDS 的内容
+    ASSERT_EQ(result[2].data(), sds.Data() + 3);
+}
+
+TEST(SDS, SimdKernelsMatchScalar)
+{
+    using base::simd::Level;
+    auto &scalar = base::simd::KernelsFor(Level::Scalar);
+    std::vector<Level> levels{Level::Scalar};
+    if (base::simd::DetectLevel() >= Level::SSE2)
+    {
+        levels.push_back(Level::SSE2);
+    }
+    if (base::simd::DetectLevel() >= Level::AVX2)
+    {
+        levels.push_back(Level::AVX2);
+    }
+
+    // 覆盖向量宽度前后的长度和所有字节值，检查尾部和 0x80 以上字节的处理
+    for (size_t length : {0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 255, 256, 1000})
+    {
+        std::string input(length, 0);
+        for (size_t i = 0; i < length; i++)
+        {
+            input[i] = static_cast<char>(i * 7 + 3);
+        }
+        for (auto level : levels)
+        {
+            auto &kernels = base::simd::KernelsFor(level);
+            auto expected = input;
+            auto actual = input;
+            scalar.toLower(expected.data(), length);
+            kernels.toLower(actual.data(), length);
+            ASSERT_EQ(actual, expected) << length;
+            scalar.toUpper(expected.data(), length);
+            kernels.toUpper(actual.data(), length);
+            ASSERT_EQ(actual, expected) << length;
+
+            for (size_t run : {size_t(0), length / 3, length})
+            {
+                std::string padded(length, 'x');
+                std::fill_n(padded.begin(), run, ' ');
+                ASSERT_EQ(kernels.countLeading(padded.data(), length, ' '), run) << length;
+                std::reverse(padded.begin(), padded.end());
+                ASSERT_EQ(kernels.countTrailing(padded.data(), length, ' '), run) << length;
+            }
+        }
+    }
+}
+
+TEST(SDS, InlineStorage)
+{
+    ASSERT_EQ(sizeof(base::SimpleDynamicString), 16);
+    base::SimpleDynamicString empty;
+    ASSERT_EQ(empty.Length(), 0);
+    ASSERT_STREQ(empty.Data(), "");
+
+    // 不超过 INLINE_CAPACITY 的内容存放在对象内部，不分配内存
+    std::string inline_value(base::SimpleDynamicString::INLINE_CAPACITY, 'i');
+    base::SimpleDynamicString sds(inline_value);
+    ASSERT_EQ(sds.AllocSize(), 0);
+    ASSERT_EQ(std::string_view(sds), inline_value);
+    ASSERT_EQ(sds.Data()[sds.Length()], '\0');
+
+    base::SimpleDynamicString moved(std::move(sds));
+    ASSERT_EQ(std::string_view(moved), inline_value);
+    ASSERT_EQ(sds.Length(), 0);
+
+    // 追加后超过对象内部的容量，转移到堆上
+    moved.Append("!");
+    ASSERT_GT(moved.AllocSize(), 0);
+    ASSERT_EQ(std::string_view(moved), inline_value + "!");
+}
+
+TEST(SDS, HeaderWidthFollowsLength)
+{
+    // 头部的宽度按长度选择：sdshdr5 1 字节，sdshdr8 3 字节，sdshdr16 5 字节，sdshdr32 9 字节
+    std::vector<std::pair<size_t, size_t>> cases{{20, 1}, {100, 3}, {300, 5}, {70000, 9}};
+    for (auto [length, header] : cases)
+    {
+        std::string value(length, 'h');
+        base::SimpleDynamicString sds(value);
+        ASSERT_EQ(sds.AllocSize(), header + length + 1) << length;
+        ASSERT_EQ(std::string_view(sds), value);
+
+        auto copy = sds;
+        ASSERT_EQ(copy, sds);
+        ASSERT_NE(copy.Data(), sds.Data());
+    }
+}
+
+TEST(SDS, GrowAcrossHeaderTypes)
+{
+    base::SimpleDynamicString sds;
+    std::string expected;
+    for (size_t i = 0; i < 100000; i++)
+    {
+        char c = static_cast<char>('a' + i % 26);
+        sds.Append(&c, 1);
+        expected.push_back(c);
+    }
+    ASSERT_EQ(std::string_view(sds), expected);
+    ASSERT_EQ(sds.Data()[sds.Length()], '\0');
+
+    // sdshdr5 没有容量字段，追加时先换成更宽的头部
+    base::SimpleDynamicString small(std::string(20, 's'));
+    ASSERT_EQ(small.Avail(), 0);
+    small.Append("tail");
+    ASSERT_EQ(std::string_view(small), std::string(20, 's') + "tail");
+
+    // 直接写入空闲空间
+    base::SimpleDynamicString buffer;
+    buffer.MakeRoomForNonGreedy(1000);
+    ASSERT_GE(buffer.Avail(), 1000);
+    auto room = buffer.Avail();
+    std::memset(buffer.End(), 'x', room);
+    buffer.IncrLength(room);
+    ASSERT_EQ(std::string_view(buffer), std::string(room, 'x'));
+    buffer.Range(room - 10, room);
+    ASSERT_EQ(std::string_view(buffer), std::string(10, 'x'));
+    buffer.Clear();
+    ASSERT_EQ(buffer.Length(), 0);
+    ASSERT_GE(buffer.Avail(), 1000);
+}
@@ -1,53 +1,496 @@
 //
 // Created by innoyiya on 2022/10/2.
 //
+#include "toy-redis/multi_reactor_server.hpp"
 #include "toy-redis/server.hpp"
 #include "gtest/gtest.h"
-#include <iostream>
-#include <iterator>
-#include <ostream>
+#include <arpa/inet.h>
+#include <future>
 #include <string>
+#include <string_view>
+#include <sys/resource.h>
 #include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using ServerConfig = tr::ToyRedisServer::ServerConfig;
+
+    /// 事件循环开始处理任务之后才完成的 future
+    std::future<void> WhenRunning(tr::ToyRedisServer &server)
+    {
+        auto ready = std::make_shared<std::promise<void>>();
+        auto future = ready->get_future();
+        server.Post([ready] { ready->set_value(); });
+        return future;
+    }
+
+    /// @brief 在后台线程运行的服务端
+    /// 构造时启动事件循环，等到全部事件循环都在运行才返回；
+    /// 析构时关闭全部连接并停止服务端
+    template <typename Server>
+    class TestServer
+    {
+    public:
+        explicit TestServer(const ServerConfig &config)
+            : port_(config.port), server_("", config)
+        {
+            thread_ = std::thread([this] { server_.Run(); });
+            std::vector<std::future<void>> running;
+            if constexpr (std::is_same_v<Server, tr::MultiReactorServer>)
+            {
+                for (size_t i = 0; i < server_.ShardCount(); i++)
+                {
+                    running.emplace_back(WhenRunning(server_.Shard(i)));
+                }
+            }
+            else
+            {
+                running.emplace_back(WhenRunning(server_));
+            }
+            for (auto &future : running)
+            {
+                future.wait();
+            }
+        }
+
+        ~TestServer()
+        {
+            for (auto fd : clients_)
+            {
+                close(fd);
+            }
+            server_.Stop();
+            thread_.join();
+        }
+
+        Server &Get()
+        {
+            return server_;
+        }
+
+        /// 新建一个连接到服务端的客户端
+        int Connect()
+        {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            ConnectSocket(fd);
+            return fd;
+        }
+
+        /// 用已经创建好的 socket 连接服务端，析构时关闭
+        void ConnectSocket(int fd)
+        {
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port_);
+            address.sin_addr.s_addr = inet_addr("127.0.0.1");
+            EXPECT_GE(connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+            clients_.push_back(fd);
+        }
+
+        /// 新建 count 个客户端
+        std::vector<int> Connect(size_t count)
+        {
+            std::vector<int> clients;
+            for (size_t i = 0; i < count; i++)
+            {
+                clients.push_back(Connect());
+            }
+            return clients;
+        }
+
+    private:
+        int32_t port_;
+        Server server_;
+        std::thread thread_;
+        std::vector<int> clients_;
+    };
+
+    /// 完整发送请求
+    void Send(int fd, std::string_view request)
+    {
+        ASSERT_EQ(send(fd, request.data(), request.size(), 0), static_cast<ssize_t>(request.size()));
+    }
+
+    /// 读取 size 字节的回复，连接关闭时提前返回
+    std::string Receive(int fd, size_t size)
+    {
+        std::string replies;
+        char buf[16 * 1024];
+        while (replies.size() < size)
+        {
+            auto length = recv(fd, buf, sizeof(buf), 0);
+            if (length <= 0)
+            {
+                break;
+            }
+            replies.append(buf, length);
+        }
+        return replies;
+    }
+
+    /// 发送请求并检查收到的回复
+    void SendAndExpect(int fd, std::string_view request, std::string_view expected)
+    {
+        Send(fd, request);
+        EXPECT_EQ(Receive(fd, expected.size()), expected);
+    }
+
+    /// 一条 multi-bulk 格式的 SET 命令
+    std::string SetCommand(std::string_view key, std::string_view value)
+    {
+        return "*3\r\n$3\r\nSET\r\n$" + std::to_string(key.size()) + "\r\n" + std::string(key) + "\r\n$" +
+               std::to_string(value.size()) + "\r\n" + std::string(value) + "\r\n";
+    }
+
+    /// GET 命令的回复
+    std::string BulkReply(std::string_view value)
+    {
+        return "$" + std::to_string(value.size()) + "\r\n" + std::string(value) + "\r\n";
+    }
+} // namespace
 
 TEST(server, addClient)
 {
-    // std::thread([&]() {
-    //     tr::ToyRedisServer server("");
-    // }).detach();
-    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-    std::cout << "client init" << std::endl;
-
-    int clientId = socket(AF_INET, SOCK_STREAM, 0);
-    std::cout << "clientId is " << clientId << std::endl;
-    assert(clientId != -1 && "Error connect");
-
-    sockaddr_in serverAddr;
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(6758);
-    serverAddr.sin_addr.s_addr = inet_addr("172.17.0.2");
-    auto result = connect(clientId, (struct sockaddr *)&serverAddr, sizeof(serverAddr));
-    std::cout << "result is " << result << std::endl;
-    assert(result >= 0 && "Error: connect");
-    char buf[1024];
-    // buf[0] = '*';
-    // buf[1] = 't';
-    auto commond = "set k1 v1";
-    auto send_length = send(clientId, commond, 9, 0);
-    std::cout << "send is " << send_length << std::endl;
-    assert(send_length > 0 && "Error: send");
-
-    auto set_response_size = recv(clientId, buf, 1024, 0);
-    std::cout << "set_response_size is " << set_response_size << std::endl;
-    std::cout << "set_response is " << buf << std::endl;
-
-    std::cout << "send get k1 commond" << std::endl;
-    auto get_commond = "get k1";
-    send_length = send(clientId, get_commond, 6, 0);
-
-    auto recv_length = recv(clientId, buf, 1024, 0);
-    std::cout << "recv_length is " << recv_length << std::endl;
-    // std::string resu{buf};
-    std::cout << "recv response is " << buf << std::endl;
-    std::this_thread::sleep_for(std::chrono::milliseconds(10000));
-    close(clientId);
-}
\ No newline at end of file
+    TestServer<tr::ToyRedisServer> server(ServerConfig{});
+    auto fd = server.Connect();
+
+    // inline 命令
+    SendAndExpect(fd, "set k1 v1\r\n", "+OK\r\n");
+    // multi-bulk 命令
+    SendAndExpect(fd, "*2\r\n$3\r\nGET\r\n$2\r\nk1\r\n", "$2\r\nv1\r\n");
+
+    // pipeline：一次发送多条命令，回复按顺序返回
+    std::string pipeline;
+    std::string expected;
+    for (int i = 0; i < 64; i++)
+    {
+        auto value = std::to_string(i);
+        pipeline += SetCommand("k2", value) + "GET k2\r\n";
+        expected += "+OK\r\n" + BulkReply(value);
+    }
+    SendAndExpect(fd, pipeline, expected);
+}
+
+TEST(server, ioThreads)
+{
+    ServerConfig config;
+    config.port = 6759;
+    config.ioThreads = 4;
+    TestServer<tr::ToyRedisServer> server(config);
+
+    // 连接数量足够多时读写由 IO 线程并行完成
+    auto clients = server.Connect(16);
+    for (int round = 0; round < 10; round++)
+    {
+        std::vector<std::string> expected(clients.size());
+        for (size_t i = 0; i < clients.size(); i++)
+        {
+            std::string pipeline;
+            for (int j = 0; j < 16; j++)
+            {
+                auto key = "key" + std::to_string(i) + "_" + std::to_string(j);
+                auto value = std::to_string(round * 100 + j);
+                pipeline += "SET " + key + " " + value + "\r\nGET " + key + "\r\n";
+                expected[i] += "+OK\r\n" + BulkReply(value);
+            }
+            Send(clients[i], pipeline);
+        }
+        for (size_t i = 0; i < clients.size(); i++)
+        {
+            EXPECT_EQ(Receive(clients[i], expected[i].size()), expected[i]);
+        }
+    }
+}
+
+TEST(server, multiReactor)
+{
+    ServerConfig config;
+    config.port = 6760;
+    config.reactors = 4;
+    TestServer<tr::MultiReactorServer> server(config);
+    ASSERT_EQ(server.Get().ShardCount(), 4u);
+
+    // 连接被内核分到不同的分片，key 分布在全部分片上，大部分命令需要转发
+    auto clients = server.Connect(8);
+
+    // 每个连接写入自己的 key，pipeline 里本地和转发的命令交错，回复保持顺序
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        std::string pipeline;
+        std::string expected;
+        for (int j = 0; j < 32; j++)
+        {
+            auto key = "key" + std::to_string(i) + "_" + std::to_string(j);
+            auto value = std::to_string(i * 100 + j);
+            pipeline += "SET " + key + " " + value + "\r\nGET " + key + "\r\nPING\r\n";
+            expected += "+OK\r\n" + BulkReply(value) + "+PONG\r\n";
+        }
+        SendAndExpect(clients[i], pipeline, expected);
+    }
+    // 从其它连接读取，不管连接在哪个分片都能读到同一个值
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        auto owner = (i + 1) % clients.size();
+        std::string pipeline;
+        std::string expected;
+        for (int j = 0; j < 32; j++)
+        {
+            pipeline += "GET key" + std::to_string(owner) + "_" + std::to_string(j) + "\r\n";
+            expected += BulkReply(std::to_string(owner * 100 + j));
+        }
+        SendAndExpect(clients[i], pipeline, expected);
+    }
+    // 选择的数据库随命令一起转发
+    SendAndExpect(clients[0], "SELECT 1\r\nGET key0_0\r\nSET key0_0 db1\r\nGET key0_0\r\n",
+                  "+OK\r\n$-1\r\n+OK\r\n$3\r\ndb1\r\n");
+    // FLUSHDB 在全部分片上执行
+    SendAndExpect(clients[1], "FLUSHDB SYNC\r\n", "+OK\r\n");
+    std::string pipeline;
+    std::string expected;
+    for (int j = 0; j < 32; j++)
+    {
+        pipeline += "GET key1_" + std::to_string(j) + "\r\n";
+        expected += "$-1\r\n";
+    }
+    SendAndExpect(clients[2], pipeline, expected);
+    SendAndExpect(clients[3], "SELECT 1\r\nGET key0_0\r\n", "+OK\r\n$3\r\ndb1\r\n");
+}
+
+TEST(server, edgeTriggered)
+{
+    ServerConfig config;
+    config.port = 6761;
+    config.edgeTriggered = true;
+    TestServer<tr::ToyRedisServer> server(config);
+
+    // 大量连接同时到达，一次可读事件要接受完全部连接
+    auto clients = server.Connect(64);
+    for (auto fd : clients)
+    {
+        Send(fd, "PING\r\n");
+    }
+    for (auto fd : clients)
+    {
+        EXPECT_EQ(Receive(fd, 7), "+PONG\r\n");
+    }
+
+    // 超过一次读取大小的 pipeline 要在一次读事件里读完
+    std::string pipeline;
+    std::string expected;
+    for (int i = 0; i < 2000; i++)
+    {
+        auto value = std::to_string(i);
+        pipeline += "SET key" + value + " " + value + "\r\n";
+        expected += "+OK\r\n";
+    }
+    ASSERT_GT(pipeline.size(), static_cast<size_t>(net::REDIS_IOBUF_LEN));
+    SendAndExpect(clients[0], pipeline, expected);
+
+    // 超过 NET_MAX_WRITES_PER_EVENT 的回复要在写事件里写完
+    std::string value(1024 * 1024, 'v');
+    SendAndExpect(clients[1], SetCommand("big", value), "+OK\r\n");
+    SendAndExpect(clients[1], "GET big\r\nGET big\r\n", BulkReply(value) + BulkReply(value));
+
+    // 发送命令后立即关闭写端，命令仍然执行并收到回复
+    Send(clients[2], "GET key7\r\n");
+    shutdown(clients[2], SHUT_WR);
+    EXPECT_EQ(Receive(clients[2], 7), "$1\r\n7\r\n");
+}
+
+TEST(server, edgeTriggeredAcceptRetry)
+{
+    ServerConfig config;
+    config.port = 6767;
+    config.edgeTriggered = true;
+    TestServer<tr::ToyRedisServer> server(config);
+
+    // 先创建客户端的 socket，再把 fd 上限降到没有空闲的 fd，服务端 accept 时返回 EMFILE
+    std::vector<int> clients;
+    for (int i = 0; i < 3; i++)
+    {
+        auto fd = socket(AF_INET, SOCK_STREAM, 0);
+        timeval timeout{2, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        clients.push_back(fd);
+    }
+    rlimit original{};
+    ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &original), 0);
+    auto lowest_free = dup(0);
+    close(lowest_free);
+    rlimit limited = original;
+    limited.rlim_cur = static_cast<rlim_t>(lowest_free);
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &limited), 0);
+    for (auto fd : clients)
+    {
+        server.ConnectSocket(fd);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &original), 0);
+
+    // 边缘触发不会再通知已经在队列里的连接，由服务端稍后重试 accept
+    for (auto fd : clients)
+    {
+        SendAndExpect(fd, "PING\r\n", "+PONG\r\n");
+    }
+}
+
+TEST(server, ioUring)
+{
+    ServerConfig config;
+    config.port = 6762;
+    config.ioUring = true;
+    TestServer<tr::ToyRedisServer> server(config);
+
+    auto clients = server.Connect(8);
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        std::string pipeline;
+        std::string expected;
+        for (int j = 0; j < 1000; j++)
+        {
+            auto value = std::to_string(i * 10000 + j);
+            pipeline += "SET key" + value + " " + value + "\r\nGET key" + value + "\r\n";
+            expected += "+OK\r\n" + BulkReply(value);
+        }
+        SendAndExpect(clients[i], pipeline, expected);
+    }
+
+    // 回复超过 socket 缓冲区时由写事件继续发送
+    std::string value(1024 * 1024, 'v');
+    SendAndExpect(clients[0], SetCommand("big", value), "+OK\r\n");
+    SendAndExpect(clients[0], "GET big\r\n", BulkReply(value));
+
+    // recv 完成事件报告对端关闭之后，回复写完再关闭连接
+    Send(clients[1], "GET big\r\nPING\r\n");
+    shutdown(clients[1], SHUT_WR);
+    auto expected = BulkReply(value) + "+PONG\r\n";
+    EXPECT_EQ(Receive(clients[1], expected.size() + 1), expected);
+    SendAndExpect(server.Connect(), "PING\r\n", "+PONG\r\n");
+}
+
+TEST(server, zeroCopy)
+{
+    ServerConfig config;
+    config.port = 6763;
+    config.zeroCopyThreshold = 64 * 1024;
+    TestServer<tr::ToyRedisServer> server(config);
+    auto fd = server.Connect();
+
+    std::string value(1024 * 1024, 'z');
+    for (size_t i = 0; i < value.size(); i += 4096)
+    {
+        value[i] = static_cast<char>('a' + i / 4096 % 26);
+    }
+    SendAndExpect(fd, SetCommand("big", value), "+OK\r\n");
+
+    // 回复还没有发送完时覆盖 key，回复里仍然是旧的值
+    SendAndExpect(fd, "GET big\r\nSET big small\r\nGET big\r\n", BulkReply(value) + "+OK\r\n$5\r\nsmall\r\n");
+}
+
+TEST(server, closeAfterZeroCopyReply)
+{
+    ServerConfig config;
+    config.port = 6766;
+    config.zeroCopyThreshold = 64 * 1024;
+    TestServer<tr::ToyRedisServer> server(config);
+    auto clients = server.Connect(2);
+    auto closing_count = [&server] {
+        std::promise<size_t> count;
+        server.Get().Post([&] { count.set_value(server.Get().ClosingClientCount()); });
+        return count.get_future().get();
+    };
+    auto wait_closing_count = [&](size_t expected) {
+        for (int i = 0; i < 200 && closing_count() != expected; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return closing_count();
+    };
+
+    std::string value(128 * 1024, 'z');
+    for (size_t i = 0; i < value.size(); i += 4096)
+    {
+        value[i] = static_cast<char>('a' + i / 4096 % 26);
+    }
+    SendAndExpect(clients[0], SetCommand("big", value), "+OK\r\n");
+
+    // 回复已经全部交给内核，但对端还没有读取，零拷贝发送没有完成，socket 等到完成通知之后再关闭
+    Send(clients[0], "GET big\r\n");
+    shutdown(clients[0], SHUT_WR);
+    EXPECT_EQ(wait_closing_count(1), 1u);
+
+    // 覆盖 key 之后，等待关闭的连接仍然持有旧的值
+    SendAndExpect(clients[1], "SET big small\r\n", "+OK\r\n");
+    auto expected = BulkReply(value);
+    EXPECT_EQ(Receive(clients[0], expected.size() + 1), expected);
+    EXPECT_EQ(wait_closing_count(0), 0u);
+}
+
+TEST(server, closeAfterReply)
+{
+    ServerConfig config;
+    config.port = 6764;
+    TestServer<tr::ToyRedisServer> server(config);
+    auto clients = server.Connect(3);
+    std::string value(4 * 1024 * 1024, 'c');
+    SendAndExpect(clients[0], SetCommand("big", value), "+OK\r\n");
+
+    // 关闭写端之后，超过 socket 缓冲区的回复仍然完整写出，然后服务端关闭连接
+    Send(clients[0], "GET big\r\nGET big\r\n");
+    shutdown(clients[0], SHUT_WR);
+    auto expected = BulkReply(value) + BulkReply(value);
+    EXPECT_EQ(Receive(clients[0], expected.size() + 1), expected);
+
+    // 协议错误之前的回复和错误回复都完整写出，然后服务端关闭连接
+    Send(clients[1], "GET big\r\n*1\r\n$x\r\n");
+    expected = BulkReply(value) + "-ERR Protocol error: invalid bulk length\r\n";
+    EXPECT_EQ(Receive(clients[1], expected.size() + 1), expected);
+
+    // 对端直接断开，没有回复需要写出，服务端立即关闭连接
+    shutdown(clients[2], SHUT_WR);
+    EXPECT_EQ(Receive(clients[2], 1), "");
+    SendAndExpect(server.Connect(), "PING\r\n", "+PONG\r\n");
+}
+
+TEST(server, closeAfterForwardedReply)
+{
+    ServerConfig config;
+    config.port = 6765;
+    config.reactors = 4;
+    TestServer<tr::MultiReactorServer> server(config);
+
+    // 大部分 key 属于其它分片，关闭写端时客户端正在等待转发的回复
+    for (auto fd : server.Connect(8))
+    {
+        std::string pipeline;
+        std::string expected;
+        for (int j = 0; j < 16; j++)
+        {
+            auto key = "key" + std::to_string(fd) + "_" + std::to_string(j);
+            pipeline += "SET " + key + " " + key + "\r\nGET " + key + "\r\n";
+            expected += "+OK\r\n" + BulkReply(key);
+        }
+        Send(fd, pipeline);
+        shutdown(fd, SHUT_WR);
+        EXPECT_EQ(Receive(fd, expected.size() + 1), expected);
+    }
+}
+
+TEST(server, hashSeedIsSetOnce)
+{
+    // 不监听端口，只检查初始化
+    ServerConfig config;
+    config.port = 0;
+    tr::ToyRedisServer first("", config);
+    auto seed = base::GetHashSeed();
+    auto algorithm = base::GetHashAlgorithm();
+
+    // 之后创建的服务端不能修改进程级的哈希配置，否则已经存入的 key 会找不到
+    config.hashAlgorithm = algorithm == base::HashAlgorithm::WyHash ? base::HashAlgorithm::SipHash
+                                                                    : base::HashAlgorithm::WyHash;
+    tr::ToyRedisServer second("", config);
+    EXPECT_EQ(base::GetHashSeed(), seed);
+    EXPECT_EQ(base::GetHashAlgorithm(), algorithm);
+}
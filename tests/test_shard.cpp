@@ -0,0 +1,54 @@
+#include "toy-redis/shard.hpp"
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+TEST(shard, keyHashSlot)
+{
+    // 和 redis cluster 的 CLUSTER KEYSLOT 结果一致
+    static_assert(tr::Crc16("123456789") == 0x31C3);
+    EXPECT_EQ(tr::KeyHashSlot("foo"), 12182u);
+    EXPECT_EQ(tr::KeyHashSlot("bar"), 5061u);
+    EXPECT_EQ(tr::KeyHashSlot("somekey"), 11058u);
+
+    // 只对 {tag} 计算
+    EXPECT_EQ(tr::KeyHashSlot("{user1000}.following"), tr::KeyHashSlot("{user1000}.followers"));
+    EXPECT_EQ(tr::KeyHashSlot("{user1000}.following"), tr::KeyHashSlot("user1000"));
+    // 空的 {} 不是 tag，对整个 key 计算
+    EXPECT_NE(tr::KeyHashSlot("foo{}{bar}"), tr::KeyHashSlot("bar"));
+    EXPECT_EQ(tr::KeyHashSlot("foo{{bar}}zap"), tr::KeyHashSlot("{bar"));
+}
+
+TEST(shard, mailbox)
+{
+    tr::Mailbox mailbox;
+    int executed = 0;
+    // 只有第一次投递需要唤醒
+    EXPECT_TRUE(mailbox.Post([&] { executed++; }));
+    EXPECT_FALSE(mailbox.Post([&] { executed++; }));
+    mailbox.Process();
+    EXPECT_EQ(executed, 2);
+    EXPECT_TRUE(mailbox.Post([&] { executed++; }));
+    mailbox.Process();
+    EXPECT_EQ(executed, 3);
+
+    // 多个线程同时投递，任务全部在处理线程执行
+    int total = 0;
+    std::vector<std::thread> producers;
+    for (int i = 0; i < 4; i++)
+    {
+        producers.emplace_back([&] {
+            for (int j = 0; j < 1000; j++)
+            {
+                mailbox.Post([&] { total++; });
+            }
+        });
+    }
+    for (auto &producer : producers)
+    {
+        producer.join();
+    }
+    mailbox.Process();
+    EXPECT_EQ(total, 4000);
+}
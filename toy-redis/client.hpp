@@ -2,16 +2,28 @@
 // Created by innoyiya on 2022/7/30.
 //
 #pragma once
-#include "base/dictionary.hpp"
+#include "base/lazy_free.hpp"
 #include "base/log.hpp"
 #include "base/redis_database.hpp"
+#include "base/redis_object.hpp"
 #include "base/simple_dynamic_string.hpp"
+#include "base/time_helper.hpp"
 #include "identifier.h"
 #include "net/constants.hpp"
 #include "net/poller_types.hpp"
+#include "toy-redis/command_table.hpp"
+#include "toy-redis/reply_buffer.hpp"
+#include "toy-redis/request_parser.hpp"
+#include <algorithm>
+#include <any>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
 #include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unistd.h>
 #include <vector>
 
@@ -19,8 +31,26 @@ namespace tr
 {
     using EventHandler =
         std::function<void(int32_t, int32_t, const std::any &)>;
+
+    /// redis macro: NET_MAX_WRITES_PER_EVENT
+    /// 每轮事件循环给一个客户端最多写入的字节数，避免一个很大的回复长时间占用事件循环，
+    /// 导致其它客户端得不到处理
+    static constexpr size_t NET_MAX_WRITES_PER_EVENT = 64 * 1024;
+
+    class RedisClient;
+
+    /// redis struct: redisCommand
+    /// 命令表的条目，proc 是执行命令的成员函数
+    struct RedisCommand : CommandInfo
+    {
+        void (RedisClient::*proc)() = nullptr;
+    };
+
     class RedisClient
     {
+        /// 命令表需要取得各个命令实现的地址
+        friend constexpr auto MakeCommandTable();
+
     public:
         RedisClient()
         {
@@ -51,180 +81,530 @@ namespace tr
             this->fd_ = fd;
         }
 
+        /// redis function: readQueryFromClient
+        /// 读事件的处理函数：读取请求并执行
         ErrorCode readQueryFromClient()
         {
-            char buf[net::REDIS_IOBUF_LEN];
-            auto lengthOfRead = read(fd_, buf, net::REDIS_IOBUF_LEN);
-            std::cout << "lengthOfRead of fd " << fd_ << " is " << lengthOfRead << std::endl;
-            if (lengthOfRead == -1)
+            ReadQuery();
+            return ProcessReadResult();
+        }
+
+        /// 读取 socket 并解析第一条完整的命令，不执行命令。
+        /// 开启 IO 线程时由 IO 线程调用，只能访问这个客户端自己的状态
+        void ReadQuery()
+        {
+            if (reply_.ZeroCopyPending())
             {
-                if (errno == EAGAIN)
+                reply_.ReapZeroCopy(fd_);
+            }
+            readResult_ = ErrorCode::REDIS_OK;
+            size_t total = 0;
+            // 水平触发时每次可读事件只读一次，剩下的数据在下一轮读取；
+            // 边缘触发时剩下的数据不会再触发事件，必须一直读到 EAGAIN
+            while (true)
+            {
+                // 直接读进查询缓冲区的空闲空间，不经过临时缓冲区
+                size_t readLength = net::REDIS_IOBUF_LEN;
+                auto bigArgumentEnd = parser_.BigArgumentEnd();
+                if (bigArgumentEnd > queryBuf.Length())
                 {
-                    lengthOfRead = 0;
+                    // 正在接收大参数：只读这个参数剩下的部分，缓冲区按参数的长度一次分配好，
+                    // 不会在接收过程中反复两倍扩容和复制
+                    readLength = bigArgumentEnd - queryBuf.Length();
+                    queryBuf.MakeRoomForNonGreedy(readLength);
                 }
                 else
                 {
-                    client_logger.Debug("Reading from client: %s", strerror(errno));
-                    return ErrorCode::REDIS_ERR;
+                    queryBuf.MakeRoomFor(readLength);
                 }
+                auto lengthOfRead = read(fd_, queryBuf.End(), readLength);
+                if (lengthOfRead == -1)
+                {
+                    if (errno != EAGAIN)
+                    {
+                        client_logger.Debug("Reading from client: %s", strerror(errno));
+                        readResult_ = ErrorCode::REDIS_ERR;
+                    }
+                    break;
+                }
+                if (lengthOfRead == 0)
+                {
+                    client_logger.Debug("Client closed connection");
+                    // 已经收到的命令先执行，回复全部写出之后再关闭连接
+                    closeAfterInput_ = true;
+                    break;
+                }
+                queryBuf.IncrLength(lengthOfRead);
+                total += lengthOfRead;
+                if (!edgeTriggered_)
+                {
+                    break;
+                }
+            }
+            if (total == 0)
+            {
+                return;
+            }
+            ParseFirstCommand();
+        }
+
+        /// 使用 io_uring 的 recv 时，数据已经由内核收进缓冲区，在完成事件里交给客户端执行。
+        /// length 是收到的字节数，0 表示对端关闭，小于 0 是出错的 errno 取负
+        ErrorCode ReceiveQuery(int32_t length, std::string_view data)
+        {
+            if (reply_.ZeroCopyPending())
+            {
+                reply_.ReapZeroCopy(fd_);
             }
-            else if (lengthOfRead == 0)
+            readResult_ = ErrorCode::REDIS_OK;
+            if (length < 0)
+            {
+                client_logger.Debug("Reading from client: %s", strerror(-length));
+            }
+            else if (length == 0)
             {
                 client_logger.Debug("Client closed connection");
-                close(fd_);
-                Free();
-                return ErrorCode::REDIS_CLOSE;
             }
-            else if (lengthOfRead > 0)
+            if (length <= 0)
             {
-                queryBuf.Append(buf, lengthOfRead);
+                // 出错或者对端关闭之后 recv 请求已经结束，不会再收到数据，回复写完后关闭连接
+                closeAfterInput_ = true;
             }
             else
+            {
+                queryBuf.Append(data);
+                ParseFirstCommand();
+            }
+            return ProcessReadResult();
+        }
+
+        /// 提前解析第一条命令，剩下的命令由事件循环线程在执行时解析。
+        /// 阻塞时之后的读取可能使缓冲区被重新分配，不能提前生成指向缓冲区的参数
+        void ParseFirstCommand()
+        {
+            if (!(flag_ & (client_flag::REDIS_PENDING_COMMAND | client_flag::REDIS_BLOCKED)))
+            {
+                parseResult_ = parser_.Parse(queryBuf, argv);
+                if (parseResult_ != ParseResult::NeedMore)
+                {
+                    flag_ |= client_flag::REDIS_PENDING_COMMAND;
+                }
+            }
+        }
+
+        /// 在事件循环线程里处理 ReadQuery 的结果：执行收到的命令。
+        /// 对端关闭连接时不在这里关闭，等回复全部写出之后由服务端关闭
+        ErrorCode ProcessReadResult()
+        {
+            if (readResult_ == ErrorCode::REDIS_ERR)
             {
                 return ErrorCode::REDIS_ERR;
             }
-            processInputBuffer();
+            ProcessQueryBuffer();
             return ErrorCode::REDIS_OK;
         }
 
+        /// redis function: blockClient
+        /// 命令被转发给其它分片执行，收到回复之前不再执行这个客户端后面的命令，
+        /// 保证 pipeline 的回复顺序
+        void Block()
+        {
+            flag_ |= client_flag::REDIS_BLOCKED;
+        }
+
+        /// redis function: unblockClient
+        /// 收到转发命令的回复后调用：追加回复，继续执行阻塞期间收到的命令
+        void Unblock(std::string_view reply)
+        {
+            flag_ &= ~client_flag::REDIS_BLOCKED;
+            AddReply(reply);
+            ProcessQueryBuffer();
+        }
+
+        /// 伪客户端执行一条从其它分片转发过来的命令，返回编码好的回复。
+        /// 参数数量已经由发起转发的分片检查过
+        std::string ExecuteForwarded(const std::vector<std::string> &args, int64_t db, int32_t resp);
+
+        /// redis function: processInputBuffer
+        /// 解析并执行查询缓冲区里全部完整的命令，最后一条不完整的命令留在缓冲区里，
+        /// 等收到更多数据后继续解析
         void processInputBuffer()
         {
-            std::cout << "queryBuf is " << queryBuf.Data() << std::endl;
-            while (queryBuf.Length())
+            while (true)
             {
                 // client 处于某种状态时，立即结束
                 if (client_flag::REDIS_BLOCKED & flag_ || client_flag::REDIS_IO_WAIT & flag_)
                 {
-                    return;
+                    break;
                 }
                 // 如果是REDIS_CLOSE_AFTER_REPLY状态，说明链接是在向客户端写入应答后关闭，不能继续增加回复
                 if (client_flag::REDIS_CLOSE_AFTER_REPLY & flag_)
                 {
-                    return;
+                    break;
                 }
-                // 如果请求类型是未知的，需要判断是什么类型
-                if (request_type_ == RequestType::INITIAL)
+
+                ParseResult result;
+                if (flag_ & client_flag::REDIS_PENDING_COMMAND)
                 {
-                    if (queryBuf.At(0) == '*')
-                    {
-                        request_type_ = RequestType::REDIS_REQ_MULTI_BULK;
-                    }
-                    else
-                    {
-                        request_type_ = RequestType::REDIS_REQ_INLINE;
-                    }
+                    // ReadQuery 已经解析好的命令
+                    flag_ &= ~client_flag::REDIS_PENDING_COMMAND;
+                    result = parseResult_;
                 }
-
-                assert((request_type_ == RequestType::REDIS_REQ_MULTI_BULK || request_type_ == RequestType::REDIS_REQ_INLINE) && "Unknown request type");
-
-                if (request_type_ == RequestType::REDIS_REQ_INLINE)
+                else
                 {
-                    if (ProcessInlineBuffer() != ErrorCode::REDIS_OK)
-                        break;
+                    result = parser_.Parse(queryBuf, argv);
                 }
-                else if (request_type_ == RequestType::REDIS_REQ_MULTI_BULK)
+                if (result == ParseResult::NeedMore)
                 {
-                    if (ProcessMultiBulkBuffer() != ErrorCode::REDIS_OK)
-                        break;
+                    break;
                 }
-
-                if (argc == 0)
+                if (result == ParseResult::Error)
                 {
-                    ResetClient();
+                    // 协议错误之后的数据无法继续解析，回复错误后关闭连接
+                    AddReplyError("ERR " + parser_.Error());
+                    flag_ |= client_flag::REDIS_CLOSE_AFTER_REPLY;
+                    break;
                 }
-                else
+
+                argc = static_cast<int>(argv.size());
+                if (argc > 0)
                 {
-                    if (ErrorCode::REDIS_OK == ProcessCommand())
-                    {
-                        ResetClient();
-                    }
+                    ProcessCommand();
                 }
+                ResetClient();
             }
+
+            // 删除已经执行完的命令，只在每批命令处理完之后移动一次剩余数据
+            auto consumed = parser_.Consumable();
+            if (consumed == 0)
+            {
+                return;
+            }
+            if (consumed == queryBuf.Length())
+            {
+                queryBuf.Clear();
+            }
+            else
+            {
+                queryBuf.Range(consumed, queryBuf.Length());
+            }
+            parser_.Discard(consumed);
         }
 
-        // 负责解析query中的数据，转化为命令形式存放
-        ErrorCode ProcessInlineBuffer()
+        /// redis function: resetClient
+        /// 一条命令执行完之后清理参数，准备解析下一条命令
+        void ResetClient()
         {
-            auto result = queryBuf.Split(" ");
-            argc = result.size();
-            argv.swap(result);
-            return ErrorCode::REDIS_OK;
+            argc = 0;
+            argv.clear();
+            parser_.Reset();
         }
 
-        ErrorCode ProcessMultiBulkBuffer()
+        /// redis function: processCommand
+        /// 查找命令表，检查参数数量后执行命令
+        ErrorCode ProcessCommand();
+
+        /// 当前命令的参数
+        const std::vector<std::string_view> &Arguments() const
         {
-            return ErrorCode::REDIS_ERR;
+            return argv;
         }
 
-        void ResetClient()
+        /// 设置命令统计表，下标和命令表一致
+        void SetCommandStats(std::shared_ptr<CommandStatsTable> stats)
+        {
+            commandStats_ = std::move(stats);
+        }
+
+        /// 设置服务端的全部数据库，默认选择 0 号数据库。
+        /// lazy_free 用于 FLUSHDB 在后台释放被清空的键空间
+        void SetDatabases(std::shared_ptr<std::vector<base::RedisDB>> dbs,
+                          std::shared_ptr<base::LazyFree> lazy_free)
         {
-            queryBuf.Clean();
+            dbs_ = dbs;
+            lazy_free_ = lazy_free;
+            SelectDB(0);
         }
 
-        ErrorCode ProcessCommand()
+        /// redis function: selectDb
+        /// 切换当前客户端使用的数据库，编号超出范围时返回 false
+        bool SelectDB(int64_t id)
         {
-            if (argc >= 2)
+            if (id < 0 || static_cast<size_t>(id) >= dbs_->size())
             {
-                if ("get" == argv[0])
-                {
-                    client_logger.Info("get key");
-                    auto find_result = dict_->Find(argv[1]);
-                    if (find_result.has_value())
-                    {
-                        // fixme: 没有判断查询到的是否有旧数据
-                        result_.Append(find_result->get().second);
-                        addEvent_(fd_, net::Write, [&](int32_t, int32_t, const std::any &) {
-                            SendReplyToClient();
-                        });
-                    }
-                }
-                else if ("set" == argv[0] && argc == 3)
+                return false;
+            }
+            db_ = &(*dbs_)[id];
+            return true;
+        }
+
+        /// 当前选择的数据库
+        base::RedisDB *GetDB()
+        {
+            return db_;
+        }
+
+        /// 当前连接使用的 RESP 协议版本，通过 HELLO 命令切换
+        int32_t ProtocolVersion() const
+        {
+            return resp_;
+        }
+
+        /// redis function: addReply
+        /// 追加已经编码好的回复内容。
+        /// 同一批 pipeline 命令的回复都追加到 reply_ 里，在下一轮事件循环一次性写出
+        void AddReply(std::string_view reply)
+        {
+            PrepareClientToWrite();
+            reply_.Append(reply);
+        }
+
+        /// redis function: addReplyStatus
+        /// 状态回复 "+OK\r\n"
+        void AddReplyStatus(std::string_view status)
+        {
+            AddReplyLine('+', status);
+        }
+
+        /// redis function: addReplyError
+        /// 错误回复 "-ERR message\r\n"，message 里的换行替换成空格，避免破坏协议
+        void AddReplyError(std::string message)
+        {
+            for (auto &c : message)
+            {
+                if (c == '\r' || c == '\n')
                 {
-                    client_logger.Info("set key");
-                    // std::this_thread::sleep_for(std::chrono::milliseconds(2000));
-                    dict_->Add(argv[1], argv[2]);
-                    result_.Append("ok");
-                    addEvent_(fd_, net::Write, [&](int32_t, int32_t, const std::any &) {
-                            SendReplyToClient();
-                        });
+                    c = ' ';
                 }
-                return ErrorCode::REDIS_OK;
             }
-            return ErrorCode::REDIS_ERR;
+            AddReplyLine('-', message);
+        }
+
+        /// redis function: addReplyBulk
+        /// 字符串回复 "$len\r\ncontent\r\n"
+        void AddReplyBulk(std::string_view bulk)
+        {
+            AddReplyLength('$', static_cast<int64_t>(bulk.size()));
+            reply_.Append(bulk);
+            reply_.Append("\r\n");
+        }
+
+        /// redis function: addReplyBulk
+        /// 回复一个字符串值。大的值不复制到输出缓冲区，只保存对值的引用，
+        /// 发送时直接从值的内存写出
+        void AddReplyBulk(const base::RedisObject &object)
+        {
+            auto reference = object.StringLength() >= PROTO_REPLY_REFERENCE_MIN_BYTES
+                                 ? object.ShareString()
+                                 : base::SharedStringRef();
+            if (!reference)
+            {
+                base::RedisObject::IntegerBuffer buffer;
+                AddReplyBulk(object.StringView(buffer));
+                return;
+            }
+            AddReplyLength('$', static_cast<int64_t>(reference.View().size()));
+            reply_.AppendReference(std::move(reference));
+            reply_.Append("\r\n");
         }
 
-        void SetDict(std::shared_ptr<base::Dictionary<std::string, std::string>> dict)
+        /// redis function: addReplyLongLong
+        /// 整数回复 ":n\r\n"
+        void AddReplyLongLong(int64_t value)
         {
-            dict_ = dict;
+            AddReplyLength(':', value);
         }
 
+        /// redis function: addReplyNull
+        /// 空回复，RESP2 是 "$-1\r\n"，RESP3 是 "_\r\n"
+        void AddReplyNull()
+        {
+            AddReply(resp_ >= 3 ? "_\r\n" : "$-1\r\n");
+        }
+
+        /// redis function: addReplyMapLen
+        /// 字典回复的头部，RESP2 没有字典类型，用两倍长度的数组代替
+        void AddReplyMapLength(int64_t length)
+        {
+            if (resp_ >= 3)
+            {
+                AddReplyLength('%', length);
+            }
+            else
+            {
+                AddReplyLength('*', length * 2);
+            }
+        }
+
+        /// redis function: addReplyArrayLen
+        void AddReplyArrayLength(int64_t length)
+        {
+            AddReplyLength('*', length);
+        }
+
+        /// redis function: sendReplyToClient
+        /// 写事件的处理函数，只在 BeforeSleep 没能一次写完时注册。
+        /// 每轮事件循环最多给这个客户端写 NET_MAX_WRITES_PER_EVENT 字节，
+        /// 没有写完的部分保留在 reply_ 里，写事件保持注册，下一轮继续写
         void SendReplyToClient()
         {
-            // fixme: 需要一次性响应，多次响应需要改成while形式，循环写完后需要删除写事件
-            if (result_.Length() > 0)
+            WriteToClient();
+            if (!reply_.Empty())
             {
-                client_logger.Info("Write data to client");
-                auto writeLength = write(fd_, result_.Data(), result_.Length());
-                // 失败与否都清空
-                result_.Clean();
-                if (writeLength <= 0)
-                {
-                    client_logger.Debug("write to client: %s", strerror(errno));
-                    return;
-                }
-                
+                return;
+            }
+            // 使用Keepalive，响应之后不用关闭链接。在读事件发生后，再处理socket的关闭
+            writeHandlerInstalled_ = false;
+            deleteEvent_(fd_, net::Event::Write);
+            CloseIfReplied();
+        }
+
+        /// redis function: handleClientsWithPendingWrites
+        /// 由服务端在 BeforeSleep 里调用，直接写 socket，不经过 poller。
+        /// 大部分回复一次就能写完，这样每个请求省掉注册和删除写事件的两次 epoll_ctl。
+        /// socket 缓冲区满了写不完时才注册写事件，由 SendReplyToClient 继续写
+        void HandlePendingWrite()
+        {
+            if (!BeginPendingWrite())
+            {
+                return;
+            }
+            WriteToClient();
+            FinishPendingWrite();
+        }
+
+        /// 从等待写出的列表里取出时调用，返回是否需要在这一轮写
+        bool BeginPendingWrite()
+        {
+            flag_ &= ~client_flag::REDIS_PENDING_WRITE;
+            // 写事件已经注册时由写事件负责，避免同一轮写两次
+            return !writeHandlerInstalled_;
+        }
+
+        /// 这一轮没有写完时注册写事件
+        void FinishPendingWrite()
+        {
+            if (reply_.Empty())
+            {
+                CloseIfReplied();
+                return;
+            }
+            if (writeHandlerInstalled_)
+            {
+                return;
+            }
+            writeHandlerInstalled_ = true;
+            addEvent_(fd_, net::Write, [this](int32_t, int32_t, const std::any &) {
+                SendReplyToClient();
+            });
+        }
+
+        /// redis function: writeToClient
+        /// 写出缓冲区里的回复，出错时丢弃剩余的回复。
+        /// 开启 IO 线程时由 IO 线程调用，只能访问这个客户端自己的状态
+        void WriteToClient()
+        {
+            // 边缘触发时写事件只在 socket 重新变成可写时通知一次，写事件的处理函数必须写到 EAGAIN
+            auto max_bytes = edgeTriggered_ && writeHandlerInstalled_ ? SIZE_MAX : NET_MAX_WRITES_PER_EVENT;
+            if (reply_.ZeroCopyPending())
+            {
+                reply_.ReapZeroCopy(fd_);
             }
-            if (result_.Length() == 0)
+            if (reply_.WriteTo(fd_, max_bytes) == -1)
             {
-                deleteEvent_(fd_, net::Event::Write);
-                // 使用Keepalive，响应之后不用关闭链接。在读事件发生后，再处理socket的关闭
+                client_logger.Debug("write to client: %s", strerror(errno));
+                reply_.Clear();
             }
         }
 
+        /// 是否已经被加入等待读取的列表
+        bool IsPendingRead() const
+        {
+            return flag_ & client_flag::REDIS_PENDING_READ;
+        }
+
+        /// 设置是否在等待读取的列表里
+        void SetPendingRead(bool pending)
+        {
+            if (pending)
+            {
+                flag_ |= client_flag::REDIS_PENDING_READ;
+            }
+            else
+            {
+                flag_ &= ~client_flag::REDIS_PENDING_READ;
+            }
+        }
+
+        /// 还没有发送给客户端的回复的字节数
+        size_t PendingReplyBytes() const
+        {
+            return reply_.PendingBytes();
+        }
+
         void Free()
         {
             deleteEvent_(fd_, net::Event::Read);
             deleteEvent_(fd_, net::Event::Write);
+            writeHandlerInstalled_ = false;
+        }
+
+        /// redis function: freeClient
+        /// 删除事件并关闭 socket，由服务端在 BeforeSleep 里调用
+        void Close()
+        {
+            Free();
+            close(fd_);
+        }
+
+        /// 删除事件并关闭连接的两个方向，但不关闭 socket。
+        /// 零拷贝发送的完成通知只能从 socket 的错误队列读取，收到通知之前引用的值不能释放，
+        /// 由服务端在通知全部收到之后关闭 socket
+        void Shutdown()
+        {
+            Free();
+            shutdown(fd_, SHUT_RDWR);
+        }
+
+        /// 读取零拷贝完成通知，返回是否还有零拷贝发送没有完成
+        bool ReapZeroCopy()
+        {
+            if (reply_.ZeroCopyPending())
+            {
+                reply_.ReapZeroCopy(fd_);
+            }
+            return reply_.ZeroCopyPending();
+        }
+
+        /// 设置回复写完、需要关闭连接时通知服务端的函数，服务端把客户端加入等待关闭的列表
+        void SetCloseFunction(std::function<void()> close_fun)
+        {
+            closeAsync_ = std::move(close_fun);
+        }
+
+        /// 设置有回复等待写出时通知服务端的函数，服务端把客户端加入等待写出的列表
+        void SetPendingWriteFunction(std::function<void()> pending_write_fun)
+        {
+            pendingWrite_ = std::move(pending_write_fun);
+        }
+
+        /// 事件循环是否使用边缘触发，边缘触发时读写都要进行到 EAGAIN
+        void SetEdgeTriggered(bool edge_triggered)
+        {
+            edgeTriggered_ = edge_triggered;
+        }
+
+        /// 设置使用 MSG_ZEROCOPY 发送的回复的最小长度，0 表示不使用。
+        /// 只能在 socket 成功设置 SO_ZEROCOPY 之后调用
+        void SetZeroCopyThreshold(size_t threshold)
+        {
+            reply_.SetZeroCopyThreshold(threshold);
+        }
+
+        /// 设置多 reactor 模式下的转发函数，命令已经被转发给其它分片时返回 true
+        void SetForwardFunction(std::function<bool(const RedisCommand &)> forward_fun)
+        {
+            forwardCommand_ = std::move(forward_fun);
         }
 
         void SetOperateEventFunction(std::function<void(int32_t, net::Event, EventHandler)> add_fun, std::function<void(int32_t, net::Event)> del_fun)
@@ -234,17 +614,686 @@ namespace tr
         }
 
     private:
-        int fd_;
-        // base::RedisDB *db_;
-        std::shared_ptr<base::Dictionary<std::string, std::string>> dict_;
+        /// redis function: prepareClientToWrite
+        /// 输出缓冲区从空变成非空时注册写事件，之后追加的回复复用同一个写事件，
+        /// 不会每条回复都修改一次 poller
+        void PrepareClientToWrite()
+        {
+            // 伪客户端没有 socket，回复只保存在缓冲区里
+            if (fd_ == -1)
+            {
+                return;
+            }
+            if (writeHandlerInstalled_ || (flag_ & client_flag::REDIS_PENDING_WRITE))
+            {
+                return;
+            }
+            // 先不注册写事件，等到 BeforeSleep 时直接写
+            flag_ |= client_flag::REDIS_PENDING_WRITE;
+            pendingWrite_();
+        }
+
+        /// 追加 "<prefix>content\r\n"
+        void AddReplyLine(char prefix, std::string_view content)
+        {
+            AddReply(std::string_view(&prefix, 1));
+            reply_.Append(content);
+            reply_.Append("\r\n");
+        }
+
+        /// 追加 "<prefix><整数>\r\n"，用于各种长度头部和整数回复
+        void AddReplyLength(char prefix, int64_t length)
+        {
+            char buffer[32];
+            buffer[0] = prefix;
+            auto [end, ec] = std::to_chars(buffer + 1, buffer + sizeof(buffer) - 2, length);
+            assert(ec == std::errc{});
+            *end++ = '\r';
+            *end++ = '\n';
+            AddReply(std::string_view(buffer, end - buffer));
+        }
+
+        /// 执行查询缓冲区里的命令。协议错误，或者对端已经关闭写端并且命令都执行完时，
+        /// 不再读取新的数据，等回复全部写出之后关闭连接
+        void ProcessQueryBuffer()
+        {
+            processInputBuffer();
+            if (closeAfterInput_ && !(flag_ & client_flag::REDIS_BLOCKED))
+            {
+                flag_ |= client_flag::REDIS_CLOSE_AFTER_REPLY;
+            }
+            if (!readingStopped_ && (closeAfterInput_ || (flag_ & client_flag::REDIS_CLOSE_AFTER_REPLY)))
+            {
+                // 对端关闭后读事件会一直触发，阻塞等待转发的回复期间也不能再读
+                readingStopped_ = true;
+                deleteEvent_(fd_, net::Event::Read);
+            }
+            CloseIfReplied();
+        }
+
+        /// redis function: freeClientAsync
+        /// 设置了 REDIS_CLOSE_AFTER_REPLY 的连接在回复全部写出之后交给服务端关闭。
+        /// 写事件的处理函数里不能直接释放客户端，由服务端在 BeforeSleep 里统一关闭
+        void CloseIfReplied()
+        {
+            constexpr int flags = client_flag::REDIS_CLOSE_AFTER_REPLY | client_flag::REDIS_BLOCKED |
+                                  client_flag::REDIS_CLOSE_ASAP;
+            if ((flag_ & flags) != client_flag::REDIS_CLOSE_AFTER_REPLY || !reply_.Empty())
+            {
+                return;
+            }
+            flag_ |= client_flag::REDIS_CLOSE_ASAP;
+            closeAsync_();
+        }
+
+        /// redis function: call
+        /// 执行命令并记录执行次数和耗时。事件循环是单线程的，统计不需要加锁
+        void Call(const RedisCommand &command, size_t index)
+        {
+            auto start = base::MonotonicNanoseconds();
+            (this->*command.proc)();
+            auto duration = base::MonotonicNanoseconds() - start;
+            if (commandStats_ != nullptr)
+            {
+                (*commandStats_)[index].Record(static_cast<uint64_t>(duration));
+            }
+        }
+
+        /// PING [message]
+        void PingCommand()
+        {
+            if (argc > 2)
+            {
+                AddReplyError("ERR wrong number of arguments for 'ping' command");
+                return;
+            }
+            if (argc == 1)
+            {
+                AddReplyStatus("PONG");
+                return;
+            }
+            AddReplyBulk(argv[1]);
+        }
+
+        /// HELLO [protover]
+        /// 切换 RESP 协议版本，回复服务端信息
+        void HelloCommand()
+        {
+            if (argc > 2)
+            {
+                AddReplyError("ERR syntax error");
+                return;
+            }
+            if (argc == 2)
+            {
+                int64_t version;
+                if (!base::StringToInteger(argv[1], version))
+                {
+                    AddReplyError("ERR Protocol version is not an integer or out of range");
+                    return;
+                }
+                if (version != 2 && version != 3)
+                {
+                    AddReplyError("NOPROTO unsupported protocol version");
+                    return;
+                }
+                resp_ = static_cast<int32_t>(version);
+            }
+
+            AddReplyMapLength(5);
+            AddReplyBulk("server");
+            AddReplyBulk("toy-redis");
+            AddReplyBulk("version");
+            AddReplyBulk("0.1.0");
+            AddReplyBulk("proto");
+            AddReplyLongLong(resp_);
+            AddReplyBulk("mode");
+            AddReplyBulk("standalone");
+            AddReplyBulk("role");
+            AddReplyBulk("master");
+        }
+
+        void GetCommand()
+        {
+            client_logger.Info("get key");
+            auto find_result = db_->LookupKey(argv[1]);
+            if (!find_result.has_value())
+            {
+                AddReplyNull();
+                return;
+            }
+            auto &object = find_result->get();
+            if (!object.IsString())
+            {
+                AddReplyError("WRONGTYPE Operation against a key holding the wrong kind of value");
+                return;
+            }
+            AddReplyBulk(object);
+        }
+
+        /// SET key value [EX seconds|PX milliseconds]
+        void SetCommand()
+        {
+            client_logger.Info("set key");
+            int64_t expire_at = -1;
+            if (argc != 3 && argc != 5)
+            {
+                AddReplyError("ERR syntax error");
+                return;
+            }
+            if (argc == 5)
+            {
+                int64_t unit = 0;
+                if (EqualsIgnoreCase(argv[3], "ex"))
+                {
+                    unit = 1000;
+                }
+                else if (EqualsIgnoreCase(argv[3], "px"))
+                {
+                    unit = 1;
+                }
+                else
+                {
+                    AddReplyError("ERR syntax error");
+                    return;
+                }
+                int64_t expire;
+                if (!ParseExpireTime(argv[4], unit, expire) || expire <= 0)
+                {
+                    AddReplyError("ERR invalid expire time in set");
+                    return;
+                }
+                expire_at = base::NowMilliseconds() + expire;
+            }
+
+            db_->SetKey(argv[1], base::RedisObject::CreateString(argv[2]));
+            if (expire_at != -1)
+            {
+                db_->SetExpire(argv[1], expire_at);
+            }
+            AddReplyStatus("OK");
+        }
+
+        /// 把以 unit 毫秒为单位的时间解析成毫秒数，格式错误或者溢出时返回 false
+        static bool ParseExpireTime(std::string_view arg, int64_t unit, int64_t &milliseconds)
+        {
+            int64_t value;
+            if (!base::StringToInteger(arg, value) ||
+                __builtin_mul_overflow(value, unit, &milliseconds))
+            {
+                return false;
+            }
+            // 加上当前时间后也不能溢出
+            int64_t expire_at;
+            return !__builtin_add_overflow(milliseconds, base::NowMilliseconds(), &expire_at);
+        }
+
+        /// redis function: expireGenericCommand
+        /// EXPIRE key seconds, PEXPIRE key milliseconds
+        /// 设置成功回复 1，key 不存在回复 0。过期时间不是正数时直接删除 key
+        void ExpireGenericCommand(int64_t unit)
+        {
+            int64_t expire;
+            if (!ParseExpireTime(argv[2], unit, expire))
+            {
+                AddReplyError("ERR value is not an integer or out of range");
+                return;
+            }
+            if (!db_->LookupKey(argv[1]).has_value())
+            {
+                AddReplyLongLong(0);
+                return;
+            }
+            if (expire <= 0)
+            {
+                db_->Delete(argv[1]);
+                AddReplyLongLong(1);
+                return;
+            }
+            db_->SetExpire(argv[1], base::NowMilliseconds() + expire);
+            AddReplyLongLong(1);
+        }
+
+        /// redis function: ttlGenericCommand
+        /// TTL key, PTTL key
+        /// key 不存在回复 -2，没有设置过期时间回复 -1
+        void TTLGenericCommand(int64_t unit)
+        {
+            if (!db_->LookupKey(argv[1]).has_value())
+            {
+                AddReplyLongLong(-2);
+                return;
+            }
+            auto expire_at = db_->GetExpire(argv[1]);
+            if (expire_at == -1)
+            {
+                AddReplyLongLong(-1);
+                return;
+            }
+            auto ttl = std::max<int64_t>(expire_at - base::NowMilliseconds(), 0);
+            AddReplyLongLong((ttl + unit / 2) / unit);
+        }
+
+        void ExpireCommand()
+        {
+            ExpireGenericCommand(1000);
+        }
+
+        void PExpireCommand()
+        {
+            ExpireGenericCommand(1);
+        }
+
+        void TTLCommand()
+        {
+            TTLGenericCommand(1000);
+        }
+
+        void PTTLCommand()
+        {
+            TTLGenericCommand(1);
+        }
+
+        /// PERSIST key
+        /// 清除过期时间成功回复 1，key 不存在或者没有过期时间回复 0
+        void PersistCommand()
+        {
+            if (db_->LookupKey(argv[1]).has_value() && db_->RemoveExpire(argv[1]))
+            {
+                AddReplyLongLong(1);
+                return;
+            }
+            AddReplyLongLong(0);
+        }
+
+        /// 解析数据库编号，失败时回复错误并返回 -1
+        int64_t ParseDBIndex(std::string_view arg)
+        {
+            int64_t id;
+            if (!base::StringToInteger(arg, id))
+            {
+                AddReplyError("ERR invalid DB index");
+                return -1;
+            }
+            if (id < 0 || static_cast<size_t>(id) >= dbs_->size())
+            {
+                AddReplyError("ERR DB index is out of range");
+                return -1;
+            }
+            return id;
+        }
+
+        /// SELECT index
+        void SelectCommand()
+        {
+            auto id = ParseDBIndex(argv[1]);
+            if (id == -1)
+            {
+                return;
+            }
+            SelectDB(id);
+            AddReplyStatus("OK");
+        }
+
+        /// MOVE key db
+        /// 把 key 移动到另一个数据库，目标数据库已经存在该 key 或者 key 不存在时回复 0
+        void MoveCommand()
+        {
+            auto id = ParseDBIndex(argv[2]);
+            if (id == -1)
+            {
+                return;
+            }
+            auto &target = (*dbs_)[id];
+            if (&target == db_)
+            {
+                AddReplyError("ERR source and destination objects are the same");
+                return;
+            }
+
+            auto find_result = db_->LookupKey(argv[1]);
+            if (!find_result.has_value() || target.LookupKey(argv[1]).has_value())
+            {
+                AddReplyLongLong(0);
+                return;
+            }
+            // 值对象直接移动到目标数据库，不复制内容，过期时间一起移动
+            auto expire_at = db_->GetExpire(argv[1]);
+            target.Add(argv[1], std::move(find_result->get()));
+            if (expire_at != -1)
+            {
+                target.SetExpire(argv[1], expire_at);
+            }
+            db_->Delete(argv[1]);
+            AddReplyLongLong(1);
+        }
+
+        /// SWAPDB index1 index2
+        void SwapDBCommand()
+        {
+            auto first = ParseDBIndex(argv[1]);
+            if (first == -1)
+            {
+                return;
+            }
+            auto second = ParseDBIndex(argv[2]);
+            if (second == -1)
+            {
+                return;
+            }
+            if (first != second)
+            {
+                (*dbs_)[first].SwapKeySpace((*dbs_)[second]);
+            }
+            AddReplyStatus("OK");
+        }
+
+        /// FLUSHDB [ASYNC|SYNC]
+        /// 默认在后台线程释放被清空的键空间，SYNC 时在当前线程释放
+        void FlushDBCommand()
+        {
+            auto async = true;
+            if (argc > 2)
+            {
+                AddReplyError("ERR syntax error");
+                return;
+            }
+            if (argc == 2)
+            {
+                if (EqualsIgnoreCase(argv[1], "sync"))
+                {
+                    async = false;
+                }
+                else if (!EqualsIgnoreCase(argv[1], "async"))
+                {
+                    AddReplyError("ERR syntax error");
+                    return;
+                }
+            }
+            db_->Empty(async ? lazy_free_.get() : nullptr);
+            AddReplyStatus("OK");
+        }
+
+        /// redis function: infoCommand
+        /// INFO [section ...]
+        /// 支持 server、keyspace、commandstats、latencystats 四个部分，
+        /// 不指定时返回 server 和 keyspace，all 返回全部
+        void InfoCommand();
+
+        /// INFO 的各个部分之间空一行
+        static void AppendInfoSeparator(std::string &info)
+        {
+            if (!info.empty())
+            {
+                info += "\r\n";
+            }
+        }
+
+        /// redis function: latencyCommand
+        /// LATENCY HISTOGRAM [command ...]
+        /// 回复各个命令的执行次数和耗时分布。分布按 2 的幂微秒分段，
+        /// 每一项是 "上界（微秒）: 耗时不超过该上界的累计次数"
+        void LatencyCommand();
+
+    private:
+        /// 伪客户端的 fd 是 -1
+        int fd_{-1};
+        std::shared_ptr<std::vector<base::RedisDB>> dbs_;
+        std::shared_ptr<base::LazyFree> lazy_free_;
+        /// 当前选择的数据库，指向 dbs_ 里的元素
+        base::RedisDB *db_ = nullptr;
         base::SimpleDynamicString queryBuf{};
         base::Log client_logger;
         int flag_{client_flag::INITIAL};
-        int request_type_{0};
+        /// RESP 协议版本
+        int32_t resp_{2};
+        RequestParser parser_;
+        /// ReadQuery 的结果，由事件循环线程在 ProcessReadResult 里处理
+        ErrorCode readResult_{ErrorCode::REDIS_OK};
+        /// ReadQuery 提前解析的命令的结果，flag_ 带有 REDIS_PENDING_COMMAND 时有效
+        ParseResult parseResult_{ParseResult::NeedMore};
         int argc{0};
-        std::vector<std::string> argv;
-        base::SimpleDynamicString result_{nullptr};
+        /// 当前命令的参数，指向 queryBuf 内部，命令执行完之前 queryBuf 不会被修改
+        std::vector<std::string_view> argv;
+        /// 输出缓冲区，保存还没有写给客户端的回复
+        ReplyBuffer reply_;
+        /// 是否已经注册了写事件
+        bool writeHandlerInstalled_{false};
+        /// 事件循环是否使用边缘触发
+        bool edgeTriggered_{false};
+        /// 读取时对端已经关闭，执行完收到的命令、写完回复之后关闭连接
+        bool closeAfterInput_{false};
+        /// 是否已经删除了读事件
+        bool readingStopped_{false};
+        std::function<void()> pendingWrite_;
+        std::function<void()> closeAsync_;
         std::function<void(int32_t, net::Event)> deleteEvent_;
         std::function<void(int32_t, net::Event, EventHandler)> addEvent_;
+        /// 服务端共享的命令统计
+        std::shared_ptr<CommandStatsTable> commandStats_;
+        /// 多 reactor 模式下把命令转发给 key 所在的分片
+        std::function<bool(const RedisCommand &)> forwardCommand_;
     };
+
+    /// redis: redisCommandTable
+    /// 全部命令，arity 包括命令名，负数表示参数数量至少是 -arity
+    constexpr auto MakeCommandTable()
+    {
+        using namespace command_flag;
+        using C = RedisClient;
+        return CommandTable{std::array{
+            RedisCommand{{"get", 2, READONLY | FAST, 1}, &C::GetCommand},
+            RedisCommand{{"set", -3, WRITE | DENYOOM, 1}, &C::SetCommand},
+            RedisCommand{{"expire", 3, WRITE | FAST, 1}, &C::ExpireCommand},
+            RedisCommand{{"pexpire", 3, WRITE | FAST, 1}, &C::PExpireCommand},
+            RedisCommand{{"ttl", 2, READONLY | FAST, 1}, &C::TTLCommand},
+            RedisCommand{{"pttl", 2, READONLY | FAST, 1}, &C::PTTLCommand},
+            RedisCommand{{"persist", 2, WRITE | FAST, 1}, &C::PersistCommand},
+            RedisCommand{{"select", 2, FAST}, &C::SelectCommand},
+            RedisCommand{{"move", 3, WRITE | FAST, 1}, &C::MoveCommand},
+            RedisCommand{{"swapdb", 3, WRITE | FAST | ALL_SHARDS}, &C::SwapDBCommand},
+            RedisCommand{{"flushdb", -1, WRITE | ALL_SHARDS}, &C::FlushDBCommand},
+            RedisCommand{{"ping", -1, FAST}, &C::PingCommand},
+            RedisCommand{{"hello", -1, FAST}, &C::HelloCommand},
+            RedisCommand{{"info", -1, 0}, &C::InfoCommand},
+            RedisCommand{{"latency", -2, ADMIN}, &C::LatencyCommand},
+        }};
+    }
+
+    /// 命令表在编译期生成
+    inline constexpr auto COMMAND_TABLE = MakeCommandTable();
+
+    inline ErrorCode RedisClient::ProcessCommand()
+    {
+        auto name = argv[0];
+        auto index = COMMAND_TABLE.IndexOf(name);
+        if (index == COMMAND_TABLE.Size())
+        {
+            AddReplyError("ERR unknown command '" + std::string(name) + "'");
+            return ErrorCode::REDIS_OK;
+        }
+        auto &command = COMMAND_TABLE[index];
+        if (!command.CheckArity(argc))
+        {
+            if (commandStats_ != nullptr)
+            {
+                (*commandStats_)[index].rejectedCalls++;
+            }
+            AddReplyError("ERR wrong number of arguments for '" + std::string(command.name) + "' command");
+            return ErrorCode::REDIS_OK;
+        }
+        if (forwardCommand_ &&
+            (command.firstKey > 0 || command.HasFlag(command_flag::ALL_SHARDS)) &&
+            forwardCommand_(command))
+        {
+            return ErrorCode::REDIS_OK;
+        }
+        Call(command, index);
+        return ErrorCode::REDIS_OK;
+    }
+
+    inline std::string RedisClient::ExecuteForwarded(const std::vector<std::string> &args, int64_t db, int32_t resp)
+    {
+        argv.assign(args.begin(), args.end());
+        argc = static_cast<int>(argv.size());
+        SelectDB(db);
+        resp_ = resp;
+        auto index = COMMAND_TABLE.IndexOf(argv[0]);
+        assert(index != COMMAND_TABLE.Size());
+        Call(COMMAND_TABLE[index], index);
+        ResetClient();
+        return reply_.Take();
+    }
+
+    inline void RedisClient::InfoCommand()
+    {
+        bool server = argc == 1, keyspace = argc == 1;
+        bool commandstats = false, latencystats = false;
+        for (int i = 1; i < argc; i++)
+        {
+            auto section = argv[i];
+            auto all = EqualsIgnoreCase(section, "all") || EqualsIgnoreCase(section, "everything");
+            auto is_default = EqualsIgnoreCase(section, "default");
+            server |= all || is_default || EqualsIgnoreCase(section, "server");
+            keyspace |= all || is_default || EqualsIgnoreCase(section, "keyspace");
+            commandstats |= all || EqualsIgnoreCase(section, "commandstats");
+            latencystats |= all || EqualsIgnoreCase(section, "latencystats");
+        }
+
+        std::string info;
+        char line[256];
+        if (server)
+        {
+            info += "# Server\r\nredis_version:0.1.0\r\n";
+            snprintf(line, sizeof(line), "process_id:%d\r\n", getpid());
+            info += line;
+        }
+        if (keyspace)
+        {
+            AppendInfoSeparator(info);
+            info += "# Keyspace\r\n";
+            for (auto &db : *dbs_)
+            {
+                if (db.Size() == 0)
+                {
+                    continue;
+                }
+                snprintf(line, sizeof(line), "db%d:keys=%zu,expires=%zu\r\n",
+                         db.Id(), db.Size(), db.ExpiresSize());
+                info += line;
+            }
+        }
+        if (commandstats && commandStats_ != nullptr)
+        {
+            AppendInfoSeparator(info);
+            info += "# Commandstats\r\n";
+            for (auto &command : COMMAND_TABLE)
+            {
+                auto &stats = (*commandStats_)[COMMAND_TABLE.IndexOf(command)];
+                if (stats.calls == 0 && stats.rejectedCalls == 0)
+                {
+                    continue;
+                }
+                auto usec = stats.nanoseconds / 1000;
+                auto usec_per_call = stats.calls == 0 ? 0.0 : static_cast<double>(stats.nanoseconds) / 1000.0 / static_cast<double>(stats.calls);
+                snprintf(line, sizeof(line), "cmdstat_%.*s:calls=%lu,usec=%lu,usec_per_call=%.2f,rejected_calls=%lu\r\n",
+                         static_cast<int>(command.name.size()), command.name.data(),
+                         stats.calls, usec, usec_per_call, stats.rejectedCalls);
+                info += line;
+            }
+        }
+        if (latencystats && commandStats_ != nullptr)
+        {
+            AppendInfoSeparator(info);
+            info += "# Latencystats\r\n";
+            for (auto &command : COMMAND_TABLE)
+            {
+                auto &histogram = (*commandStats_)[COMMAND_TABLE.IndexOf(command)].histogram;
+                if (histogram.Count() == 0)
+                {
+                    continue;
+                }
+                snprintf(line, sizeof(line), "latency_percentiles_usec_%.*s:p50=%.3f,p99=%.3f,p99.9=%.3f\r\n",
+                         static_cast<int>(command.name.size()), command.name.data(),
+                         histogram.ValueAtPercentile(50) / 1000.0,
+                         histogram.ValueAtPercentile(99) / 1000.0,
+                         histogram.ValueAtPercentile(99.9) / 1000.0);
+                info += line;
+            }
+        }
+        AddReplyBulk(info);
+    }
+
+    inline void RedisClient::LatencyCommand()
+    {
+        if (!EqualsIgnoreCase(argv[1], "histogram"))
+        {
+            AddReplyError("ERR unknown subcommand '" + std::string(argv[1]) + "'. Try LATENCY HISTOGRAM.");
+            return;
+        }
+
+        std::vector<size_t> commands;
+        if (argc == 2)
+        {
+            for (size_t i = 0; i < COMMAND_TABLE.Size(); i++)
+            {
+                commands.push_back(i);
+            }
+        }
+        else
+        {
+            for (int i = 2; i < argc; i++)
+            {
+                auto index = COMMAND_TABLE.IndexOf(argv[i]);
+                if (index != COMMAND_TABLE.Size() &&
+                    std::find(commands.begin(), commands.end(), index) == commands.end())
+                {
+                    commands.push_back(index);
+                }
+            }
+        }
+        if (commandStats_ != nullptr)
+        {
+            std::erase_if(commands, [this](size_t index) {
+                return (*commandStats_)[index].calls == 0;
+            });
+        }
+        else
+        {
+            commands.clear();
+        }
+
+        AddReplyMapLength(static_cast<int64_t>(commands.size()));
+        for (auto index : commands)
+        {
+            auto &stats = (*commandStats_)[index];
+            AddReplyBulk(COMMAND_TABLE[index].name);
+            AddReplyMapLength(2);
+            AddReplyBulk("calls");
+            AddReplyLongLong(static_cast<int64_t>(stats.calls));
+            AddReplyBulk("histogram_usec");
+
+            // 把纳秒的桶合并到 2 的幂微秒的区间里
+            std::vector<std::pair<uint64_t, uint64_t>> ranges;
+            uint64_t cumulative = 0;
+            stats.histogram.ForEachBucket([&](uint64_t upper, uint64_t count) {
+                auto usec = std::bit_ceil(std::max<uint64_t>((upper + 999) / 1000, 1));
+                cumulative += count;
+                if (!ranges.empty() && ranges.back().first == usec)
+                {
+                    ranges.back().second = cumulative;
+                }
+                else
+                {
+                    ranges.emplace_back(usec, cumulative);
+                }
+            });
+            AddReplyMapLength(static_cast<int64_t>(ranges.size()));
+            for (auto [usec, count] : ranges)
+            {
+                AddReplyLongLong(static_cast<int64_t>(usec));
+                AddReplyLongLong(static_cast<int64_t>(count));
+            }
+        }
+    }
 } // namespace tr
\ No newline at end of file
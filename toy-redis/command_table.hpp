@@ -0,0 +1,280 @@
+#pragma once
+
+#include "base/latency_histogram.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace tr
+{
+    /// redis macro: CMD_WRITE, CMD_READONLY, CMD_FAST, CMD_DENYOOM ...
+    /// 命令的属性
+    namespace command_flag
+    {
+        /// 会修改数据
+        static constexpr int32_t WRITE = 1 << 0;
+        /// 只读取数据
+        static constexpr int32_t READONLY = 1 << 1;
+        /// 内存超过上限时拒绝执行
+        static constexpr int32_t DENYOOM = 1 << 2;
+        /// 管理命令
+        static constexpr int32_t ADMIN = 1 << 3;
+        /// 时间复杂度是 O(1) 或 O(log(N))，不会阻塞服务端
+        static constexpr int32_t FAST = 1 << 4;
+        /// 没有 key 但是作用于整个键空间，多 reactor 模式下需要在全部分片上执行
+        static constexpr int32_t ALL_SHARDS = 1 << 5;
+    } // namespace command_flag
+
+    /// redis struct: redisCommand 里的统计字段
+    /// 单个命令的执行统计
+    struct CommandStats
+    {
+        /// 执行次数
+        uint64_t calls = 0;
+        /// 累计执行时间，单位纳秒
+        uint64_t nanoseconds = 0;
+        /// 参数数量错误等原因被拒绝执行的次数
+        uint64_t rejectedCalls = 0;
+        /// 每次执行耗时的分布，单位纳秒
+        base::LatencyHistogram histogram;
+
+        /// 记录一次执行
+        void Record(uint64_t duration)
+        {
+            calls++;
+            nanoseconds += duration;
+            histogram.Record(duration);
+        }
+    };
+
+    /// 以命令表下标为索引的统计表
+    using CommandStatsTable = std::vector<CommandStats>;
+
+    /// 命令表条目的公共部分：命令名、参数数量、属性和 key 的位置。
+    /// arity 包括命令名本身，正数表示参数数量必须相等，负数表示参数数量至少是 -arity
+    struct CommandInfo
+    {
+        std::string_view name;
+        int32_t arity = 0;
+        int32_t flags = 0;
+        /// redis: redisCommand.firstkey
+        /// 第一个 key 在参数里的下标，0 表示命令没有 key
+        int32_t firstKey = 0;
+
+        /// 参数数量是否合法
+        constexpr bool CheckArity(size_t argc) const
+        {
+            if (arity >= 0)
+            {
+                return argc == static_cast<size_t>(arity);
+            }
+            return argc >= static_cast<size_t>(-arity);
+        }
+
+        constexpr bool HasFlag(int32_t flag) const
+        {
+            return (flags & flag) != 0;
+        }
+    };
+
+    /// ASCII 转小写，命令名不区分大小写
+    constexpr char ToLowerAscii(char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    /// 不区分大小写比较
+    constexpr bool EqualsIgnoreCase(std::string_view a, std::string_view b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (ToLowerAscii(a[i]) != ToLowerAscii(b[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// 不区分大小写的 FNV-1a 哈希，seed 用于完美哈希的第二级
+    constexpr uint64_t CommandNameHash(std::string_view name, uint64_t seed)
+    {
+        uint64_t hash = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+        for (auto c : name)
+        {
+            hash ^= static_cast<uint8_t>(ToLowerAscii(c));
+            hash *= 1099511628211ULL;
+        }
+        return hash ^ (hash >> 29);
+    }
+
+    /// @brief 编译期生成的命令表
+    /// 用 hash-and-displace 算法在编译期为全部命令名生成完美哈希：
+    /// 命令名先按第一级哈希分到若干个桶里，从大到小依次给每个桶找一个位移值 d，
+    /// 使桶里的命令名按 CommandNameHash(name, d) 落到互不冲突的槽位。
+    /// 查找一个命令名只需要计算两次哈希、比较一次字符串，耗时和命令数量无关。
+    /// Command 需要能转换成 CommandInfo，表在编译期构造，命令名重复会导致编译失败
+    template <typename Command, size_t N>
+    class CommandTable
+    {
+        /// 槽位数量，负载因子不超过 0.5
+        static constexpr size_t SLOTS = std::bit_ceil(N * 2);
+        /// 第一级桶的数量，平均每个桶 4 个命令名
+        static constexpr size_t BUCKETS = std::bit_ceil(N / 4 + 1);
+        static constexpr uint16_t EMPTY = UINT16_MAX;
+
+        static_assert(N > 0 && N < EMPTY, "命令数量超出范围");
+
+    public:
+        constexpr explicit CommandTable(const std::array<Command, N> &commands)
+            : commands_(commands)
+        {
+            slots_.fill(EMPTY);
+            displacements_.fill(0);
+
+            std::array<size_t, BUCKETS> bucket_size{};
+            std::array<size_t, BUCKETS> order{};
+            for (size_t i = 0; i < N; i++)
+            {
+                bucket_size[Bucket(Name(i))]++;
+            }
+            for (size_t b = 0; b < BUCKETS; b++)
+            {
+                order[b] = b;
+            }
+            // 先处理命令名多的桶，这时空槽位多，容易找到位移值
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return bucket_size[a] > bucket_size[b];
+            });
+
+            for (auto bucket : order)
+            {
+                if (bucket_size[bucket] == 0)
+                {
+                    break;
+                }
+                for (uint32_t d = 1;; d++)
+                {
+                    if (TryPlace(bucket, d))
+                    {
+                        displacements_[bucket] = d;
+                        break;
+                    }
+                }
+            }
+        }
+
+        /// redis function: lookupCommand
+        /// 不区分大小写查找命令，找不到时返回空指针
+        constexpr const Command *Lookup(std::string_view name) const
+        {
+            auto index = IndexOf(name);
+            return index == N ? nullptr : &commands_[index];
+        }
+
+        /// 命令在表里的下标，用于索引统计数据，找不到时返回 Size()
+        constexpr size_t IndexOf(std::string_view name) const
+        {
+            auto d = displacements_[Bucket(name)];
+            if (d == 0)
+            {
+                return N;
+            }
+            auto index = slots_[Slot(name, d)];
+            if (index == EMPTY || !EqualsIgnoreCase(Name(index), name))
+            {
+                return N;
+            }
+            return index;
+        }
+
+        /// 命令在表里的下标
+        constexpr size_t IndexOf(const Command &command) const
+        {
+            return static_cast<size_t>(&command - commands_.data());
+        }
+
+        static constexpr size_t Size()
+        {
+            return N;
+        }
+
+        constexpr const Command &operator[](size_t index) const
+        {
+            return commands_[index];
+        }
+
+        constexpr auto begin() const
+        {
+            return commands_.begin();
+        }
+
+        constexpr auto end() const
+        {
+            return commands_.end();
+        }
+
+    private:
+        constexpr std::string_view Name(size_t index) const
+        {
+            return static_cast<const CommandInfo &>(commands_[index]).name;
+        }
+
+        static constexpr size_t Bucket(std::string_view name)
+        {
+            return CommandNameHash(name, 0) & (BUCKETS - 1);
+        }
+
+        static constexpr size_t Slot(std::string_view name, uint32_t d)
+        {
+            return CommandNameHash(name, d) & (SLOTS - 1);
+        }
+
+        /// 尝试用位移值 d 放置桶里的全部命令名，有冲突时撤销已经放置的槽位
+        constexpr bool TryPlace(size_t bucket, uint32_t d)
+        {
+            std::array<size_t, N> placed{};
+            size_t count = 0;
+            for (size_t i = 0; i < N; i++)
+            {
+                if (Bucket(Name(i)) != bucket)
+                {
+                    continue;
+                }
+                auto slot = Slot(Name(i), d);
+                if (slots_[slot] != EMPTY)
+                {
+                    // 同一个桶里的两个命令名落到同一个槽位，d 再大也分不开，说明命令名重复
+                    if (EqualsIgnoreCase(Name(slots_[slot]), Name(i)))
+                    {
+                        throw "命令名重复";
+                    }
+                    for (size_t j = 0; j < count; j++)
+                    {
+                        slots_[placed[j]] = EMPTY;
+                    }
+                    return false;
+                }
+                slots_[slot] = static_cast<uint16_t>(i);
+                placed[count++] = slot;
+            }
+            return true;
+        }
+
+    private:
+        std::array<Command, N> commands_;
+        /// 槽位到命令下标的映射
+        std::array<uint16_t, SLOTS> slots_{};
+        /// 每个桶的位移值，0 表示空桶
+        std::array<uint32_t, BUCKETS> displacements_{};
+    };
+} // namespace tr
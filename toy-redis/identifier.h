@@ -28,5 +28,13 @@ namespace tr {
         // 再向客户端写入完成为置为该状态
         static constexpr int REDIS_CLOSE_AFTER_REPLY = 1 << 7;
         static constexpr int REDIS_UNBLOCKED = 1 << 8;
+        // 有回复等待写出，已经加入服务端的 clients_pending_write 列表
+        static constexpr int REDIS_PENDING_WRITE = 1 << 9;
+        // 读事件已经发生，等待 IO 线程读取
+        static constexpr int REDIS_PENDING_READ = 1 << 10;
+        // 已经解析出一条完整的命令，等待事件循环线程执行
+        static constexpr int REDIS_PENDING_COMMAND = 1 << 11;
+        // 已经加入服务端的 clients_to_close 列表，在 BeforeSleep 里关闭
+        static constexpr int REDIS_CLOSE_ASAP = 1 << 12;
     }
 }
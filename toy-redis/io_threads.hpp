@@ -0,0 +1,167 @@
+#pragma once
+
+#include "base/marco.hpp"
+#include "toy-redis/client.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace tr
+{
+    /// redis macro: IO_THREADS_MAX_NUM
+    static constexpr int32_t IO_THREADS_MAX_NUM = 128;
+
+    /// @brief 处理客户端读写的 IO 线程池
+    /// redis: networking.c 的 threaded I/O
+    /// 事件循环线程把等待读或者等待写的客户端平均分给各个 IO 线程，自己也处理其中一份，
+    /// 然后等待全部 IO 线程完成。IO 线程只调用 socket 的 read/write 和解析请求，
+    /// 只访问分给自己的客户端，命令仍然由事件循环线程执行，键空间不需要加锁。
+    /// 一批客户端处理完之前事件循环线程不会返回，所以同一个客户端不会同时被两个线程访问
+    class IOThreads
+    {
+    public:
+        /// redis macro: IO_THREADS_OP_READ, IO_THREADS_OP_WRITE
+        enum class Operation
+        {
+            Read,
+            Write
+        };
+
+        DISABLE_COPY_AND_MOVE(IOThreads)
+
+        /// thread_count 包括事件循环线程，为 1 时不创建任何线程
+        explicit IOThreads(size_t thread_count)
+        {
+            for (size_t i = 1; i < thread_count; i++)
+            {
+                workers_.emplace_back(std::make_unique<Worker>());
+            }
+            for (auto &worker : workers_)
+            {
+                worker->thread = std::thread([this, w = worker.get()] { WorkerLoop(*w); });
+            }
+        }
+
+        ~IOThreads()
+        {
+            stop_.store(true, std::memory_order_relaxed);
+            for (auto &worker : workers_)
+            {
+                worker->pending.store(1, std::memory_order_release);
+                worker->pending.notify_one();
+            }
+            for (auto &worker : workers_)
+            {
+                worker->thread.join();
+            }
+        }
+
+        /// 线程数量，包括事件循环线程
+        size_t Count() const
+        {
+            return workers_.size() + 1;
+        }
+
+        /// redis function: handleClientsWithPendingReadsUsingThreads 的分发部分
+        /// 把 clients 平均分给全部线程执行 operation，返回时全部客户端都已经处理完
+        void Run(const std::vector<std::shared_ptr<RedisClient>> &clients, Operation operation)
+        {
+            // redis function: stopThreadedIOIfNeeded
+            // 客户端太少时唤醒 IO 线程的开销比并行节省的时间多，直接在事件循环线程里处理
+            if (clients.size() < Count() * 2)
+            {
+                for (auto &client : clients)
+                {
+                    Process(*client, operation);
+                }
+                return;
+            }
+
+            operation_ = operation;
+            for (size_t i = 0; i < clients.size(); i++)
+            {
+                auto slot = i % Count();
+                if (slot == 0)
+                {
+                    continue;
+                }
+                workers_[slot - 1]->clients.emplace_back(clients[i].get());
+            }
+            // release 保证 IO 线程能看到上面写入的客户端列表和 operation_
+            for (auto &worker : workers_)
+            {
+                if (!worker->clients.empty())
+                {
+                    worker->pending.store(worker->clients.size(), std::memory_order_release);
+                    worker->pending.notify_one();
+                }
+            }
+
+            // 事件循环线程处理第 0 份
+            for (size_t i = 0; i < clients.size(); i += Count())
+            {
+                Process(*clients[i], operation);
+            }
+
+            // 等待全部 IO 线程完成，acquire 保证能看到 IO 线程对客户端的修改
+            for (auto &worker : workers_)
+            {
+                size_t pending;
+                while ((pending = worker->pending.load(std::memory_order_acquire)) != 0)
+                {
+                    worker->pending.wait(pending, std::memory_order_acquire);
+                }
+            }
+        }
+
+    private:
+        struct Worker
+        {
+            std::thread thread;
+            /// 分给这个线程的客户端，只在 pending 不为 0 时由该线程访问
+            std::vector<RedisClient *> clients;
+            /// 还没有处理的客户端数量，也用来唤醒线程
+            std::atomic<size_t> pending{0};
+        };
+
+        /// redis function: IOThreadMain
+        void WorkerLoop(Worker &worker)
+        {
+            while (true)
+            {
+                worker.pending.wait(0, std::memory_order_acquire);
+                if (stop_.load(std::memory_order_relaxed))
+                {
+                    return;
+                }
+                for (auto client : worker.clients)
+                {
+                    Process(*client, operation_);
+                }
+                worker.clients.clear();
+                worker.pending.store(0, std::memory_order_release);
+                worker.pending.notify_one();
+            }
+        }
+
+        static void Process(RedisClient &client, Operation operation)
+        {
+            if (operation == Operation::Read)
+            {
+                client.ReadQuery();
+            }
+            else
+            {
+                client.WriteToClient();
+            }
+        }
+
+    private:
+        std::vector<std::unique_ptr<Worker>> workers_;
+        Operation operation_ = Operation::Read;
+        std::atomic<bool> stop_{false};
+    };
+} // namespace tr
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "base/marco.hpp"
+#include "toy-redis/server.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace tr
+{
+    /// 多 reactor 模式最多的事件循环数量
+    static constexpr int32_t REACTORS_MAX_NUM = 128;
+
+    /// @brief 多 reactor 模式的服务端
+    /// 创建 config.reactors 个分片，每个分片是一个独立的 ToyRedisServer：
+    /// 有自己的事件循环线程、SO_REUSEPORT 监听 socket、客户端和一部分键空间。
+    /// 内核把新连接分配给其中一个分片，连接之后一直由这个分片处理。
+    /// key 按 KeyHashSlot 分到各个分片，key 不属于当前分片的命令通过邮箱转发给所属的分片执行，
+    /// 各个分片的键空间只被自己的线程访问，不需要加锁
+    class MultiReactorServer
+    {
+        using ServerConfig = ToyRedisServer::ServerConfig;
+
+    public:
+        DISABLE_COPY_AND_MOVE(MultiReactorServer)
+
+        MultiReactorServer(std::string_view config_file, const ServerConfig &config)
+        {
+            auto shard_config = config;
+            shard_config.reactors = std::clamp(config.reactors, 1, REACTORS_MAX_NUM);
+            std::vector<ToyRedisServer *> shards;
+            for (int32_t i = 0; i < shard_config.reactors; i++)
+            {
+                shards_.emplace_back(std::make_unique<ToyRedisServer>(config_file, shard_config));
+                shards.emplace_back(shards_.back().get());
+            }
+            for (size_t i = 0; i < shards_.size(); i++)
+            {
+                shards_[i]->SetShards(shards, i);
+            }
+        }
+
+        ~MultiReactorServer()
+        {
+            Stop();
+            Join();
+        }
+
+        /// 启动全部分片，0 号分片在当前线程运行，阻塞到 Stop() 被调用
+        void Run()
+        {
+            for (size_t i = 1; i < shards_.size(); i++)
+            {
+                threads_.emplace_back([shard = shards_[i].get()] { shard->Run(); });
+            }
+            shards_[0]->Run();
+            Join();
+        }
+
+        /// 停止全部分片，允许跨线程调用
+        void Stop()
+        {
+            for (auto &shard : shards_)
+            {
+                shard->Stop();
+            }
+        }
+
+        /// 分片数量
+        size_t ShardCount() const
+        {
+            return shards_.size();
+        }
+
+        /// 第 index 个分片
+        ToyRedisServer &Shard(size_t index)
+        {
+            return *shards_[index];
+        }
+
+    private:
+        void Join()
+        {
+            for (auto &thread : threads_)
+            {
+                if (thread.joinable())
+                {
+                    thread.join();
+                }
+            }
+            threads_.clear();
+        }
+
+    private:
+        std::vector<std::unique_ptr<ToyRedisServer>> shards_;
+        std::vector<std::thread> threads_;
+    };
+} // namespace tr
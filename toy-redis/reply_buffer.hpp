@@ -0,0 +1,354 @@
+#pragma once
+
+#include "base/fixed_buffer.hpp"
+#include "base/list.hpp"
+#include "base/redis_object.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <linux/errqueue.h>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+namespace tr
+{
+    /// redis macro: PROTO_REPLY_CHUNK_BYTES
+    /// 固定回复缓冲区和回复链表里每个块的默认大小
+    static constexpr size_t PROTO_REPLY_CHUNK_BYTES = 16 * 1024;
+
+    /// 不小于这个长度的字符串值在回复时不复制，输出缓冲区只保存对值的引用
+    static constexpr size_t PROTO_REPLY_REFERENCE_MIN_BYTES = PROTO_REPLY_CHUNK_BYTES;
+
+    /// redis macro: IOV_MAX 的取值
+    /// 一次 writev 最多合并的块数
+    static constexpr int REPLY_IOV_MAX = 64;
+
+    /// @brief 客户端的输出缓冲区
+    /// redis: client 的 buf、bufpos、sentlen 和 reply 链表
+    /// 小的回复先写进固定大小的 buf_，不需要分配内存；buf_ 放不下之后，
+    /// 剩余的内容追加到 reply_ 链表里，每个块至少 PROTO_REPLY_CHUNK_BYTES 字节，
+    /// 大的回复不需要整体复制到一块连续的内存里。
+    /// 大的字符串值通过 AppendReference 以引用块的形式放进链表，直接从值的内存发送。
+    /// 回复按顺序发送：先发送 buf_，再依次发送链表里的块，sentLength_ 记录当前块已经发送的字节数，
+    /// 部分写入时下一次从中断的位置继续发送。多个块用一次 writev 写出。
+    /// 开启零拷贝时，不小于阈值的引用块用 sendmsg(MSG_ZEROCOPY) 单独发送，
+    /// 内核发送完成之前引用保存在 pinned_ 里，从 socket 的错误队列收到完成通知后释放
+    class ReplyBuffer
+    {
+        /// redis struct: clientReplyBlock
+        struct ReplyBlock
+        {
+            explicit ReplyBlock(size_t capacity)
+                : size(capacity), data(std::make_unique<char[]>(capacity))
+            {
+            }
+
+            /// 引用块，内容是 reference 指向的字符串，不能再追加内容
+            explicit ReplyBlock(base::SharedStringRef value)
+                : size(value.View().size()), used(size), reference(std::move(value))
+            {
+            }
+
+            const char *Data() const
+            {
+                return reference ? reference.View().data() : data.get();
+            }
+
+            /// 块的容量
+            size_t size;
+            /// 已经写入的字节数
+            size_t used = 0;
+            std::unique_ptr<char[]> data;
+            base::SharedStringRef reference;
+        };
+
+        /// 零拷贝发送中的引用，id 是这次 sendmsg 在 socket 上的序号
+        struct PinnedReference
+        {
+            uint32_t id;
+            base::SharedStringRef reference;
+        };
+
+    public:
+        /// redis function: _addReplyToBufferOrList
+        /// 追加回复内容
+        void Append(std::string_view content)
+        {
+            // 链表不为空时，新的内容必须追加在链表后面，否则会打乱回复的顺序
+            if (reply_.empty())
+            {
+                auto length = std::min(content.size(), buf_.FreeSize());
+                buf_.Append(content.substr(0, length));
+                content.remove_prefix(length);
+            }
+            if (content.empty())
+            {
+                return;
+            }
+
+            if (!reply_.empty() && !reply_.back().reference)
+            {
+                auto &tail = reply_.back();
+                auto length = std::min(content.size(), tail.size - tail.used);
+                std::memcpy(tail.data.get() + tail.used, content.data(), length);
+                tail.used += length;
+                content.remove_prefix(length);
+            }
+            if (!content.empty())
+            {
+                auto &block = reply_.emplace_back(std::max(content.size(), PROTO_REPLY_CHUNK_BYTES));
+                std::memcpy(block.data.get(), content.data(), content.size());
+                block.used = content.size();
+            }
+        }
+
+        /// 追加一个字符串值的引用，发送之前值的内容一直有效，不需要复制
+        void AppendReference(base::SharedStringRef value)
+        {
+            if (value.View().empty())
+            {
+                return;
+            }
+            reply_.emplace_back(std::move(value));
+        }
+
+        /// 设置使用 MSG_ZEROCOPY 发送的引用块的最小长度，0 表示不使用。
+        /// socket 必须已经设置了 SO_ZEROCOPY，否则内核忽略这个标志，不会发送完成通知
+        void SetZeroCopyThreshold(size_t threshold)
+        {
+            zeroCopyThreshold_ = threshold;
+        }
+
+        /// 是否有零拷贝发送还没有收到完成通知
+        bool ZeroCopyPending() const
+        {
+            return !pinned_.empty();
+        }
+
+        /// 读取 socket 错误队列里的零拷贝完成通知，释放已经发送完成的引用。
+        /// 有未读的通知时 socket 会一直报告 EPOLLERR，读写事件里都要调用
+        void ReapZeroCopy(int fd)
+        {
+            while (!pinned_.empty())
+            {
+                char control[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6))];
+                msghdr msg{};
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+                if (recvmsg(fd, &msg, MSG_ERRQUEUE) == -1)
+                {
+                    // EAGAIN：通知已经全部读完
+                    return;
+                }
+                for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+                {
+                    if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+                        !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+                    {
+                        continue;
+                    }
+                    sock_extended_err err;
+                    std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+                    if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                    {
+                        continue;
+                    }
+                    // 通知里是一段完成的序号 [ee_info, ee_data]，序号是 32 位的，会回绕
+                    auto first = err.ee_info;
+                    auto count = err.ee_data - first;
+                    std::erase_if(pinned_, [first, count](const PinnedReference &pinned) {
+                        return pinned.id - first <= count;
+                    });
+                }
+            }
+        }
+
+        /// redis function: clientHasPendingReplies
+        bool Empty() const
+        {
+            return buf_.UsedSize() == 0 && reply_.empty();
+        }
+
+        /// 还没有发送的字节数
+        size_t PendingBytes() const
+        {
+            size_t pending = buf_.UsedSize();
+            for (auto &block : reply_)
+            {
+                pending += block.used;
+            }
+            return pending - sentLength_;
+        }
+
+        /// 链表里的块的数量
+        size_t BlockCount() const
+        {
+            return reply_.size();
+        }
+
+        /// redis function: _writeToClient, _writevToClient
+        /// 把缓冲区里的内容写入 fd，最多写 max_bytes 字节。
+        /// 返回写入的字节数，socket 缓冲区已满时返回已经写入的字节数，
+        /// 出错时返回 -1，errno 保存错误原因
+        ssize_t WriteTo(int fd, size_t max_bytes)
+        {
+            size_t total = 0;
+            while (!Empty() && total < max_bytes)
+            {
+                ssize_t written = -1;
+                size_t expected = 0;
+                auto zero_copy = buf_.UsedSize() == 0 && IsZeroCopy(reply_.front());
+                if (zero_copy)
+                {
+                    expected = reply_.front().used - sentLength_;
+                    written = SendZeroCopy(fd, reply_.front());
+                }
+                // 零拷贝需要锁定的内存超过限制时返回 ENOBUFS，改为普通发送
+                if (!zero_copy || (written == -1 && errno == ENOBUFS))
+                {
+                    written = WriteVector(fd, max_bytes - total, expected);
+                }
+                if (written == -1 && errno == EAGAIN)
+                {
+                    break;
+                }
+                if (written <= 0)
+                {
+                    return -1;
+                }
+                total += written;
+                Consume(static_cast<size_t>(written));
+
+                if (static_cast<size_t>(written) < expected)
+                {
+                    // socket 缓冲区已满，剩下的内容等下一次可写时再发送
+                    break;
+                }
+            }
+            return static_cast<ssize_t>(total);
+        }
+
+        /// 取出全部还没有发送的内容并清空缓冲区，用于不连接 socket 的伪客户端
+        std::string Take()
+        {
+            std::string content;
+            content.reserve(PendingBytes());
+            auto skip = sentLength_;
+            if (buf_.UsedSize() > 0)
+            {
+                content.append(buf_.Data() + skip, buf_.UsedSize() - skip);
+                skip = 0;
+            }
+            for (auto &block : reply_)
+            {
+                content.append(block.Data() + skip, block.used - skip);
+                skip = 0;
+            }
+            Clear();
+            return content;
+        }
+
+        /// 丢弃全部还没有发送的内容。零拷贝发送中的引用不受影响，仍然等待完成通知
+        void Clear()
+        {
+            buf_.Clear();
+            reply_.clear();
+            sentLength_ = 0;
+        }
+
+    private:
+        bool IsZeroCopy(const ReplyBlock &block) const
+        {
+            return zeroCopyThreshold_ > 0 && block.reference && block.used >= zeroCopyThreshold_;
+        }
+
+        /// 用 MSG_ZEROCOPY 发送一个引用块剩下的内容，发送成功时保存引用直到收到完成通知
+        ssize_t SendZeroCopy(int fd, const ReplyBlock &block)
+        {
+            iovec iov{const_cast<char *>(block.Data()) + sentLength_, block.used - sentLength_};
+            msghdr msg{};
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            auto written = sendmsg(fd, &msg, MSG_ZEROCOPY);
+            if (written > 0)
+            {
+                // 只有发送了数据的 sendmsg 才会占用一个序号
+                pinned_.push_back({zeroCopyId_++, block.reference});
+            }
+            return written;
+        }
+
+        /// 把 buf_ 和链表开头的若干个块合并成一次 writev，合并的字节数达到 max_bytes 后停止，
+        /// 遇到需要零拷贝发送的块也停止。expected 返回这次尝试写出的字节数
+        ssize_t WriteVector(int fd, size_t max_bytes, size_t &expected)
+        {
+            iovec iov[REPLY_IOV_MAX];
+            int count = 0;
+            expected = 0;
+            auto skip = sentLength_;
+            if (buf_.UsedSize() > 0)
+            {
+                iov[count++] = {buf_.Data() + skip, buf_.UsedSize() - skip};
+                expected += buf_.UsedSize() - skip;
+                skip = 0;
+            }
+            for (auto &block : reply_)
+            {
+                if (count == REPLY_IOV_MAX || expected >= max_bytes || (count > 0 && IsZeroCopy(block)))
+                {
+                    break;
+                }
+                iov[count++] = {const_cast<char *>(block.Data()) + skip, block.used - skip};
+                expected += block.used - skip;
+                skip = 0;
+            }
+            return writev(fd, iov, count);
+        }
+
+        /// 丢弃已经写出的 length 字节，发送完的块从链表里删除
+        void Consume(size_t length)
+        {
+            while (length > 0)
+            {
+                auto used = buf_.UsedSize() > 0 ? buf_.UsedSize() : reply_.front().used;
+                if (length < used - sentLength_)
+                {
+                    sentLength_ += length;
+                    return;
+                }
+                length -= used - sentLength_;
+                sentLength_ = 0;
+                if (buf_.UsedSize() > 0)
+                {
+                    buf_.Clear();
+                }
+                else
+                {
+                    reply_.pop_front();
+                }
+            }
+        }
+
+    private:
+        base::FixedBuffer<PROTO_REPLY_CHUNK_BYTES> buf_;
+        base::LinkedList<ReplyBlock> reply_;
+        /// 当前正在发送的块（buf_ 或者链表的第一个块）已经发送的字节数
+        size_t sentLength_ = 0;
+        /// 使用 MSG_ZEROCOPY 的最小长度，0 表示不使用
+        size_t zeroCopyThreshold_ = 0;
+        /// 下一次零拷贝发送的序号，和内核为这个 socket 分配的序号一致
+        uint32_t zeroCopyId_ = 0;
+        /// 零拷贝发送中的引用，收到完成通知之前不能释放
+        std::vector<PinnedReference> pinned_;
+    };
+} // namespace tr
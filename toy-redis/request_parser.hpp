@@ -0,0 +1,278 @@
+#pragma once
+
+#include "base/redis_object.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace tr
+{
+    /// redis macro: PROTO_INLINE_MAX_SIZE
+    /// inline 请求一行的最大长度，也是 multi-bulk 请求里长度行的最大长度
+    static constexpr size_t PROTO_INLINE_MAX_SIZE = 64 * 1024;
+    /// multi-bulk 请求最多包含的参数数量
+    static constexpr int64_t PROTO_MAX_MULTIBULK_LENGTH = 1024 * 1024;
+    /// redis config: proto-max-bulk-len
+    /// 单个参数的最大长度
+    static constexpr int64_t PROTO_MAX_BULK_LENGTH = 512LL * 1024 * 1024;
+    /// redis macro: PROTO_MBULK_BIG_ARG
+    /// 不小于这个长度的参数是大参数，读取时按参数的长度一次分配好查询缓冲区
+    static constexpr int64_t PROTO_MBULK_BIG_ARG = 32 * 1024;
+    /// 收到长度行时最多预留的参数数量，更多的参数随着接收逐步扩容，
+    /// 避免只发送一个很大的参数数量就让服务端分配大量内存
+    static constexpr int64_t PROTO_ARGV_RESERVE_MAX = 1024;
+
+    /// 请求解析的结果
+    enum class ParseResult
+    {
+        /// 解析出了一条完整的命令
+        Complete,
+        /// 数据不完整，需要等待更多数据
+        NeedMore,
+        /// 协议错误，需要回复错误并关闭连接
+        Error
+    };
+
+    /// @brief 可恢复的请求解析器
+    /// redis function: processInlineBuffer, processMultibulkBuffer
+    /// 支持 inline 请求（telnet 风格，一行一条命令）和 multi-bulk 请求
+    /// （*N\r\n$len\r\narg\r\n...）。RESP2 和 RESP3 的请求格式相同，区别只在回复。
+    ///
+    /// 解析器不持有数据，每次调用 Parse() 传入客户端完整的查询缓冲区。缓冲区在两次调用之间
+    /// 可以追加数据并被重新分配，因此解析过程中只记录参数在缓冲区里的偏移，命令完整后才生成
+    /// 指向缓冲区的 string_view，不复制参数内容。
+    /// 一条命令被部分接收时，解析器记录已经解析到的位置，收到更多数据后从该位置继续解析，
+    /// 不会重复扫描已经解析过的参数
+    class RequestParser
+    {
+        enum class RequestType
+        {
+            Initial,
+            Inline,
+            MultiBulk
+        };
+
+    public:
+        /// 从上一次停下的位置继续解析一条命令。返回 Complete 时 argv 被替换为命令的参数，
+        /// 参数指向 buffer 内部，在 buffer 被修改前有效
+        ParseResult Parse(std::string_view buffer, std::vector<std::string_view> &argv)
+        {
+            if (type_ == RequestType::Initial)
+            {
+                if (pos_ >= buffer.size())
+                {
+                    return ParseResult::NeedMore;
+                }
+                type_ = buffer[pos_] == '*' ? RequestType::MultiBulk : RequestType::Inline;
+            }
+
+            auto result = type_ == RequestType::Inline
+                              ? ParseInline(buffer)
+                              : ParseMultiBulk(buffer);
+            if (result == ParseResult::Complete)
+            {
+                argv.clear();
+                for (auto [offset, length] : args_)
+                {
+                    argv.emplace_back(buffer.data() + offset, length);
+                }
+            }
+            return result;
+        }
+
+        /// redis function: resetClient
+        /// 一条命令执行完之后调用，准备解析下一条命令
+        void Reset()
+        {
+            type_ = RequestType::Initial;
+            multiBulkLength_ = 0;
+            bulkLength_ = -1;
+            args_.clear();
+            commandStart_ = pos_;
+        }
+
+        /// 缓冲区开头已经处理完、可以删除的字节数，即当前命令的起始位置
+        size_t Consumable() const
+        {
+            return type_ == RequestType::Initial ? pos_ : commandStart_;
+        }
+
+        /// 调用者删除了缓冲区开头的 length 个字节后调用，修正记录的偏移
+        void Discard(size_t length)
+        {
+            assert(length <= Consumable());
+            pos_ -= length;
+            commandStart_ -= length;
+            for (auto &arg : args_)
+            {
+                arg.first -= length;
+            }
+        }
+
+        /// 正在接收一个大参数时，返回缓冲区至少要达到的长度，即这个参数和结尾的 "\r\n" 接收完的位置；
+        /// 否则返回 0。读取时用它预先分配刚好够用的查询缓冲区
+        size_t BigArgumentEnd() const
+        {
+            if (type_ != RequestType::MultiBulk || bulkLength_ < PROTO_MBULK_BIG_ARG)
+            {
+                return 0;
+            }
+            return pos_ + static_cast<size_t>(bulkLength_) + 2;
+        }
+
+        /// 协议错误的描述
+        const std::string &Error() const
+        {
+            return error_;
+        }
+
+    private:
+        /// inline 请求：以 '\n' 结尾的一行，参数用空格或者制表符分隔
+        ParseResult ParseInline(std::string_view buffer)
+        {
+            auto newline = buffer.find('\n', pos_);
+            if (newline == std::string_view::npos)
+            {
+                if (buffer.size() - pos_ > PROTO_INLINE_MAX_SIZE)
+                {
+                    return SetError("Protocol error: too big inline request");
+                }
+                return ParseResult::NeedMore;
+            }
+
+            auto end = newline;
+            if (end > pos_ && buffer[end - 1] == '\r')
+            {
+                end--;
+            }
+            auto i = pos_;
+            while (i < end)
+            {
+                while (i < end && (buffer[i] == ' ' || buffer[i] == '\t'))
+                {
+                    i++;
+                }
+                auto start = i;
+                while (i < end && buffer[i] != ' ' && buffer[i] != '\t')
+                {
+                    i++;
+                }
+                if (i > start)
+                {
+                    args_.emplace_back(start, i - start);
+                }
+            }
+            pos_ = newline + 1;
+            return ParseResult::Complete;
+        }
+
+        /// multi-bulk 请求，一个参数接收完整之后立即记录，下一次从下一个参数继续解析
+        ParseResult ParseMultiBulk(std::string_view buffer)
+        {
+            if (multiBulkLength_ == 0)
+            {
+                int64_t length;
+                auto result = ParseLength(buffer, '*', "multibulk", length);
+                if (result != ParseResult::Complete)
+                {
+                    return result;
+                }
+                if (length > PROTO_MAX_MULTIBULK_LENGTH)
+                {
+                    return SetError("Protocol error: invalid multibulk length");
+                }
+                // "*0\r\n" 和 "*-1\r\n" 是空命令
+                if (length <= 0)
+                {
+                    return ParseResult::Complete;
+                }
+                multiBulkLength_ = length;
+                args_.reserve(std::min<int64_t>(length, PROTO_ARGV_RESERVE_MAX));
+            }
+
+            while (multiBulkLength_ > 0)
+            {
+                if (bulkLength_ == -1)
+                {
+                    int64_t length;
+                    auto result = ParseLength(buffer, '$', "bulk", length);
+                    if (result != ParseResult::Complete)
+                    {
+                        return result;
+                    }
+                    if (length < 0 || length > PROTO_MAX_BULK_LENGTH)
+                    {
+                        return SetError("Protocol error: invalid bulk length");
+                    }
+                    bulkLength_ = length;
+                }
+
+                // 参数内容和结尾的 "\r\n" 都收到了才算完整
+                if (buffer.size() - pos_ < static_cast<size_t>(bulkLength_) + 2)
+                {
+                    return ParseResult::NeedMore;
+                }
+                args_.emplace_back(pos_, bulkLength_);
+                pos_ += bulkLength_ + 2;
+                bulkLength_ = -1;
+                multiBulkLength_--;
+            }
+            return ParseResult::Complete;
+        }
+
+        /// 解析 "<prefix><整数>\r\n" 形式的长度行，成功后 pos_ 移动到下一行
+        ParseResult ParseLength(std::string_view buffer, char prefix, const char *name, int64_t &length)
+        {
+            auto cr = buffer.find('\r', pos_);
+            if (cr == std::string_view::npos || cr + 1 >= buffer.size())
+            {
+                if (buffer.size() - pos_ > PROTO_INLINE_MAX_SIZE)
+                {
+                    return SetError(std::string("Protocol error: too big ") + name + " count string");
+                }
+                return ParseResult::NeedMore;
+            }
+            if (buffer[pos_] != prefix)
+            {
+                return SetError(std::string("Protocol error: expected '") + prefix +
+                                "', got '" + buffer[pos_] + "'");
+            }
+            if (!base::StringToInteger(buffer.substr(pos_ + 1, cr - pos_ - 1), length))
+            {
+                return SetError(std::string("Protocol error: invalid ") + name + " length");
+            }
+            if (buffer[cr + 1] != '\n')
+            {
+                return SetError(std::string("Protocol error: invalid ") + name + " length");
+            }
+            pos_ = cr + 2;
+            return ParseResult::Complete;
+        }
+
+        ParseResult SetError(std::string message)
+        {
+            error_ = std::move(message);
+            return ParseResult::Error;
+        }
+
+    private:
+        RequestType type_ = RequestType::Initial;
+        /// 下一个需要解析的字节的位置
+        size_t pos_ = 0;
+        /// 当前命令的起始位置
+        size_t commandStart_ = 0;
+        /// multi-bulk 请求还没有解析的参数数量
+        int64_t multiBulkLength_ = 0;
+        /// 正在接收的参数的长度，-1 代表还没有解析长度行
+        int64_t bulkLength_ = -1;
+        /// 已经解析的参数在缓冲区里的偏移和长度
+        std::vector<std::pair<size_t, size_t>> args_;
+        std::string error_;
+    };
+} // namespace tr
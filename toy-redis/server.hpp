@@ -1,18 +1,29 @@
 #pragma once
 
-#include "base/dictionary.hpp"
+#include "base/hash.hpp"
+#include "base/lazy_free.hpp"
 #include "base/log.hpp"
 #include "base/marco.hpp"
+#include "base/redis_database.hpp"
 #include "base/simple_dynamic_string.hpp"
+#include "base/time_helper.hpp"
 #include "net/anet.hpp"
 #include "net/default_poller.hpp"
 #include "net/io_service.hpp"
+#if defined(__linux__)
+#include "net/io_uring_poller.hpp"
+#endif
 #include "net/poller_types.hpp"
 #include "toy-redis/identifier.h"
+#include "toy-redis/io_threads.hpp"
+#include "toy-redis/shard.hpp"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <random>
 #include <string_view>
 #include <thread>
 #include <vector>
@@ -24,19 +35,91 @@ namespace tr
     /// 服务端实现
     class ToyRedisServer
     {
+#if defined(__linux__)
+        // 运行时选择 io_uring 或者 epoll
+        using IOServiceType = net::IOService<net::IoUringPoller>;
+#else
         using IOServiceType = net::IOService<net::DefaultPoller>;
+#endif
+
+    public:
         /// 服务端配置信息
         struct ServerConfig
         {
             int32_t dbNum = 16;               // 最大数据库数量
             const char *bindAddr = "0.0.0.0"; // 绑定地址
             int32_t port = 6758;              // 服务端口
+            int32_t hz = 10;                  // serverCron 每秒执行的次数
+            // 键空间使用的字符串哈希算法，默认使用能抵抗哈希洪水攻击的 SipHash
+            base::HashAlgorithm hashAlgorithm = base::HashAlgorithm::SipHash;
+            // 处理客户端读写的线程数量，包括事件循环线程，1 表示不使用 IO 线程
+            int32_t ioThreads = 1;
+            // 多 reactor 模式的事件循环数量，每个事件循环一个线程、一个 SO_REUSEPORT 监听 socket，
+            // 并且拥有按 key 分片的一部分键空间，1 表示单个事件循环
+            int32_t reactors = 1;
+            // 事件循环使用边缘触发的 epoll，客户端和监听 socket 的处理函数会一直读写到 EAGAIN
+            bool edgeTriggered = false;
+            // 事件循环使用 io_uring：监听 socket 用多次触发的 accept，客户端用多次触发的 recv 接收数据，
+            // 回复仍然在 BeforeSleep 里直接写出。内核不支持时回退到 epoll。io_uring 模式下忽略 edgeTriggered
+            bool ioUring = false;
+            // 不小于这个长度的 GET 回复用 MSG_ZEROCOPY 发送，0 表示不使用零拷贝。
+            // 零拷贝需要锁定页面并且处理完成通知，只对很大的值才比复制更快
+            size_t zeroCopyThreshold = 0;
+        };
+
+    private:
+
+        /// 每轮事件循环用于渐进式 rehash 的时间上限，单位毫秒
+        static constexpr int64_t REHASH_MILLISECONDS_PER_LOOP = 1;
+
+        /// redis macro: ACTIVE_EXPIRE_CYCLE_KEYS_PER_LOOP
+        /// 定期删除每一步抽查的 key 数量
+        static constexpr size_t ACTIVE_EXPIRE_CYCLE_KEYS_PER_LOOP = 20;
+        /// redis macro: ACTIVE_EXPIRE_CYCLE_FAST_DURATION
+        /// 快速定期删除的时间上限，单位微秒
+        static constexpr int64_t ACTIVE_EXPIRE_CYCLE_FAST_DURATION = 1000;
+        /// redis macro: ACTIVE_EXPIRE_CYCLE_SLOW_TIME_PERC
+        /// 慢速定期删除最多占用的 CPU 时间百分比
+        static constexpr int64_t ACTIVE_EXPIRE_CYCLE_SLOW_TIME_PERC = 25;
+        /// redis macro: ACTIVE_EXPIRE_CYCLE_ACCEPTABLE_STALE
+        /// 抽查到的过期 key 比例不超过该百分比时，认为该数据库已经清理干净
+        static constexpr size_t ACTIVE_EXPIRE_CYCLE_ACCEPTABLE_STALE = 10;
+        /// redis macro: CRON_DBS_PER_CALL
+        /// 每轮定期删除最多处理的数据库数量
+        static constexpr size_t CRON_DBS_PER_CALL = 16;
+        /// 边缘触发时 accept 因为 fd 用尽等错误停止后，重新尝试 accept 的间隔，单位毫秒
+        static constexpr uint64_t ACCEPT_RETRY_MILLISECONDS = 100;
+        /// 关闭连接时等待零拷贝完成通知的时间上限，单位毫秒。
+        /// 对端一直不读取时通知不会到达，超时后直接关闭 socket
+        static constexpr int64_t ZERO_COPY_CLOSE_TIMEOUT = 5000;
+
+        /// 连接已经关闭、等待零拷贝完成通知之后再关闭 socket 的客户端
+        struct ClosingClient
+        {
+            std::shared_ptr<RedisClient> client;
+            /// 超过这个时间，单位毫秒，不再等待通知
+            int64_t deadline;
+        };
+
+        /// redis macro: ACTIVE_EXPIRE_CYCLE_SLOW, ACTIVE_EXPIRE_CYCLE_FAST
+        enum class ExpireCycleType
+        {
+            /// 由 serverCron 执行，时间上限是每次 cron 间隔的 25%
+            Slow,
+            /// 由 BeforeSleep 执行，只在上一轮慢速删除超时退出时执行，时间上限 1 毫秒
+            Fast
         };
 
     public:
         DISABLE_COPY_AND_MOVE(ToyRedisServer)
 
         explicit ToyRedisServer(std::string_view config_file)
+            : ToyRedisServer(config_file, ServerConfig())
+        {
+        }
+
+        ToyRedisServer(std::string_view config_file, const ServerConfig &config)
+            : config_(config)
         {
             InitConfig();
             LoadServerConfig(config_file);
@@ -50,7 +133,15 @@ namespace tr
             if (ipfd_ > 0)
             {
                 auto addClient = [&](std::shared_ptr<RedisClient> ptr) {
-                    ptr->SetDict(dict_);
+                    ptr->SetDatabases(dbs_, lazy_free_);
+                    ptr->SetCommandStats(command_stats_);
+                    ptr->SetEdgeTriggered(config_.edgeTriggered);
+                    char netErr[net::ANET_ERR_LEN];
+                    if (config_.zeroCopyThreshold > 0 &&
+                        netTool_.anetSetZeroCopy(netErr, ptr->GetFd()) == net::ANET_OK)
+                    {
+                        ptr->SetZeroCopyThreshold(config_.zeroCopyThreshold);
+                    }
                     // ptr->SetOperateEventFunction([&](int32_t fd, net::Event event, EventHandler handler) {
                     //     io_service_.AddEventListener(fd, event, handler)},
                     //                                                                                           [&](int32_t fd, net::Event event) {
@@ -62,40 +153,133 @@ namespace tr
                         [&](int32_t fd, net::Event event) {
                             io_service_.DeleteEventListener(fd, event);
                         });
-                    list_.emplace_back(ptr);
-                    std::cout << "add client" << std::endl;
-                    // todo 客户端有读事件时的处理
+                    // 客户端关闭后 weak_ptr 失效，BeforeSleep 会跳过它
+                    std::weak_ptr<RedisClient> weak_client = ptr;
+                    ptr->SetPendingWriteFunction([this, weak_client] {
+                        clients_pending_write_.emplace_back(weak_client);
+                    });
+                    ptr->SetCloseFunction([this, weak_client] {
+                        clients_to_close_.emplace_back(weak_client);
+                    });
+                    if (shards_.size() > 1)
+                    {
+                        ptr->SetForwardFunction([this, weak_client](const RedisCommand &command) {
+                            return ForwardCommand(weak_client, command);
+                        });
+                    }
+                    auto fd = ptr.get()->GetFd();
+                    if (!LinkClient(ptr))
+                    {
+                        server_logger_.Error("Error registering fd event for the new client: fd is too large");
+                        close(fd);
+                        return;
+                    }
+                    // 客户端有读事件时的处理，按 fd 直接找到客户端
                     auto clientHandler = [&](auto fd, auto event, const std::any &client_data) {
-                        // assert(fd == ptr.get()->GetFd() && "fd不一致");
-                        std::vector<std::shared_ptr<RedisClient>>::iterator it;
-                        std::shared_ptr<RedisClient> rc;
-                        for (it = list_.begin(); it < list_.end(); it++) {
-                            if (it->get()->GetFd() == fd) {
-                                break;
+                        auto &client = clients_[fd];
+                        assert(client != nullptr && "找不到客户端");
+                        // 使用 IO 线程时推迟到 BeforeSleep 里并行读取
+                        if (io_threads_->Count() > 1)
+                        {
+                            if (!client->IsPendingRead())
+                            {
+                                client->SetPendingRead(true);
+                                clients_pending_read_.emplace_back(client);
                             }
+                            return;
                         }
-                        assert(it != list_.end() && "找不到客户端");
-                        std::cout << "read even have come" << std::endl;
-                        auto code = it->get()->readQueryFromClient();
-                        if (code == ErrorCode::REDIS_CLOSE) {
-                            list_.erase(it);
-                        }
+                        client->readQueryFromClient();
                     };
-                    auto fd = ptr.get()->GetFd();
+#if defined(__linux__)
+                    // 使用 io_uring 时由内核接收数据，完成事件里直接执行，不经过可读通知和 read
+                    auto &poller = io_service_.GetPoller();
+                    if (poller.UsingIoUring() && poller.RecvMultishot(fd, [this, fd](int32_t length, std::string_view data) {
+                            clients_[fd]->ReceiveQuery(length, data);
+                        }))
+                    {
+                        return;
+                    }
+#endif
                     auto result = io_service_.AddEventListener(fd, net::Read, clientHandler);
                     assert(result && "add even fail");
                 };
-                auto handle = [&](auto fd, auto event, const std::any &client_data) {
-                    netTool_.acceptTcpHandler(fd, addClient);
+                // addClient 是构造函数的局部变量，需要按值捕获
+                // 边缘触发时必须接受完全部等待的连接，否则剩下的连接不会再触发事件
+                auto max_accepts = config_.edgeTriggered ? SIZE_MAX : net::MAX_ACCEPTS_PER_CALL;
+                accept_handler_ = [this, addClient, max_accepts](auto fd, auto event, const std::any &client_data) {
+                    if (netTool_.acceptTcpHandler(fd, addClient, max_accepts) || !config_.edgeTriggered)
+                    {
+                        return;
+                    }
+                    // fd 用尽等错误使 accept 提前停止时，边缘触发不会为已经在队列里的连接再次通知，
+                    // 稍后重试，直到接受到 EAGAIN。水平触发时下一轮事件循环会再次触发
+                    io_service_.SetTimeout([this, fd] { accept_handler_(fd, net::Read, nullptr); },
+                                           ACCEPT_RETRY_MILLISECONDS);
                 };
-                io_service_.AddEventListener(ipfd_, net::Read, handle);
+#if defined(__linux__)
+                // 使用 io_uring 时提交一次多次触发的 accept，每个新连接一个完成事件
+                if (io_service_.GetPoller().UsingIoUring())
+                {
+                    io_service_.GetPoller().AcceptMultishot(ipfd_, [this, addClient](int32_t fd, std::string_view) {
+                        if (fd < 0)
+                        {
+                            server_logger_.Warn("Accepting client connection: %s", strerror(-fd));
+                            return;
+                        }
+                        netTool_.acceptCommonHandler(fd, addClient);
+                    });
+                }
+                else
+#endif
+                {
+                    io_service_.AddEventListener(ipfd_, net::Read, accept_handler_);
+                }
             }
             io_service_.SetBeforeSleepCallback(before_sleep);
-            io_service_.Run();
+            io_service_.SetInterval([this] { ServerCron(); }, 1000 / config_.hz);
         }
 
         ~ToyRedisServer() = default;
 
+        /// 启动事件循环，阻塞到 Stop() 被调用
+        void Run()
+        {
+            io_service_.Run();
+        }
+
+        /// 停止事件循环，允许跨线程调用
+        void Stop()
+        {
+            io_service_.Stop();
+            io_service_.WakeUp();
+        }
+
+        /// 多 reactor 模式下设置全部分片，index 是当前分片的下标。
+        /// 必须在任何一个分片启动事件循环之前调用
+        void SetShards(std::vector<ToyRedisServer *> shards, size_t index)
+        {
+            assert(index < shards.size() && shards[index] == this);
+            shards_ = std::move(shards);
+            forward_client_ = std::make_shared<RedisClient>();
+            forward_client_->SetDatabases(dbs_, lazy_free_);
+            forward_client_->SetCommandStats(command_stats_);
+        }
+
+        /// 连接已经关闭、还在等待零拷贝完成通知的客户端数量
+        size_t ClosingClientCount() const
+        {
+            return clients_closing_.size();
+        }
+
+        /// 投递一个由当前分片的事件循环线程执行的任务，允许跨线程调用
+        void Post(std::function<void()> task)
+        {
+            if (mailbox_.Post(std::move(task)))
+            {
+                io_service_.WakeUp();
+            }
+        }
+
     private:
         /// 初始化配置信息
         void InitConfig()
@@ -112,11 +296,25 @@ namespace tr
         {
             server_logger_ = base::Log{};
             server_logger_.AddLogFd(STDOUT_FILENO);
+            InitHashFunction();
+            InitDatabases();
+            io_threads_ = std::make_unique<IOThreads>(std::clamp(config_.ioThreads, 1, IO_THREADS_MAX_NUM));
+#if defined(__linux__)
+            auto &poller = io_service_.GetPoller();
+            if (config_.ioUring && !poller.EnableIoUring())
+            {
+                server_logger_.Warn("io_uring is not supported by the kernel, fall back to epoll");
+            }
+            // 只有 epoll 支持边缘触发
+            config_.edgeTriggered = config_.edgeTriggered && !poller.UsingIoUring();
+            poller.SetEdgeTriggered(config_.edgeTriggered);
+#endif
             if (config_.port != 0)
             {
                 char netErr[net::ANET_ERR_LEN];
-                ipfd_ = netTool_.anetTcpServer(netErr, config_.port, config_.bindAddr);
-                if (ipfd_ == net::ANET_ERR)
+                ipfd_ = netTool_.anetTcpServer(netErr, config_.port, config_.bindAddr, config_.reactors > 1);
+                // 每次可读事件接受多个连接，直到没有等待的连接，监听 socket 必须是非阻塞的
+                if (ipfd_ == net::ANET_ERR || netTool_.anetNonBlock(netErr, ipfd_) == net::ANET_ERR)
                 {
                     server_logger_.Error(std::string_view(netErr));
                     exit(1);
@@ -124,33 +322,402 @@ namespace tr
             }
         }
 
+        /// 创建 config_.dbNum 个数据库
+        void InitDatabases()
+        {
+            dbs_ = std::make_shared<std::vector<base::RedisDB>>();
+            dbs_->reserve(config_.dbNum);
+            for (int32_t id = 0; id < config_.dbNum; id++)
+            {
+                dbs_->emplace_back(id);
+            }
+        }
+
+        /// 选择哈希算法并生成随机密钥，必须在键空间存入任何元素之前执行
+        /// 哈希函数的密钥和算法是进程级的全局配置，只在第一个服务端初始化时设置一次。
+        /// 之后创建的服务端（多 reactor 的其它分片、同一进程里的多个实例）沿用已有的配置：
+        /// 重新设置会和正在运行的服务端发生数据竞争，并使它已经存入的 key 再也找不到
+        void InitHashFunction()
+        {
+            static std::once_flag once;
+            std::call_once(once, [this] {
+                base::HashSeed seed{};
+                std::random_device device;
+                for (auto &byte : seed)
+                {
+                    byte = static_cast<uint8_t>(device());
+                }
+                base::SetHashSeed(seed);
+                base::SetHashAlgorithm(config_.hashAlgorithm);
+            });
+            if (config_.hashAlgorithm != base::GetHashAlgorithm())
+            {
+                server_logger_.Warn("hash algorithm is already set for this process, ignore the configured one");
+                config_.hashAlgorithm = base::GetHashAlgorithm();
+            }
+        }
+
         void BeforeSleep(IOServiceType &io_service)
         {
             // TODO sleep前执行的任务
+            mailbox_.Process();
+            HandleClientsWithPendingReads();
+            // 利用事件循环的空闲时间推进键空间的渐进式 rehash
+            // 每轮只推进一个正在 rehash 的数据库，避免占用太多时间
+            for (auto &db : *dbs_)
+            {
+                auto &dict = db.Dict();
+                auto &expires = db.Expires();
+                if (dict.IsRehashing() || expires.IsRehashing())
+                {
+                    dict.RehashMilliseconds(REHASH_MILLISECONDS_PER_LOOP);
+                    expires.RehashMilliseconds(REHASH_MILLISECONDS_PER_LOOP);
+                    break;
+                }
+            }
+            ActiveExpireCycle(ExpireCycleType::Fast);
+            HandleClientsWithPendingWrites();
+            FreeClientsInAsyncFreeQueue();
         }
 
-        void RemoveClient(int fd)
+        /// redis function: freeClientsInAsyncFreeQueue
+        /// 关闭回复已经全部写出、等待关闭的客户端。
+        /// 还有零拷贝发送没有完成时，内核仍在读取回复引用的值，先关闭连接，
+        /// socket 和客户端留到 CloseClientsWaitingForZeroCopy 里收到通知之后再释放。
+        /// socket 关闭之前 fd 不会被新的连接复用
+        void FreeClientsInAsyncFreeQueue()
         {
-            auto i = 0;
-            for (; i < list_.size(); i++)
+            for (auto &weak_client : clients_to_close_)
             {
-                if (list_.at(i).get()->GetFd() == fd)
+                auto client = weak_client.lock();
+                if (client == nullptr)
                 {
-                    break;
+                    continue;
+                }
+                auto fd = client->GetFd();
+                if (client->ReapZeroCopy())
+                {
+                    client->Shutdown();
+                    clients_closing_.push_back({client, base::NowMilliseconds() + ZERO_COPY_CLOSE_TIMEOUT});
+                }
+                else
+                {
+                    client->Close();
+                }
+                RemoveClient(fd);
+            }
+            clients_to_close_.clear();
+        }
+
+        /// 关闭零拷贝发送已经全部完成或者等待超时的客户端的 socket
+        void CloseClientsWaitingForZeroCopy()
+        {
+            if (clients_closing_.empty())
+            {
+                return;
+            }
+            auto now = base::NowMilliseconds();
+            std::erase_if(clients_closing_, [now](const ClosingClient &closing) {
+                if (closing.client->ReapZeroCopy() && now < closing.deadline)
+                {
+                    return false;
                 }
+                close(closing.client->GetFd());
+                return true;
+            });
+        }
+
+        /// redis function: handleClientsWithPendingReadsUsingThreads
+        /// 由 IO 线程并行读取和解析这一轮有读事件的客户端，然后在事件循环线程里依次执行命令
+        void HandleClientsWithPendingReads()
+        {
+            if (clients_pending_read_.empty())
+            {
+                return;
+            }
+            std::vector<std::shared_ptr<RedisClient>> clients;
+            clients.reserve(clients_pending_read_.size());
+            for (auto &weak_client : clients_pending_read_)
+            {
+                if (auto client = weak_client.lock())
+                {
+                    client->SetPendingRead(false);
+                    clients.emplace_back(std::move(client));
+                }
+            }
+            clients_pending_read_.clear();
+
+            io_threads_->Run(clients, IOThreads::Operation::Read);
+            for (auto &client : clients)
+            {
+                client->ProcessReadResult();
+            }
+        }
+
+        /// redis function: handleClientsWithPendingWrites
+        /// 把这一轮事件循环产生的回复直接写给客户端，只有写不完的客户端才注册写事件。
+        /// 使用 IO 线程时由 IO 线程并行写
+        void HandleClientsWithPendingWrites()
+        {
+            if (clients_pending_write_.empty())
+            {
+                return;
+            }
+            std::vector<std::weak_ptr<RedisClient>> pending;
+            pending.swap(clients_pending_write_);
+            if (io_threads_->Count() == 1)
+            {
+                for (auto &weak_client : pending)
+                {
+                    if (auto client = weak_client.lock())
+                    {
+                        client->HandlePendingWrite();
+                    }
+                }
+            }
+            else
+            {
+                std::vector<std::shared_ptr<RedisClient>> clients;
+                clients.reserve(pending.size());
+                for (auto &weak_client : pending)
+                {
+                    auto client = weak_client.lock();
+                    if (client != nullptr && client->BeginPendingWrite())
+                    {
+                        clients.emplace_back(std::move(client));
+                    }
+                }
+                io_threads_->Run(clients, IOThreads::Operation::Write);
+                for (auto &client : clients)
+                {
+                    client->FinishPendingWrite();
+                }
+            }
+            // 复用列表的内存
+            pending.clear();
+            clients_pending_write_.swap(pending);
+        }
+
+        /// key 所在的分片
+        size_t ShardOf(std::string_view key) const
+        {
+            return KeyHashSlot(key) % shards_.size();
+        }
+
+        /// 多 reactor 模式下，key 不属于当前分片的命令转发给 key 所在的分片执行，
+        /// ALL_SHARDS 命令转发给全部分片执行。返回 false 表示命令在当前分片直接执行。
+        /// 参数复制一份再投递，客户端在收到回复之前处于阻塞状态，回复投递回当前分片追加给客户端
+        bool ForwardCommand(const std::weak_ptr<RedisClient> &weak_client, const RedisCommand &command)
+        {
+            auto client = weak_client.lock();
+            assert(client != nullptr);
+            auto &argv = client->Arguments();
+            std::vector<ToyRedisServer *> targets;
+            if (command.HasFlag(command_flag::ALL_SHARDS))
+            {
+                targets = shards_;
+            }
+            else
+            {
+                auto target = shards_[ShardOf(argv[command.firstKey])];
+                if (target == this)
+                {
+                    return false;
+                }
+                targets.emplace_back(target);
+            }
+
+            struct ForwardRequest
+            {
+                std::vector<std::string> args;
+                int64_t db;
+                int32_t resp;
+            };
+            auto request = std::make_shared<const ForwardRequest>(ForwardRequest{
+                std::vector<std::string>(argv.begin(), argv.end()),
+                client->GetDB()->Id(), client->ProtocolVersion()});
+            // 只由当前分片的线程访问。全部分片都回复之后才回复客户端，各个分片的回复相同
+            auto remaining = std::make_shared<size_t>(targets.size());
+            client->Block();
+            for (auto target : targets)
+            {
+                target->Post([this, target, request, remaining, weak_client] {
+                    auto reply = target->forward_client_->ExecuteForwarded(request->args, request->db, request->resp);
+                    Post([this, remaining, weak_client, reply = std::move(reply)] {
+                        if (--*remaining > 0)
+                        {
+                            return;
+                        }
+                        // 等待回复期间客户端可能已经断开
+                        if (auto client = weak_client.lock())
+                        {
+                            client->Unblock(reply);
+                        }
+                    });
+                });
+            }
+            return true;
+        }
+
+        /// redis function: serverCron
+        /// 周期任务，每秒执行 config_.hz 次
+        void ServerCron()
+        {
+            DatabasesCron();
+            CloseClientsWaitingForZeroCopy();
+        }
+
+        /// redis function: databasesCron
+        /// 键空间的后台维护任务
+        void DatabasesCron()
+        {
+            ActiveExpireCycle(ExpireCycleType::Slow);
+            TryResizeHashTables();
+        }
+
+        /// redis function: activeExpireCycle
+        /// 定期删除过期 key。依次处理各个数据库，每一步抽查 20 个带过期时间的 key，
+        /// 抽查到的过期 key 比例较高时继续处理同一个数据库，直到比例降下来或者超过时间上限。
+        /// 超时退出时说明过期 key 堆积较多，之后每轮事件循环都会执行一次快速删除，
+        /// 把清理工作分散到多轮事件循环里，任何一次调用都不会长时间阻塞事件循环
+        void ActiveExpireCycle(ExpireCycleType type)
+        {
+            auto start = base::NowMicroseconds();
+            int64_t time_limit = 0;
+            if (type == ExpireCycleType::Fast)
+            {
+                // 上一轮没有超时退出，说明过期 key 不多，等 serverCron 处理即可
+                if (!expire_time_limit_exit_)
+                {
+                    return;
+                }
+                // 两次快速删除的间隔至少是时间上限的两倍
+                if (start < last_fast_expire_cycle_ + ACTIVE_EXPIRE_CYCLE_FAST_DURATION * 2)
+                {
+                    return;
+                }
+                last_fast_expire_cycle_ = start;
+                time_limit = ACTIVE_EXPIRE_CYCLE_FAST_DURATION;
+            }
+            else
+            {
+                time_limit = 1000000 * ACTIVE_EXPIRE_CYCLE_SLOW_TIME_PERC / config_.hz / 100;
+            }
+
+            expire_time_limit_exit_ = false;
+            auto dbs_per_call = std::min(CRON_DBS_PER_CALL, dbs_->size());
+            for (size_t i = 0; i < dbs_per_call && !expire_time_limit_exit_; i++)
+            {
+                auto &db = (*dbs_)[expire_current_db_ % dbs_->size()];
+                expire_current_db_++;
+
+                base::ExpireCycleStats stats;
+                do
+                {
+                    if (db.ExpiresSize() == 0)
+                    {
+                        break;
+                    }
+                    stats = db.ActiveExpireStep(base::NowMilliseconds(), ACTIVE_EXPIRE_CYCLE_KEYS_PER_LOOP);
+                    if (base::NowMicroseconds() - start > time_limit)
+                    {
+                        expire_time_limit_exit_ = true;
+                        break;
+                    }
+                } while (stats.sampled == 0 ||
+                         stats.expired * 100 / stats.sampled > ACTIVE_EXPIRE_CYCLE_ACCEPTABLE_STALE);
+            }
+        }
+
+        /// redis function: tryResizeHashTables
+        /// 大量删除后键空间的负载过低时开始缩容，缩容过程由 BeforeSleep 渐进完成，
+        /// 缩容完成后旧表的内存归还给分配器
+        void TryResizeHashTables()
+        {
+            for (auto &db : *dbs_)
+            {
+                auto &dict = db.Dict();
+                if (dict.ShrinkIfNeeded())
+                {
+                    server_logger_.Debug("db %d keyspace shrink to %lu buckets", db.Id(), dict.BucketSize());
+                }
+                db.Expires().ShrinkIfNeeded();
+            }
+        }
+
+        /// redis function: linkClient
+        /// 按 fd 登记客户端，fd 超出 clients_ 的范围时返回 false
+        bool LinkClient(std::shared_ptr<RedisClient> client)
+        {
+            auto fd = client->GetFd();
+            if (fd < 0 || static_cast<size_t>(fd) >= clients_.size())
+            {
+                return false;
+            }
+            assert(clients_[fd] == nullptr && "fd 已经被其它客户端使用");
+            clients_[fd] = std::move(client);
+            client_count_++;
+            return true;
+        }
+
+        /// redis function: unlinkClient
+        /// 移除 fd 对应的客户端
+        void RemoveClient(int fd)
+        {
+            assert(fd >= 0 && static_cast<size_t>(fd) < clients_.size());
+            if (clients_[fd] == nullptr)
+            {
+                return;
             }
-            // 删除第 i 个元素，需-1
-            list_.erase(list_.begin() + i - 1);
+            clients_[fd].reset();
+            client_count_--;
         }
 
     private:
         ServerConfig config_;
         IOServiceType io_service_;
         net::RedisNet netTool_;
-        int ipfd_;
+        int ipfd_ = -1;
+        /// 监听 socket 的读事件处理函数，边缘触发时 accept 出错后由定时器重新调用
+        EventHandler accept_handler_;
         base::Log server_logger_;
-        std::vector<std::shared_ptr<RedisClient>> list_;
-        std::shared_ptr<base::Dictionary<std::string, std::string>> dict_{std::make_shared<base::Dictionary<std::string, std::string>>()};
+        /// 以 fd 为下标的客户端表，fd 由内核按最小可用值分配，表是稠密的，
+        /// 查找和删除都是 O(1)
+        std::vector<std::shared_ptr<RedisClient>> clients_ =
+            std::vector<std::shared_ptr<RedisClient>>(net::MAX_NUMBER_OF_FD);
+        /// 当前连接的客户端数量
+        size_t client_count_ = 0;
+        /// redis: server.clients_pending_write
+        /// 有回复等待写出的客户端
+        std::vector<std::weak_ptr<RedisClient>> clients_pending_write_;
+        /// redis: server.clients_pending_read
+        /// 有读事件、等待 IO 线程读取的客户端
+        std::vector<std::weak_ptr<RedisClient>> clients_pending_read_;
+        /// redis: server.clients_to_close
+        /// 回复已经写完、等待在 BeforeSleep 里关闭的客户端
+        std::vector<std::weak_ptr<RedisClient>> clients_to_close_;
+        /// 连接已经关闭、等待零拷贝完成通知的客户端，持有回复引用的值直到通知全部收到
+        std::vector<ClosingClient> clients_closing_;
+        /// IO 线程池，ioThreads 为 1 时没有额外的线程
+        std::unique_ptr<IOThreads> io_threads_;
+        /// 多 reactor 模式下的全部分片，包括自己，单个事件循环时为空
+        std::vector<ToyRedisServer *> shards_;
+        /// 其它分片投递过来的任务
+        Mailbox mailbox_;
+        /// 执行其它分片转发过来的命令的伪客户端
+        std::shared_ptr<RedisClient> forward_client_;
+        std::shared_ptr<std::vector<base::RedisDB>> dbs_;
+        /// 各个命令的执行统计，下标和 COMMAND_TABLE 一致
+        std::shared_ptr<CommandStatsTable> command_stats_{
+            std::make_shared<CommandStatsTable>(COMMAND_TABLE.Size())};
+        /// 后台释放线程，FLUSHDB 清空的键空间交给它释放
+        std::shared_ptr<base::LazyFree> lazy_free_{std::make_shared<base::LazyFree>()};
+        /// 下一轮定期删除从哪个数据库开始
+        size_t expire_current_db_ = 0;
+        /// 上一轮定期删除是否因为超时退出
+        bool expire_time_limit_exit_ = false;
+        /// 上一次快速定期删除的开始时间，单位微秒
+        int64_t last_fast_expire_cycle_ = 0;
     };
 
 } // namespace tr
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "base/marco.hpp"
+#include "base/message_queue.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <utility>
+
+namespace tr
+{
+    /// redis macro: CLUSTER_SLOTS
+    /// 键空间的槽位数量，和 redis cluster 相同
+    static constexpr uint32_t CLUSTER_SLOTS = 16384;
+
+    namespace shard_detail
+    {
+        /// CRC16-CCITT (XMODEM) 的查找表，多项式 0x1021
+        constexpr std::array<uint16_t, 256> MakeCrc16Table()
+        {
+            std::array<uint16_t, 256> table{};
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint16_t crc = static_cast<uint16_t>(i << 8);
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021)
+                                         : static_cast<uint16_t>(crc << 1);
+                }
+                table[i] = crc;
+            }
+            return table;
+        }
+
+        inline constexpr auto CRC16_TABLE = MakeCrc16Table();
+    } // namespace shard_detail
+
+    /// redis function: crc16
+    constexpr uint16_t Crc16(std::string_view data)
+    {
+        uint16_t crc = 0;
+        for (auto c : data)
+        {
+            crc = static_cast<uint16_t>(
+                (crc << 8) ^ shard_detail::CRC16_TABLE[((crc >> 8) ^ static_cast<uint8_t>(c)) & 0xFF]);
+        }
+        return crc;
+    }
+
+    /// redis function: keyHashSlot
+    /// key 所在的槽位。key 里包含非空的 {tag} 时只对 tag 计算，
+    /// 这样带有相同 tag 的 key 一定落在同一个槽位
+    constexpr uint32_t KeyHashSlot(std::string_view key)
+    {
+        auto start = key.find('{');
+        if (start != std::string_view::npos)
+        {
+            auto end = key.find('}', start + 1);
+            if (end != std::string_view::npos && end != start + 1)
+            {
+                key = key.substr(start + 1, end - start - 1);
+            }
+        }
+        return Crc16(key) & (CLUSTER_SLOTS - 1);
+    }
+
+    /// @brief 事件循环之间传递任务的邮箱
+    /// 任意线程都可以投递任务，任务由邮箱所属的事件循环线程取出执行
+    class Mailbox
+    {
+        using Task = std::function<void()>;
+
+    public:
+        DISABLE_COPY_AND_MOVE(Mailbox)
+
+        Mailbox()
+        {
+            queue_.SetNotWait();
+        }
+
+        /// 投递一个任务，返回是否需要唤醒事件循环。
+        /// 上一次唤醒之后事件循环还没有处理邮箱时不需要再次唤醒，避免每个任务都写一次唤醒管道
+        bool Post(Task task)
+        {
+            queue_.Push(std::move(task));
+            return !notified_.exchange(true, std::memory_order_acq_rel);
+        }
+
+        /// 取出并执行全部任务
+        void Process()
+        {
+            if (!notified_.exchange(false, std::memory_order_acq_rel))
+            {
+                return;
+            }
+            while (auto task = queue_.Pop())
+            {
+                (*task)();
+            }
+        }
+
+    private:
+        base::MessageQueue<Task> queue_{SIZE_MAX};
+        /// 是否已经唤醒过事件循环并且还没有处理
+        std::atomic<bool> notified_{false};
+    };
+} // namespace tr